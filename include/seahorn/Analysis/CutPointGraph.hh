@@ -5,6 +5,7 @@
 
 #include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/BitVector.h"
 
@@ -112,6 +113,10 @@ namespace seahorn
     return cp.succ_end ();
   }
   
+  /// true if the function returns at cp
+  inline bool isReturnCp (const CutPoint &cp)
+  {return llvm::isa<llvm::ReturnInst> (cp.bb ().getTerminator ());}
+  
   inline const CutPointGraph &CpEdge::parent () const {return m_src.parent ();}
  
   class CutPointGraph : public FunctionPass
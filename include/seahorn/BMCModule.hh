@@ -28,6 +28,8 @@ namespace seabmc
   protected:
 
     ExprFactory m_efac;
+    /// -- destroyed after all other members
+    ExprFactoryTeardown m_teardown;
     EZ3 m_zctx;
     ZFixedPoint<EZ3> m_fp;
 
@@ -40,7 +42,7 @@ namespace seabmc
   public:
     static char ID;
     BMCModule ();
-    virtual ~BMCModule () {}
+    virtual ~BMCModule () {m_teardown.begin ();}
     ExprFactory& getExprFactory () {return m_efac;}
     EZ3 &getZContext () {return m_zctx;}
     ZFixedPoint<EZ3> &getZFixedPoint () {return m_fp;}
@@ -2,9 +2,12 @@
 #define  __BMC__HH_
 
 #include "llvm/IR/Function.h"
+#include "llvm/ADT/ArrayRef.h"
 
 #include "boost/logic/tribool.hpp"
 
+#include <functional>
+
 #include "ufo/Expr.hpp"
 #include "ufo/Smt/EZ3.hh"
 
@@ -47,22 +50,73 @@ namespace seahorn
     
     /// path-condition for m_cps
     ExprVector m_side;
-    
+    /// size of m_side after the encoding of each edge in m_edges
+    std::vector<unsigned> m_sideSz;
+    
+    /// true if the side-conditions of every edge are guarded by an
+    /// activation literal that is assumed when solving
+    bool m_incremental;
+    /// activation literals of the edges in m_edges (incremental mode)
+    ExprVector m_acts;
+    /// number of activation literals created so far
+    unsigned m_actCount;
+    
+    /// constraints on the symbolic state at a cut point
+    std::function<Expr (const CutPoint&, SymStore&)> m_cpConstraints;
+    
+    /// Cone-of-influence slicing. A definition x = e of m_side is not
+    /// asserted until x occurs in an asserted conjunct
+    
+    /// symbols that occur in asserted conjuncts
+    ExprSet m_cone;
+    /// symbols with a single definition that is not asserted, mapped
+    /// to the index of the definition in m_side
+    std::map<Expr,unsigned> m_sliced;
+    
+    /// adds m_side [i] to the cone, together with the definitions it
+    /// depends on. The indices of the conjuncts to assert are added to out
+    void addToCone (unsigned i, std::vector<unsigned> &out);
+    
+    /// asserts the side-conditions of the edges in [from, to)
+    void assertEdges (unsigned from, unsigned to);
+    /// re-asserts the encoding into a fresh solver
+    void restoreEncoding ();
+    /// adds the constraints of the state s at cp to m_side
+    void addCpConstraints (const CutPoint &cp, SymStore &s);
     
   public:
     BmcEngine (SmallStepSymExec &sem, ufo::EZ3 &zctx) : 
       m_sem (sem), m_efac (sem.efac ()), m_result (boost::indeterminate),
       m_cpg (nullptr), m_fn (nullptr),
-      m_smt_solver (zctx)
+      m_smt_solver (zctx), m_incremental (false), m_actCount (0)
     {};
     
     void addCutPoint (const CutPoint &cp);
+    /// removes the last cut point, and its edge from the encoding
+    void popCutPoint ();
+    
+    /// In incremental mode, each edge is encoded under a fresh
+    /// activation literal. Cut points can be added and removed between
+    /// calls to solve () without losing what the solver has learned.
+    /// Must be set before the first encoding
+    void setIncremental (bool v) 
+    { assert (m_states.empty ()); m_incremental = v; }
+    bool isIncremental () const { return m_incremental; }
+    
+    /// f (cp, s) is a constraint on the state s at the cut point cp,
+    /// e.g., an invariant. It is added for every cut point of the
+    /// trace, as part of the edge into the cut point. The constraint of
+    /// the first cut point is part of the first edge.
+    /// Must be set before the first encoding
+    void setCpConstraints (std::function<Expr (const CutPoint&, SymStore&)> f)
+    { assert (m_states.empty ()); m_cpConstraints = f; }
     
     SmallStepSymExec& sem () {return m_sem;}
     
     ufo::EZ3 &zctx () { return m_smt_solver.getContext (); }
     
-    /// constructs the path condition
+    /// constructs the path condition. Only the cut points added since
+    /// the last call are encoded
     void encode ();
     /// checks satisfiability of the path condition
     boost::tribool solve ();
@@ -73,7 +127,7 @@ namespace seahorn
     /// output current path condition in SMT-LIB2 format
     template<typename OutputStream>
     OutputStream &toSmtLib (OutputStream &out) 
-    { encode (); return m_smt_solver.toSmtLib (out); }
+    { encode (); return m_smt_solver.toSmtLibAssuming (out, m_acts); }
     
     /// access to expression factory
     ExprFactory &efac () { return m_efac; }
@@ -84,6 +138,10 @@ namespace seahorn
     /// Returns the BMC trace (if available)
     BmcTrace getTrace ();
     
+    /// The definitions that were sliced away, as pairs of the defined
+    /// symbol and its value, in the order of the encoding
+    void slicedDefs (std::vector<std::pair<Expr,Expr> > &out) const;
+    
     /// Dump unsat core 
     /// Exposes internal details. Intendent to be used for debugging only
     void unsatCore (ExprVector &out);
@@ -106,6 +164,12 @@ namespace seahorn
     /// of the corresponding cutpoint in BmcEngine
     SmallVector<unsigned, 8> m_cpId;
     
+    /// definitions sliced away from the encoding, in terms of the
+    /// symbols that are not sliced
+    ExprMap m_sliced;
+    /// replaces the symbols of e that are defined in m_sliced
+    Expr unslice (Expr e);
+    
     
     BmcTrace (BmcEngine &bmc, ufo::ZModel<ufo::EZ3> &model);
 
@@ -122,7 +186,7 @@ namespace seahorn
     
     BmcTrace (const BmcTrace &other) :
       m_bmc (other.m_bmc), m_model (other.m_model),
-      m_bbs (other.m_bbs), m_cpId (other.m_cpId) {}
+      m_bbs (other.m_bbs), m_cpId (other.m_cpId), m_sliced (other.m_sliced) {}
     
     /// underlying BMC engine
     BmcEngine &engine () { return m_bmc; }
@@ -136,6 +200,13 @@ namespace seahorn
     Expr symb (unsigned loc, const llvm::Value &inst);
     Expr eval (unsigned loc, const llvm::Value &inst, bool complete=false);
     Expr eval (unsigned loc, Expr v, bool complete=false);
+    /// The values of vals at the given location, in order, evaluated
+    /// in one batch. A value that is not tracked is null
+    void eval (unsigned loc, ArrayRef<const llvm::Value*> vals,
+               ExprVector &out, bool complete=false);
+    /// The values of all the instructions of the basic block at the
+    /// given location, in order
+    void evalAll (unsigned loc, ExprVector &out, bool complete=false);
     template <typename Out> Out &print (Out &out);
     friend class BmcEngine;
   };
@@ -150,8 +221,12 @@ namespace seahorn
       const BasicBlock &BB = *bb(loc);
       out << BB.getName () << ": \n";
       
+      ExprVector vals;
+      evalAll (loc, vals);
+      unsigned idx = 0;
       for (auto &I : BB)
       {
+        Expr v = vals [idx++];
         if (const DbgValueInst *dvi = dyn_cast<DbgValueInst> (&I))
         {
           if (dvi->getValue () && dvi->getVariable ())
@@ -192,7 +267,6 @@ namespace seahorn
         }
                
                
-        Expr v = eval (loc, I);
         if (!v) continue;
         out << "  %" << I.getName () << " " << *v;
         
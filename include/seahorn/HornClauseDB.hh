@@ -8,12 +8,16 @@
 #include <boost/range/algorithm/copy.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/container/flat_set.hpp>
+#include <boost/iterator/iterator_facade.hpp>
 
 #include "ufo/Expr.hpp"
 #include "ufo/Stats.hh"
 
 #include <algorithm>
+#include <deque>
 #include <map>
+#include <set>
+#include <unordered_map>
 
 namespace seahorn
 {
@@ -23,9 +27,30 @@ namespace seahorn
   class HornClauseDB;
   class HornRule
   { 
+    friend class HornClauseDB;
+    
     ExprVector m_vars;
     Expr m_head;
     Expr m_body; 
+    /// hash of the rule, cached
+    size_t m_hash;
+    
+    void rehash ()
+    {
+      m_hash = expr::hash_value (m_head);
+      boost::hash_combine (m_hash, m_body);
+      boost::hash_combine (m_hash, boost::hash_range (m_vars.begin (), 
+                                                      m_vars.end ()));
+    }
+    
+    /// drops the terms of a removed rule
+    void release ()
+    {
+      ExprVector ().swap (m_vars);
+      m_head.reset ();
+      m_body.reset ();
+      m_hash = 0;
+    }
     
   public:
     template <typename Range>
@@ -40,39 +65,43 @@ namespace seahorn
       }
       else 
       { assert (bind::isFapp (b)); }      
+      rehash ();
     }
 
     template <typename Range>
     HornRule (Range &v, Expr head, Expr body) : 
       m_vars (boost::begin (v), boost::end (v)), 
       m_head (head), m_body (body) 
-    { }
+    { rehash (); }
     
     HornRule (const HornRule &r) : 
       m_vars (r.m_vars), 
-      m_head (r.m_head), m_body (r.m_body) 
+      m_head (r.m_head), m_body (r.m_body), m_hash (r.m_hash)
     {} 
     
-    size_t hash () const
-    {
-      size_t res = expr::hash_value (m_head);
-      boost::hash_combine (res, m_body);
-      boost::hash_combine (res, boost::hash_range (m_vars.begin (), 
-                                                   m_vars.end ()));
-      return res;
-    }
+    size_t hash () const { return m_hash; }
 
     bool operator==(const HornRule & other) const
-    { return hash() == other.hash ();}
+    { 
+      return m_hash == other.m_hash && m_head == other.m_head && 
+        m_body == other.m_body && m_vars == other.m_vars;
+    }
 
+    /// orders by hash first. Rules with equal hashes are ordered
+    /// structurally
     bool operator<(const HornRule & other) const
-    { return hash() < other.hash ();}
+    { 
+      if (m_hash != other.m_hash) return m_hash < other.m_hash;
+      if (m_head != other.m_head) return m_head < other.m_head;
+      if (m_body != other.m_body) return m_body < other.m_body;
+      return m_vars < other.m_vars;
+    }
 
     // return only the body of the horn clause
     Expr body () const {return m_body;}
 
     /// set body of the horn clause
-    void setBody (Expr v) {m_body = v;}
+    void setBody (Expr v) {m_body = v; rehash ();}
 
     // return only the head of the horn clause
     Expr head () const {return m_head;}
@@ -98,8 +127,59 @@ namespace seahorn
     friend class HornRule;
   public:
 
-    typedef std::vector<HornRule> RuleVector;
+    /// Rules in the order in which they were added. A rule is
+    /// identified by its position, which does not change when other
+    /// rules are removed. A removed rule leaves a tombstone that
+    /// iteration skips
+    class RuleVector
+    {
+      friend class HornClauseDB;
+      /// a deque so that references to rules are stable
+      std::deque<HornRule> m_rules;
+      std::vector<bool> m_removed;
+      /// number of rules that are not removed
+      size_t m_size;
+      
+      template <typename V, typename R>
+      class iter : 
+        public boost::iterator_facade<iter<V,R>, V, boost::forward_traversal_tag>
+      {
+        friend class boost::iterator_core_access;
+        R *m_v;
+        unsigned m_id;
+        
+        void skip ()
+        { while (m_id < m_v->m_rules.size () && m_v->m_removed [m_id]) ++m_id; }
+        
+        void increment () { ++m_id; skip (); }
+        bool equal (const iter &o) const { return m_id == o.m_id; }
+        V &dereference () const { return m_v->m_rules [m_id]; }
+        
+      public:
+        iter () : m_v (nullptr), m_id (0) {}
+        iter (R *v, unsigned id) : m_v (v), m_id (id) { skip (); }
+        /// id of the rule
+        unsigned id () const { return m_id; }
+      };
+      
+    public:
+      typedef iter<HornRule, RuleVector> iterator;
+      typedef iter<const HornRule, const RuleVector> const_iterator;
+      
+      RuleVector () : m_size (0) {}
+      
+      iterator begin () { return iterator (this, 0); }
+      iterator end () { return iterator (this, m_rules.size ()); }
+      const_iterator begin () const { return const_iterator (this, 0); }
+      const_iterator end () const 
+      { return const_iterator (this, m_rules.size ()); }
+      
+      size_t size () const { return m_size; }
+      bool empty () const { return m_size == 0; }
+    };
+    
     typedef boost::container::flat_set<Expr> expr_set_type;
+    typedef std::set<HornRule*> horn_set_type;
     struct IsRelation : public std::unary_function<Expr, bool>
     {
       const HornClauseDB &m_db;
@@ -120,12 +200,16 @@ namespace seahorn
     /// indexes
 
     
-    typedef boost::container::flat_set<HornRule*> horn_set_type;
     typedef std::map<Expr, horn_set_type > index_type;
     /// maps a relation to rules it appears in the body
     index_type m_body_idx;
     /// maps a relation to rules it appears in the head
     index_type m_head_idx;
+    /// true if the use/def indexes are built. They are kept up to
+    /// date by addRule and removeRule from then on
+    bool m_indexed;
+    /// maps the hash of a rule to the ids of the rules with that hash
+    std::unordered_multimap<size_t, unsigned> m_hash_idx;
     
     const ExprVector &getVars () const;
 
@@ -134,21 +218,38 @@ namespace seahorn
     
     /// resets all indexes
     void resetIndexes ();
+    /// adds the rule to the use/def indexes
+    void indexRule (HornRule &r);
+    /// removes the rule from the use/def indexes
+    void unindexRule (HornRule &r);
 
   public:
 
-    HornClauseDB (ExprFactory &efac) : m_efac (efac) {}
+    HornClauseDB (ExprFactory &efac) : m_efac (efac), m_indexed (false) {}
+    /// copies the relations, rules, queries and constraints of db.
+    /// The use/def indexes are not copied
+    HornClauseDB (const HornClauseDB &db) :
+      m_efac (db.m_efac), m_rels (db.m_rels), m_vars (db.m_vars),
+      m_rules (db.m_rules), m_queries (db.m_queries),
+      m_constraints (db.m_constraints), m_indexed (false),
+      m_hash_idx (db.m_hash_idx) {}
     
-    ExprFactory &getExprFactory () {return m_efac;}
+    ExprFactory &getExprFactory () const {return m_efac;}
     
     void registerRelation (Expr fdecl) {m_rels.insert (fdecl);}
+    /// removes a relation that no longer occurs in any rule, query
+    /// or constraint
+    void unregisterRelation (Expr fdecl) {m_rels.erase (fdecl);}
     const expr_set_type& getRelations () const {return m_rels;}
     bool hasRelation (Expr fdecl) const
     { return m_rels.count (fdecl) > 0; }
     /// number of relational predicates
     unsigned relSize () { return m_rels.size ();}
     
-    /// -- build use/def indexes
+    /// -- build use/def indexes and re-hash the rules. Once built,
+    /// -- the indexes are kept up to date by addRule and removeRule.
+    /// -- Rebuild them after changing rules in place, including
+    /// -- before removeRule (const HornRule&)
     void buildIndexes ();
 
     /// -- returns rules that use fdecl
@@ -178,13 +279,8 @@ namespace seahorn
       addRule (HornRule (vars, rule));
     }
 
-    void addRule (const HornRule &rule)
-    {
-      m_rules.push_back (rule);
-      boost::copy (rule.vars (), std::back_inserter (m_vars));
-      resetIndexes ();
-      
-    }
+    /// adds a rule. Returns its id
+    unsigned addRule (const HornRule &rule);
     
     const ExprVector &getVars ()
     {
@@ -195,15 +291,19 @@ namespace seahorn
       return m_vars;
     }
 
-    void removeRule (const HornRule &r)
-    {
-      m_rules.erase (std::remove (m_rules.begin(), m_rules.end(), r));
-      resetIndexes ();
-    }
-
+    /// removes every rule equal to r
+    void removeRule (const HornRule &r);
+    /// removes the rule with the given id
+    void removeRule (unsigned id);
 
     const RuleVector &getRules () const {return m_rules;}
     RuleVector &getRules () {return m_rules;}
+    
+    /// the rule with the given id. A removed rule has no head, body
+    /// or variables
+    const HornRule &getRule (unsigned id) const 
+    {return m_rules.m_rules [id];}
+    bool isRemoved (unsigned id) const {return m_rules.m_removed [id];}
 
     void addQuery (Expr q) {m_queries.push_back (q);}
     ExprVector getQueries () const {return m_queries;}
@@ -2,6 +2,7 @@
 #define _HORN_CLAUSE_DB_TRANSFORMATIONS__H_
 
 #include "seahorn/HornClauseDB.hh"
+#include "seahorn/HornModelConverter.hh"
 
 namespace seahorn
 {
@@ -9,6 +10,69 @@ namespace seahorn
   // Ensure all horn clause heads have only variables
   void normalizeHornClauseHeads (HornClauseDB &db);
 
+  /// Converts a model of a database sliced by sliceHornClauseDB into a
+  /// model of the original database
+  class SliceHornModelConverter : public HornModelConverter
+  {
+    /// relations of the original database
+    ExprVector m_rels;
+    /// maps a relation to its slice. Relations that are sliced away
+    /// are not mapped
+    ExprMap m_slices;
+    /// positions of the arguments of a relation kept by its slice
+    std::map<Expr, std::vector<unsigned> > m_kept;
+
+  public:
+    void addRelation (Expr rel) {m_rels.push_back (rel);}
+    void addSlice (Expr rel, Expr slice, const std::vector<unsigned> &kept)
+    {
+      m_slices [rel] = slice;
+      m_kept [rel] = kept;
+    }
+
+    /// relations that are sliced away are interpreted as true
+    bool convert (HornDbModel &in, HornDbModel &out);
+  };
+
+  /// Copies to out the part of db that may influence its queries. Only
+  /// the relations that are backward reachable from a query are kept,
+  /// and only the arguments of a relation that may influence a query.
+  /// A relation whose arguments are all kept keeps its declaration.
+  /// Requires the indexes of db (see HornClauseDB::buildIndexes ())
+  void sliceHornClauseDB (HornClauseDB &db, HornClauseDB &out,
+                          SliceHornModelConverter &converter);
+
+  /// Converts a model of a database transformed by inlineHornClauseDB
+  /// into a model of the original database
+  class InlineHornModelConverter : public HornModelConverter
+  {
+    EZ3 &m_zctx;
+    /// relations of the original database
+    ExprVector m_rels;
+    /// the rules that defined the inlined relations, in the order in
+    /// which the relations were inlined
+    std::vector<HornRule> m_inlined;
+
+  public:
+    InlineHornModelConverter (EZ3 &zctx) : m_zctx (zctx) {}
+
+    void addRelation (Expr rel) {m_rels.push_back (rel);}
+    void addInlined (const HornRule &def) {m_inlined.push_back (def);}
+
+    /// an inlined relation is interpreted by the body of its defining
+    /// rule, with the variables of the rule eliminated
+    bool convert (HornDbModel &in, HornDbModel &out);
+  };
+
+  /// Inlines every relation of db that is defined by a single rule and
+  /// used once by a single other rule, e.g., the relations of a linear
+  /// chain of blocks. The two rules are replaced by one, unless its
+  /// body has more than budget nodes. Relations of queries and
+  /// relations with constraints are kept. Returns the number of
+  /// inlined relations. Requires the indexes of db
+  unsigned inlineHornClauseDB (HornClauseDB &db,
+                               InlineHornModelConverter &converter,
+                               unsigned budget);
 }
 
 
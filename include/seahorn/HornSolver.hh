@@ -16,9 +16,12 @@ namespace seahorn
   {
     boost::tribool m_result;
     std::unique_ptr<ufo::ZFixedPoint <ufo::EZ3> >  m_fp;
+    /// true if HornCex runs after the solver. HornCex reads the
+    /// answer of m_fp as an answer for the database of HornifyModule
+    bool m_cex;
     
     void printCex ();
-    void estimateSizeInvars (Module &M);
+    void estimateSizeInvars (Module &M, HornDbModel &model);
 
     void printInvars(Function &F, HornDbModel &model);
     void printInvars(Module &M, HornDbModel &model);
@@ -26,7 +29,8 @@ namespace seahorn
   public:
     static char ID;
     
-    HornSolver () : ModulePass(ID), m_result(boost::indeterminate) {}
+    HornSolver (bool cex = false) :
+      ModulePass(ID), m_result(boost::indeterminate), m_cex (cex) {}
     virtual ~HornSolver() {}
     
     virtual bool runOnModule (Module &M);
@@ -56,6 +56,10 @@ namespace seahorn
     HornClauseDB &getHornClauseDB () {return m_db;}
     virtual void runOnFunction (Function &F) = 0;
     // bool checkProperty(ExprVector prop, Expr &inv);
+
+    /// -- the values of the options of the encodings, one
+    /// -- name=value per line
+    static std::string optionsKey ();
   };
 
   class SmallHornifyFunction : public HornifyFunction
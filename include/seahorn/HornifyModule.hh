@@ -29,6 +29,8 @@ namespace seahorn
   protected:
     
     ExprFactory m_efac;
+    /// -- destroyed after all other members
+    ExprFactoryTeardown m_teardown;
     EZ3 m_zctx;
     HornClauseDB m_db;
 
@@ -38,11 +40,21 @@ namespace seahorn
     
     LiveSymbolsMap m_ls;
     PredDeclMap m_bbPreds;
+
+    /// -- values of the options that may change the encoding. Part of
+    /// -- the key of the Horn cache
+    static std::string optionsKey ();
+    /// -- file of M in the Horn cache in directory dir
+    std::string cachePath (Module &M, const std::string &dir);
+    /// -- restores the result of runOnModule from the Horn cache
+    bool loadCache (Module &M, const std::string &path);
+    /// -- stores the result of runOnModule in the Horn cache
+    void storeCache (Module &M, const std::string &path);
     
   public:
     static char ID;
     HornifyModule ();
-    virtual ~HornifyModule () {}
+    virtual ~HornifyModule () {m_teardown.begin ();}
     ExprFactory& getExprFactory () {return m_efac;} 
     EZ3 &getZContext () {return m_zctx;}
     HornClauseDB& getHornClauseDB () {return m_db;}
@@ -9,6 +9,7 @@
 #include "seahorn/HornDbModel.hh"
 
 #include "ufo/Expr.hpp"
+#include "ufo/ExprMemo.hh"
 #include "ufo/Smt/Z3n.hpp"
 #include "ufo/Smt/EZ3.hh"
 #include "seahorn/HornClauseDBWto.hh"
@@ -33,16 +34,19 @@ namespace seahorn
   class Houdini
   {
   public:
-	  Houdini(HornifyModule &hm) : m_hm(hm)  {}
+	  Houdini(HornifyModule &hm) : m_hm(hm), m_memo(hm.getExprFactory())  {}
 	  virtual ~Houdini() {}
   private:
 	  HornifyModule &m_hm;
 	  HornDbModel m_candidate_model;
+	  // instantiations of candidates, keyed by predicate application
+	  RewriteMemo m_memo;
 
 
     public:
       HornifyModule& getHornifyModule() {return m_hm;}
       HornDbModel& getCandidateModel() {return m_candidate_model;}
+      RewriteMemo& getRewriteMemo() {return m_memo;}
 
     public:
       void runHoudini(int config);
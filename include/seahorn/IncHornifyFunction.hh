@@ -49,6 +49,10 @@ protected:
 public:
   IncHornifyFunction(HornifyModule &parent, bool interproc = false)
       : HornifyFunction(parent, interproc) {}
+
+  /// -- the values of the options of this encoding, one name=value
+  /// -- per line
+  static std::string optionsKey();
 };
 
 class IncSmallHornifyFunction : public IncHornifyFunction {
@@ -0,0 +1,85 @@
+#ifndef __KINDUCTION__HH_
+#define __KINDUCTION__HH_
+
+#include "seahorn/Bmc.hh"
+
+#include <functional>
+#include <vector>
+
+namespace seahorn
+{
+  /**
+   * k-induction over the cut-point graph of a function. Proves that no
+   * returning cut point is reachable from the entry cut point.
+   *
+   * The base case explores the cut-point paths from the entry up to
+   * length k. The inductive step checks that no path of k edges that
+   * starts at any cut point and does not visit a returning cut point
+   * can be extended by one edge into a returning cut point. Paths that
+   * are unsat are not extended.
+   *
+   * Each case is checked by its own incremental BmcEngine. The
+   * solvers are kept across paths and across values of k.
+   */
+  class KInduction
+  {
+  public:
+    /// inv (cp, s) is an invariant of the state s at the cut point cp
+    typedef std::function<Expr (const CutPoint&, SymStore&)> InvariantFn;
+
+  private:
+    typedef std::vector<const CutPoint*> CpPath;
+
+    const CutPointGraph &m_cpg;
+    const CutPoint &m_entry;
+
+    /// engine of the base case
+    BmcEngine m_base;
+    /// engine of the inductive step
+    BmcEngine m_step;
+    /// the current traces of m_base and m_step
+    CpPath m_baseTrace;
+    CpPath m_stepTrace;
+
+    /// last value of k
+    unsigned m_depth;
+    /// number of solver calls of the base case and the inductive step
+    unsigned m_baseCalls;
+    unsigned m_stepCalls;
+
+    /// moves the trace of bmc from cur to path
+    static void moveTo (BmcEngine &bmc, CpPath &cur, const CpPath &path);
+
+    /// Extends every path of frontier by one cut-point edge. Extensions
+    /// that do not end at a returning cut point and are not unsat are
+    /// added to next. Returns true if an extension that ends at a
+    /// returning cut point is sat, false if all such extensions are
+    /// unsat, and indeterminate otherwise. If stopAtSat, returns at the
+    /// first sat extension and leaves it in bmc
+    boost::tribool extend (BmcEngine &bmc, CpPath &cur, unsigned &calls,
+                           const std::vector<CpPath> &frontier,
+                           std::vector<CpPath> &next, bool stopAtSat);
+
+  public:
+    KInduction (SmallStepSymExec &sem, ufo::EZ3 &zctx,
+                const CutPointGraph &cpg, const CutPoint &entry);
+
+    /// Strengthens the inductive step with inv. The base case is not
+    /// affected
+    void setInvariants (InvariantFn inv) { m_step.setCpConstraints (inv); }
+
+    /// Runs k-induction for k = 1 .. maxK. Returns true if a returning
+    /// cut point is reachable, false if it is not, and indeterminate if
+    /// neither is known at maxK
+    boost::tribool run (unsigned maxK);
+
+    /// the value of k at which run () stopped
+    unsigned depth () const { return m_depth; }
+
+    /// the engine of the base case. Holds the counterexample after
+    /// run () returns true
+    BmcEngine &base () { return m_base; }
+  };
+}
+
+#endif
@@ -40,6 +40,8 @@ namespace seahorn
     
     
     void setLive (const ExprVector &l);
+    /// like setLive but keeps the order of l
+    void restoreLive (const ExprVector &l) { m_live = l; }
     void setDefs (const ExprVector &d);
     void addEdgeDef (const ExprVector &d);
     /// add live variables. These should not be already live
@@ -101,7 +103,15 @@ namespace seahorn
     void operator() () { run (); }
     /// Add additional globally live symbols
     void globallyLive (ExprVector &live);
+    /// Sets the live symbols of bb without running the analysis,
+    /// e.g., when restoring a cached result. The order of live is
+    /// kept since it is the order of the arguments of the predicate
+    /// of bb
+    void restoreLive (const BasicBlock *bb, const ExprVector &live)
+    { m_liveInfo [bb].restoreLive (live); }
     const ExprVector& live (const BasicBlock *bb) const;
+    bool hasLive (const BasicBlock *bb) const
+    { return m_liveInfo.count (bb) > 0; }
     void dump () const;
     
   };
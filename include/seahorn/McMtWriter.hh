@@ -4,6 +4,7 @@
 #include "seahorn/HornClauseDB.hh"
 #include "ufo/Expr.hpp"
 #include "ufo/Smt/EZ3.hh"
+#include "ufo/ExprSimplifier.hh"
 
 #include "seahorn/config.h"
 
@@ -119,7 +120,7 @@ namespace seahorn
       out << "\n";
       
       Expr phi = mknary<AND> (trueE, body);
-      phi = z3_simplify (m_z3, phi);
+      phi = op::simp::simplify (phi);
       out << "  " << m_z3.toSmtLib (phi) << ")\n";
       out << ")\n";
     }
@@ -67,6 +67,7 @@ namespace seahorn
   llvm::Pass *createApiAnalysisPass(std::string &config);
 
   llvm::Pass* createBmcPass (llvm::raw_ostream* out, bool solve);
+  llvm::Pass* createKInductionPass ();
 
   llvm::Pass* createProfilerPass();
   llvm::Pass* createCFGPrinterPass ();
@@ -10,6 +10,7 @@
 #include "seahorn/GuessCandidates.hh"
 
 #include "ufo/Expr.hpp"
+#include "ufo/ExprMemo.hh"
 #include "ufo/Smt/Z3n.hpp"
 #include "ufo/Smt/EZ3.hh"
 #include "seahorn/HornClauseDBWto.hh"
@@ -44,9 +45,11 @@ namespace seahorn
 	    std::map<Expr, ExprVector> m_currentCandidates;
 
 	    HornifyModule& m_hm;
+	    // instantiations of candidates, keyed by predicate application
+	    RewriteMemo m_memo;
 
 	public:
-	    PredicateAbstractionAnalysis(HornifyModule &hm) : m_hm(hm) {}
+	    PredicateAbstractionAnalysis(HornifyModule &hm) : m_hm(hm), m_memo(hm.getExprFactory()) {}
 	    ~PredicateAbstractionAnalysis() {}
 
 		void guessCandidate(HornClauseDB &db);
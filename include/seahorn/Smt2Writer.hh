@@ -0,0 +1,95 @@
+#ifndef _SMT2_WRITER__HH_
+#define _SMT2_WRITER__HH_
+
+#include "seahorn/HornClauseDB.hh"
+#include "ufo/Expr.hpp"
+#include "ufo/Smt/EZ3.hh"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace seahorn
+{
+  using namespace llvm;
+
+  /**
+   * Writes a HornClauseDB in SMT-LIB2 without loading it into a
+   * ZFixedPoint.
+   *
+   * Rules are written one at a time straight to the output stream, so
+   * that no memory is used beyond the database and the rule being
+   * written. Every compound sub-expression that occurs more than once
+   * in a rule is written once and bound by a let. Expressions that
+   * have no native SMT-LIB2 form (e.g., quantifiers) are written by a
+   * scratch Z3 context that is dropped after each rule.
+   *
+   * By default, the output uses the fixedpoint extensions of Z3
+   * (declare-rel, declare-var, rule, query). A pure writer produces
+   * standard SMT-LIB2 in the HORN logic instead.
+   */
+  class Smt2Writer
+  {
+    const HornClauseDB &m_db;
+    bool m_pure;
+    /// -- scratch context of the current rule, if any
+    std::unique_ptr<ufo::EZ3> m_zctx;
+
+    /// -- printed names of the function declarations
+    std::unordered_map<Expr, std::string> m_names;
+
+    /// -- the sub-expressions of the current rule
+    struct Info
+    {
+      /// number of parents in the rule
+      unsigned refs;
+      /// number of nested lets needed to write the expression
+      unsigned height;
+      /// index of the let variable, or -1 if not bound
+      int id;
+      Info () : refs (0), height (0), id (-1) {}
+    };
+    std::unordered_map<Expr, Info> m_info;
+    /// -- let-bound expressions of the current rule by height
+    std::vector<ExprVector> m_lets;
+    /// -- number of let bindings written
+    unsigned m_numLets;
+
+    /// -- e written by Z3
+    std::string toSmtLib (Expr e);
+
+    enum Kind { ATOM, APP, OTHER };
+    Kind kind (Expr e, ExprVector &kids);
+
+    void writeName (raw_ostream &out, Expr fdecl);
+    void writeSort (raw_ostream &out, Expr ty);
+    void writeAtom (raw_ostream &out, Expr e);
+    void writeOp (raw_ostream &out, Expr e);
+    /// -- writes (v sort) for a variable v
+    void writeVarDecl (raw_ostream &out, Expr v);
+
+    /// -- computes the let bindings of e
+    void share (Expr e);
+    /// -- writes e using the let bindings. A bound e is written in
+    /// -- full if expand is true
+    void writeTerm (raw_ostream &out, Expr e, bool expand = false);
+    /// -- writes e with its let bindings
+    void writeExpr (raw_ostream &out, Expr e);
+
+    void writeRule (raw_ostream &out, const HornRule &r);
+    void writeQuery (raw_ostream &out, Expr q);
+
+  public:
+    Smt2Writer (const HornClauseDB &db, bool pure = false) :
+      m_db (db), m_pure (pure), m_numLets (0) {}
+
+    void write (raw_ostream &out);
+
+    /// number of let bindings written so far
+    unsigned numLets () const { return m_numLets; }
+  };
+}
+
+#endif
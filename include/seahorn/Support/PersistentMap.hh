@@ -0,0 +1,372 @@
+#ifndef __PERSISTENT_MAP_HH_
+#define __PERSISTENT_MAP_HH_
+/// A persistent hash map. Copies share structure and are O(1).
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "boost/intrusive_ptr.hpp"
+
+namespace seahorn
+{
+  /**
+   * A hash array mapped trie. Every node has up to 32 slots, indexed
+   * by 5 bits of the hash of the key. A slot holds either a single
+   * binding or a sub-trie. Keys whose hashes agree on all bits are kept
+   * in a collision node at the bottom of the trie.
+   *
+   * Nodes are reference counted and shared between copies of a map.
+   * An update copies only the nodes on the path to the changed slot
+   * that are shared with another map, and updates the others in place.
+   * Comparing two maps that share structure skips the shared sub-tries.
+   *
+   * Not thread-safe, even for maps that share structure.
+   */
+  template <typename K, typename V,
+            typename Hash = std::hash<K>, typename Equal = std::equal_to<K> >
+  class PersistentMap
+  {
+  public:
+    typedef std::pair<K,V> value_type;
+
+  private:
+    struct Node;
+    typedef boost::intrusive_ptr<Node> NodePtr;
+
+    static const unsigned BITS = 5;
+    static const unsigned HASH_BITS = sizeof (size_t) * 8;
+
+    struct Node
+    {
+      unsigned m_refs;
+      /// slots that hold a binding
+      uint32_t m_datamap;
+      /// slots that hold a sub-trie
+      uint32_t m_nodemap;
+      /// bindings, in slot order. All bindings of a collision node
+      std::vector<value_type> m_data;
+      /// sub-tries, in slot order
+      std::vector<NodePtr> m_kids;
+
+      Node () : m_refs (0), m_datamap (0), m_nodemap (0) {}
+      /// a copy is not referenced. Its sub-tries become shared
+      Node (const Node &o) :
+        m_refs (0), m_datamap (o.m_datamap), m_nodemap (o.m_nodemap),
+        m_data (o.m_data), m_kids (o.m_kids) {}
+
+      friend void intrusive_ptr_add_ref (Node *n) { ++n->m_refs; }
+      friend void intrusive_ptr_release (Node *n)
+      { if (--n->m_refs == 0) delete n; }
+    };
+
+    NodePtr m_root;
+    size_t m_size;
+
+    static unsigned slot (size_t h, unsigned shift)
+    { return (h >> shift) & 31; }
+    static uint32_t bit (unsigned s) { return uint32_t (1) << s; }
+    static unsigned index (uint32_t map, uint32_t b)
+    { return __builtin_popcount (map & (b - 1)); }
+    static bool isCollision (unsigned shift) { return shift >= HASH_BITS; }
+
+    static const V *find (const Node *n, unsigned shift, size_t h, const K &k)
+    {
+      while (n)
+      {
+        if (isCollision (shift))
+        {
+          for (const value_type &kv : n->m_data)
+            if (Equal () (kv.first, k)) return &kv.second;
+          return nullptr;
+        }
+
+        uint32_t b = bit (slot (h, shift));
+        if (n->m_datamap & b)
+        {
+          const value_type &kv = n->m_data [index (n->m_datamap, b)];
+          return Equal () (kv.first, k) ? &kv.second : nullptr;
+        }
+        if (!(n->m_nodemap & b)) return nullptr;
+        n = n->m_kids [index (n->m_nodemap, b)].get ();
+        shift += BITS;
+      }
+      return nullptr;
+    }
+
+    /// a trie at the given shift that holds two bindings
+    static NodePtr pair (unsigned shift, size_t h1, value_type &&kv1,
+                         size_t h2, value_type &&kv2)
+    {
+      NodePtr n (new Node ());
+      if (isCollision (shift))
+      {
+        n->m_data.push_back (std::move (kv1));
+        n->m_data.push_back (std::move (kv2));
+        return n;
+      }
+
+      unsigned s1 = slot (h1, shift), s2 = slot (h2, shift);
+      if (s1 == s2)
+      {
+        n->m_nodemap = bit (s1);
+        n->m_kids.push_back (pair (shift + BITS, h1, std::move (kv1),
+                                   h2, std::move (kv2)));
+        return n;
+      }
+
+      n->m_datamap = bit (s1) | bit (s2);
+      if (s1 > s2)
+      {
+        n->m_data.push_back (std::move (kv2));
+        n->m_data.push_back (std::move (kv1));
+      }
+      else
+      {
+        n->m_data.push_back (std::move (kv1));
+        n->m_data.push_back (std::move (kv2));
+      }
+      return n;
+    }
+
+    /// binds k to v in the trie n. Returns the updated trie. Nodes that
+    /// are not shared are updated in place. added is set if k is new
+    static NodePtr set (NodePtr n, unsigned shift, size_t h,
+                        const K &k, const V &v, bool &added)
+    {
+      // -- n is shared unless the only reference to it is the argument
+      if (n->m_refs > 1) n = NodePtr (new Node (*n));
+
+      if (isCollision (shift))
+      {
+        for (value_type &kv : n->m_data)
+          if (Equal () (kv.first, k)) { kv.second = v; return n; }
+        n->m_data.push_back (value_type (k, v));
+        added = true;
+        return n;
+      }
+
+      uint32_t b = bit (slot (h, shift));
+      if (n->m_datamap & b)
+      {
+        unsigned i = index (n->m_datamap, b);
+        if (Equal () (n->m_data [i].first, k))
+        {
+          n->m_data [i].second = v;
+          return n;
+        }
+
+        // -- push the existing binding down into a new sub-trie
+        value_type old (std::move (n->m_data [i]));
+        size_t oh = Hash () (old.first);
+        n->m_data.erase (n->m_data.begin () + i);
+        n->m_datamap &= ~b;
+        n->m_nodemap |= b;
+        n->m_kids.insert (n->m_kids.begin () + index (n->m_nodemap, b),
+                          pair (shift + BITS, oh, std::move (old),
+                                h, value_type (k, v)));
+        added = true;
+        return n;
+      }
+
+      if (n->m_nodemap & b)
+      {
+        NodePtr &kid = n->m_kids [index (n->m_nodemap, b)];
+        // -- release our reference so that an unshared kid is updated
+        // -- in place
+        NodePtr tmp;
+        tmp.swap (kid);
+        kid = set (std::move (tmp), shift + BITS, h, k, v, added);
+        return n;
+      }
+
+      n->m_datamap |= b;
+      n->m_data.insert (n->m_data.begin () + index (n->m_datamap, b),
+                        value_type (k, v));
+      added = true;
+      return n;
+    }
+
+    template <typename F>
+    static void forEach (const Node *n, F &f)
+    {
+      if (!n) return;
+      for (const value_type &kv : n->m_data) f (kv);
+      for (const NodePtr &kid : n->m_kids) forEach (kid.get (), f);
+    }
+
+    /// the bindings of slot s of n, as a trie at the level below n
+    static void slotBindings (const Node *n, uint32_t b,
+                              std::vector<const value_type*> &out)
+    {
+      if (n->m_datamap & b)
+        out.push_back (&n->m_data [index (n->m_datamap, b)]);
+      else if (n->m_nodemap & b)
+      {
+        auto push = [&out] (const value_type &kv) { out.push_back (&kv); };
+        forEach (n->m_kids [index (n->m_nodemap, b)].get (), push);
+      }
+    }
+
+    template <typename F>
+    static void diffBindings (const std::vector<const value_type*> &a,
+                              const std::vector<const value_type*> &b, F &f)
+    {
+      for (const value_type *x : a)
+      {
+        const V *other = nullptr;
+        for (const value_type *y : b)
+          if (Equal () (x->first, y->first)) { other = &y->second; break; }
+        if (!other || !(*other == x->second)) f (x->first, &x->second, other);
+      }
+      for (const value_type *y : b)
+      {
+        bool found = false;
+        for (const value_type *x : a)
+          if (Equal () (x->first, y->first)) { found = true; break; }
+        if (!found) f (y->first, nullptr, &y->second);
+      }
+    }
+
+    template <typename F>
+    static void diff (const Node *a, const Node *b, unsigned shift, F &f)
+    {
+      if (a == b) return;
+
+      std::vector<const value_type*> as, bs;
+      if (!a || !b || isCollision (shift))
+      {
+        auto pa = [&as] (const value_type &kv) { as.push_back (&kv); };
+        auto pb = [&bs] (const value_type &kv) { bs.push_back (&kv); };
+        forEach (a, pa);
+        forEach (b, pb);
+        diffBindings (as, bs, f);
+        return;
+      }
+
+      uint32_t used = a->m_datamap | a->m_nodemap | b->m_datamap | b->m_nodemap;
+      for (unsigned s = 0; s < 32; ++s)
+      {
+        uint32_t m = bit (s);
+        if (!(used & m)) continue;
+        if ((a->m_nodemap & m) && (b->m_nodemap & m))
+        {
+          diff (a->m_kids [index (a->m_nodemap, m)].get (),
+                b->m_kids [index (b->m_nodemap, m)].get (), shift + BITS, f);
+          continue;
+        }
+        as.clear ();
+        bs.clear ();
+        slotBindings (a, m, as);
+        slotBindings (b, m, bs);
+        diffBindings (as, bs, f);
+      }
+    }
+
+  public:
+    PersistentMap () : m_size (0) {}
+
+    size_t size () const { return m_size; }
+    bool empty () const { return m_size == 0; }
+    void clear () { m_root.reset (); m_size = 0; }
+
+    /// the value bound to k, or null
+    const V *find (const K &k) const
+    { return find (m_root.get (), 0, Hash () (k), k); }
+    size_t count (const K &k) const { return find (k) ? 1 : 0; }
+
+    /// binds k to v
+    void set (const K &k, const V &v)
+    {
+      bool added = false;
+      if (!m_root) m_root = NodePtr (new Node ());
+      NodePtr root;
+      root.swap (m_root);
+      m_root = set (std::move (root), 0, Hash () (k), k, v, added);
+      if (added) ++m_size;
+    }
+
+    /// calls f (binding) for every binding, in no particular order
+    template <typename F>
+    void forEach (F f) const { forEach (m_root.get (), f); }
+
+    /// calls f (key, mine, theirs) for every key whose binding in this
+    /// map differs from the one in o. A missing binding is null. The
+    /// cost is proportional to the part of the tries not shared by the
+    /// two maps
+    template <typename F>
+    void diff (const PersistentMap &o, F f) const
+    { diff (m_root.get (), o.m_root.get (), 0, f); }
+
+    /// forward iterator over the bindings
+    class const_iterator
+    {
+      struct Frame
+      {
+        const Node *n;
+        unsigned data;
+        unsigned kid;
+      };
+      std::vector<Frame> m_stack;
+
+      /// advance to the next binding, starting at the top frame
+      void settle ()
+      {
+        while (!m_stack.empty ())
+        {
+          Frame &f = m_stack.back ();
+          if (f.data < f.n->m_data.size ()) return;
+          if (f.kid < f.n->m_kids.size ())
+          {
+            const Node *kid = f.n->m_kids [f.kid++].get ();
+            m_stack.push_back (Frame {kid, 0, 0});
+            continue;
+          }
+          m_stack.pop_back ();
+        }
+      }
+
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef typename PersistentMap::value_type value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const value_type *pointer;
+      typedef const value_type &reference;
+
+      const_iterator () {}
+      explicit const_iterator (const Node *root)
+      {
+        if (root) m_stack.push_back (Frame {root, 0, 0});
+        settle ();
+      }
+
+      reference operator* () const
+      { const Frame &f = m_stack.back (); return f.n->m_data [f.data]; }
+      pointer operator-> () const { return &**this; }
+
+      const_iterator &operator++ ()
+      {
+        ++m_stack.back ().data;
+        settle ();
+        return *this;
+      }
+      const_iterator operator++ (int)
+      { const_iterator res (*this); ++*this; return res; }
+
+      bool operator== (const const_iterator &o) const
+      {
+        if (m_stack.empty () || o.m_stack.empty ())
+          return m_stack.empty () == o.m_stack.empty ();
+        return m_stack.back ().n == o.m_stack.back ().n &&
+          m_stack.back ().data == o.m_stack.back ().data;
+      }
+      bool operator!= (const const_iterator &o) const { return !(*this == o); }
+    };
+
+    const_iterator begin () const { return const_iterator (m_root.get ()); }
+    const_iterator end () const { return const_iterator (); }
+  };
+}
+
+#endif
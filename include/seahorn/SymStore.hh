@@ -3,6 +3,7 @@
 /// A symbolic store is a map from symbolic registers to symbolic values.
 
 #include "ufo/Expr.hpp"
+#include "seahorn/Support/PersistentMap.hh"
 
 #include "llvm/Support/raw_ostream.h"
 #include <memory>
@@ -44,7 +45,8 @@ namespace seahorn
     
   public:
     typedef std::shared_ptr<SymStore> SymStorePtr;
-    typedef std::unordered_map<Expr,Expr> ExprExprMap;
+    /// persistent, so that copies of a store share their bindings
+    typedef PersistentMap<Expr,Expr> ExprExprMap;
     
   protected:
     /// Parent store, if any
@@ -53,17 +55,33 @@ namespace seahorn
     SymStorePtr m_ownedParent;
     
     
-    /// The store
+    /// The store. Copying it is O(1)
     ExprExprMap m_Store;
     
     ExprFactory &m_efac;
     
     bool m_trackUse;
     
-    ExprVector m_uses;
-    ExprVector m_defs;
+    /// reads and writes, if tracked. Shared between copies until one
+    /// of them changes them. Null when empty
+    typedef std::shared_ptr<ExprVector> ExprVectorPtr;
+    ExprVectorPtr m_uses;
+    ExprVectorPtr m_defs;
     size_t m_defs_sz;
     
+    /// the vector of v for writing. Copies it if it is shared
+    static ExprVector &mut (ExprVectorPtr &v)
+    {
+      if (!v) v = std::make_shared<ExprVector> ();
+      else if (v.use_count () > 1) v = std::make_shared<ExprVector> (*v);
+      return *v;
+    }
+    static const ExprVector &get (const ExprVectorPtr &v)
+    {
+      static const ExprVector empty;
+      return v ? *v : empty;
+    }
+    
     detail::SymStoreEvalVisitor m_evalVisitor;
     
   public:
@@ -73,13 +91,13 @@ namespace seahorn
     /// reads and writes.
     SymStore (SymStore &parent, bool trackUse) : 
       m_Parent (&parent), m_efac (m_Parent->getExprFactory ()), m_trackUse (trackUse), 
-      m_uses (), m_defs (), m_defs_sz (m_defs.size ()),
+      m_defs_sz (0),
       m_evalVisitor (*this) {}
     
     /// Create a SymStore. If globalParent is true, the created store has no parent.
     SymStore (ExprFactory &efac, bool trackUse = false, bool globalParent = false) : 
       m_Parent(NULL), m_efac (efac), m_trackUse (trackUse),       
-      m_uses (), m_defs (), m_defs_sz (m_defs.size ()),
+      m_defs_sz (0),
       m_evalVisitor (*this) 
     {
       if (!globalParent)
@@ -115,21 +133,19 @@ namespace seahorn
     ExprFactory &getExprFactory () { return m_efac; }
     
     
-    bool isDefined (Expr key) const { return m_Store.count (key) > 0; }
+    bool isDefined (Expr key) const { return m_Store.find (key) != nullptr; }
     
     Expr at (Expr key) const
     {
-      if (isDefined (key)) return m_Store.at (key);
-      return Expr(0);
+      const Expr *val = m_Store.find (key);
+      return val ? *val : Expr(0);
     }
     
     Expr eval (Expr exp) { return expr::dagVisit (m_evalVisitor, exp); }
     Expr operator() (Expr exp) { return eval (exp); }
     
-    typedef ExprExprMap::iterator iterator;
+    typedef ExprExprMap::const_iterator iterator;
     typedef ExprExprMap::const_iterator const_iterator;
-    iterator begin () { return m_Store.begin (); }
-    iterator end () { return m_Store.end (); }
     const_iterator begin () const { return m_Store.begin (); }
     const_iterator end () const { return m_Store.end (); }
    
@@ -137,8 +153,8 @@ namespace seahorn
     void reset ()
     {
       m_Store.clear ();
-      m_uses.clear ();
-      m_defs.clear ();
+      m_uses.reset ();
+      m_defs.reset ();
       m_defs_sz = 0;
       // if (m_ownedParent) m_ownedParent.reset (new SymStore (efac, false, true));
       if (m_ownedParent) m_ownedParent->reset ();
@@ -146,8 +162,9 @@ namespace seahorn
     
     
     template <typename R>
-    void uses (R &u) {m_uses.assign (std::begin (u), std::end (u));}
-    const ExprVector &uses () const { return m_uses; }
+    void uses (R &u) 
+    {m_uses = std::make_shared<ExprVector> (std::begin (u), std::end (u));}
+    const ExprVector &uses () const { return get (m_uses); }
     const ExprVector &defs ();
     
     void write (Expr key, Expr val);
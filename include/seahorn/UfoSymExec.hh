@@ -67,6 +67,10 @@ namespace seahorn
                    SmallVectorImpl<const Type *> &ts);
     unsigned storageSize (const llvm::Type *t);
     unsigned fieldOff (const StructType *t, unsigned field);
+
+    /// -- the values of the options of UfoSmallSymExec and
+    /// -- UfoLargeSymExec, one name=value per line
+    static std::string optionsKey ();
   }; 
   
 
@@ -0,0 +1,13 @@
+#ifndef _ZOPTION__HH_
+#define _ZOPTION__HH_
+
+#include <cstddef>
+
+namespace seahorn
+{
+  /// memory budget in bytes of the Expr <-> ast cache of the Z3
+  /// contexts of SeaHorn (--zctx-cache-budget). 0 means unbounded
+  size_t zctxCacheBudget ();
+}
+
+#endif
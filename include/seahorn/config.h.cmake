@@ -3,6 +3,9 @@
 
 #define SEAHORN_VERSION_INFO "${SeaHorn_VERSION_INFO}"
 
+/* git revision of the sources, empty if unknown */
+#define SEAHORN_GIT_REVISION "${SeaHorn_GIT_REVISION}"
+
 /* Define whether crab is available */
 #cmakedefine HAVE_CRAB ${HAVE_CRAB}
 
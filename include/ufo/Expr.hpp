@@ -35,6 +35,10 @@ DM-0002198
 #include <unordered_map>
 #include <memory>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 
 #include <gmpxx.h>
 
@@ -42,6 +46,7 @@ DM-0002198
 #include <boost/intrusive_ptr.hpp>
 #include <boost/interprocess/containers/flat_set.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/iterator/iterator_adaptor.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/utility.hpp>
@@ -88,6 +93,27 @@ namespace expr
   //inline ENode* eptr (Expr e) { return e.get (); }
 
   class Operator;
+
+  namespace details
+  {
+    /** returns a fresh operator type tag. Tags start at 1 */
+    inline unsigned nextOperatorTag ()
+    {
+      static std::atomic<unsigned> cnt (0);
+      return ++cnt;
+    }
+    
+    /** compact integer identifier of an operator type */
+    template <typename T>
+    struct OperatorTag
+    {
+      static unsigned get ()
+      {
+        static const unsigned tag = nextOperatorTag ();
+        return tag;
+      }
+    };
+  }
     
   /* An operator (a.k.a. a tag) of an expression node */
   class Operator
@@ -109,9 +135,16 @@ namespace expr
     virtual bool operator== (const Operator& rhs) const = 0;
     virtual bool operator< (const Operator& rhs) const = 0;
     virtual size_t hash () const = 0;
+    /** A small integer that uniquely identifies the type of the
+        operator within a run. Cheaper to compare than typeid */
+    virtual unsigned typeTag () const = 0;
     virtual bool isMutable () const { return false; }
     /* Returns a heap-allocated clone of this */
     virtual Operator* clone (ExprFactoryAllocator &allocator) const = 0;
+    /** Returns a shared instance equal to this if the operator
+        carries no data, and NULL otherwise. Nodes use the shared
+        instance instead of a clone */
+    virtual const Operator* interned () const { return NULL; }
   };
 
 
@@ -121,6 +154,52 @@ namespace expr
     return OS;
   }
 
+  namespace details
+  {
+    /**
+     * Operators that carry no data, by the name of their type. Every
+     * DefOp registers itself before main, so that an operator can be
+     * recovered from its name (see ExprIO.hpp).
+     */
+    class OperatorRegistry
+    {
+      typedef std::map<std::string, const Operator*> table_type;
+
+      static table_type &table ()
+      {
+        static table_type t;
+        return t;
+      }
+
+      static std::mutex &lock ()
+      {
+        static std::mutex m;
+        return m;
+      }
+
+    public:
+      static void add (const Operator *op)
+      {
+        std::lock_guard<std::mutex> guard (lock ());
+        table ().insert (std::make_pair (std::string (typeid (*op).name ()), op));
+      }
+
+      /** returns the operator whose type is called name, or NULL */
+      static const Operator *find (const std::string &name)
+      {
+        std::lock_guard<std::mutex> guard (lock ());
+        auto it = table ().find (name);
+        return it == table ().end () ? NULL : it->second;
+      }
+    };
+
+    template <typename T>
+    struct OperatorRegistrar
+    {
+      OperatorRegistrar () { OperatorRegistry::add (T ().interned ()); }
+    };
+  }
+
 
   /* An expression node (a.k.a. an enode). A pointer into an
      expression tree (or DAG)  */
@@ -128,27 +207,60 @@ namespace expr
   {
   private:
     // // -- no default constructor
-    ENode () : id(0), count(0), fac(NULL) {}
+    ENode ();
     // // -- no copy constructor
-    ENode (const ENode &) : count(0), fac(NULL) {}
+    ENode (const ENode &);
+    
+#define ENODE_INLINE_ARGS 2
   protected:
     /** unique identifier of this expression node */
     unsigned int id;
-    /** reference counter */
-    unsigned int count;
+    /** reference counter. Atomic so that terms can be shared between
+        threads of a concurrent ExprFactory */
+    std::atomic<unsigned int> count;
+    /** structural hash. Computed once before hash-consing */
+    size_t m_hash;
 
     ExprFactory *fac;
-    std::vector<ENode*> args;
-
-    std::shared_ptr<Operator> oper;
     
+    /** the operator. Either a shared instance of a stateless operator
+        or a clone owned by the node */
+    const Operator *oper;
+    
+    /** arguments. Point to m_inline unless the node has more than
+        ENODE_INLINE_ARGS arguments, in which case the array is
+        allocated from the allocator of the factory */
+    ENode **m_args;
+    unsigned m_arity;
+    unsigned m_capacity;
+    ENode *m_inline [ENODE_INLINE_ARGS];
     
-    void Deref () { if (count > 0) count--; }
+    
+    inline void Deref ();
+    
+    /** drops a reference unless it is the last one. Returns true on
+        success */
+    bool DerefShared ()
+    {
+      unsigned int c = count.load (std::memory_order_relaxed);
+      while (c > 1)
+        if (count.compare_exchange_weak (c, c - 1)) return true;
+      return false;
+    }
 
 
     /** assigns a unique id to the node */
     void setId (unsigned int v) { id = v; }
     
+    /** computes and caches the structural hash of the node */
+    inline void computeHash ();
+    
+    /** grows the argument array to hold at least n arguments */
+    inline void reserve (unsigned n);
+    
+    /** releases the out-of-line argument array, if any. Does not
+        dereference the arguments */
+    inline void releaseArgs ();
     
   public:
     ENode (ExprFactory &f, const Operator &o);
@@ -159,43 +271,63 @@ namespace expr
 
     /** returns the unique id of this expression */
     unsigned int getId () const { return id; }
+    
+    /** returns the cached structural hash */
+    size_t hash () const { return m_hash; }
 
-    void Ref () { count++; }
-    bool isGarbage () const { return count == 0; }
+    inline void Ref ();
+    bool isGarbage () const { return count.load () == 0; }
     bool isMutable () const { return oper->isMutable (); }
 
-    unsigned int use_count () { return count; }
+    unsigned int use_count () { return count.load (std::memory_order_relaxed); }
 
     ENode* operator[] (size_t p) { return arg (p); }
-    ENode* arg (size_t p) { return args [p]; }
+    ENode* arg (size_t p) { return m_args [p]; }
     
     ENode* left () 
-    { return (args.size () > 0) ? args [0] : NULL; }
+    { return (m_arity > 0) ? m_args [0] : NULL; }
 
     ENode* right ()
-    { return (args.size () > 1) ? args [1] : NULL; }
+    { return (m_arity > 1) ? m_args [1] : NULL; }
 
     ENode *first () { return left (); }
     ENode *last ()
-    { return args.size () > 0 ? args [args.size () - 1] : NULL; }
+    { return m_arity > 0 ? m_args [m_arity - 1] : NULL; }
     
 
-    typedef std::vector<ENode*>::const_iterator args_iterator;
+    /** random access iterator over the arguments. A class type so
+        that a temporary can be advanced, as in ++(e->args_begin ()) */
+    class args_iterator : 
+      public boost::iterator_adaptor<args_iterator, ENode* const*>
+    {
+    public:
+      args_iterator () {}
+      explicit args_iterator (ENode* const *p) : 
+        args_iterator::iterator_adaptor_ (p) {}
+    };
 
-    bool args_empty () const { return args.empty () ; }
-    args_iterator args_begin () const { return args.begin (); }
-    args_iterator args_end () const { return args.end (); }
+    bool args_empty () const { return m_arity == 0; }
+    args_iterator args_begin () const { return args_iterator (m_args); }
+    args_iterator args_end () const { return args_iterator (m_args + m_arity); }
 
     template <typename iterator>
     void renew_args (iterator b, iterator e);
 
-    void push_back (ENode* a) { args.push_back (a); a->Ref (); }
+    void push_back (ENode* a) 
+    { 
+      if (m_arity == m_capacity) reserve (2 * m_capacity);
+      m_args [m_arity++] = a;
+      a->Ref (); 
+    }
 
-    size_t arity () const { return args.size (); } 
+    size_t arity () const { return m_arity; } 
     
     const Operator& op () const { return *oper; } 
     void Print (std::ostream &OS, int depth = 0, bool brkt = true) const 
-    { oper->Print (OS, args, depth, brkt); }
+    { 
+      std::vector<ENode*> args (args_begin (), args_end ());
+      oper->Print (OS, args, depth, brkt); 
+    }
 
     friend struct LessENode;
     friend class ExprFactory;
@@ -217,55 +349,36 @@ namespace expr
 
   struct ENodeUniqueHash
   {
-    std::size_t operator() (const ENode *e) const
+    std::size_t operator() (const ENode *e) const { return e->hash (); }
+    
+    /** structural hash of e: its operator and argument pointers */
+    static std::size_t compute (const ENode *e)
     {
       size_t res = e->op ().hash ();
-
-      size_t a = e->arity ();
-      if (a == 0) return res;
-
-      ENode::args_iterator it = e->args_begin ();
-      if (a >= 1) 
-	boost::hash_combine (res, *it);
-      
-      if (a >= 2)
-	boost::hash_combine (res, 
-			     boost::hash_range (it, e->args_end ()));
-
-      return res;
-      
-      // if (a == 2) 
-      // 	{
-      // 	  boost::hash_combine (res, *it);
-      // 	  ++it;
-      // 	  boost::hash_combine (res, *it);
-      // 	  return res;
-      // 	}
-      // if (a == 3) 
-      // 	{
-      // 	  boost::hash_combine (res, *it);
-      // 	  it++;
-      // 	  boost::hash_combine (res, *it);
-      // 	  it++;
-      // 	  boost::hash_combine (res, *it);
-      // 	  return res;
-      // 	}
-      
-      // // -- n-arry with more than 3 children
-      // boost::hash_combine (res, 
-      // 			   boost::hash_range (e->args_begin (), 
-      // 					      e->args_end ()));
-      // return res;
+      for (ENode::args_iterator it = e->args_begin (), end = e->args_end ();
+           it != end; ++it)
+        boost::hash_combine (res, *it);
       
+      // -- finalize so that both the low bits (slot in a table) and
+      // -- the high bits (shard of the table) are well distributed
+      uint64_t h = res;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return static_cast<size_t> (h);
     }
   };
     
+  inline void ENode::computeHash () { m_hash = ENodeUniqueHash::compute (this); }
+    
   struct ENodeUniqueEqual
   {
     bool operator () (ENode* const &e1, ENode* const &e2) const
     {
       // -- same type
-      if (typeid (e1->op ()) == typeid (e2->op ()))
+      if (e1->op ().typeTag () == e2->op ().typeTag ())
 	// -- same number of children
 	if (e1->arity () == e2->arity ())
 	  // -- operators (if have data) are equal
@@ -286,7 +399,7 @@ namespace expr
       if (typeid (e1->op ()) == typeid (e2->op ()))
 	{
 	  if (e1->op () == e2->op ())
-	    return lexicographical_compare (e1->args_begin (), 
+	    return std::lexicographical_compare (e1->args_begin (), 
 					    e1->args_end (),
 					    e2->args_begin (),
 					    e2->args_end ());
@@ -299,6 +412,100 @@ namespace expr
     }
   };
 
+
+  /**
+   * Flat open-addressing table of hash-consed nodes. 
+   *
+   * Slots hold a node together with its cached structural hash so
+   * that most mismatches are rejected without touching the node.
+   * Collisions are resolved by linear probing, and erase uses
+   * backward-shift deletion so that no tombstones are left behind.
+   */
+  class ENodeFlatTable
+  {
+    struct Slot
+    {
+      size_t hash;
+      ENode *node;
+    };
+    
+    std::vector<Slot> m_slots;
+    size_t m_size;
+
+    size_t mask () const { return m_slots.size () - 1; }
+
+    void grow ()
+    {
+      std::vector<Slot> old (m_slots.size () * 2);
+      old.swap (m_slots);
+      for (Slot &s : old)
+        if (s.node)
+        {
+          size_t i = s.hash & mask ();
+          while (m_slots [i].node) i = (i + 1) & mask ();
+          m_slots [i] = s;
+        }
+    }
+    
+  public:
+    ENodeFlatTable () : m_slots (16), m_size (0) {}
+
+    size_t size () const { return m_size; }
+    bool empty () const { return m_size == 0; }
+    
+    /** 
+     * Returns the node structurally equal to v. If there is none, v
+     * is inserted and returned. The hash of v must be computed.
+     */
+    ENode *insert (ENode *v)
+    {
+      // -- keep the load factor under 3/4
+      if (4 * (m_size + 1) > 3 * m_slots.size ()) grow ();
+      
+      size_t h = v->hash ();
+      size_t i = h & mask ();
+      ENodeUniqueEqual eq;
+      for (; m_slots [i].node; i = (i + 1) & mask ())
+        if (m_slots [i].hash == h && eq (m_slots [i].node, v)) 
+          return m_slots [i].node;
+      
+      m_slots [i].hash = h;
+      m_slots [i].node = v;
+      ++m_size;
+      return v;
+    }
+    
+    /** applies f to every node in the table */
+    template <typename F>
+    void forEach (F f) const
+    { for (const Slot &s : m_slots) if (s.node) f (s.node); }
+    
+    /** removes the node v (compared by address) */
+    void erase (ENode *v)
+    {
+      size_t i = v->hash () & mask ();
+      while (m_slots [i].node != v)
+      {
+        // -- can only remove things that have been inserted before
+        assert (m_slots [i].node);
+        i = (i + 1) & mask ();
+      }
+
+      // -- shift back the entries of the probe sequence that follows
+      for (size_t j = (i + 1) & mask (); m_slots [j].node; j = (j + 1) & mask ())
+      {
+        size_t k = m_slots [j].hash & mask ();
+        // -- the entry at j can move to the hole at i only if its
+        // -- home slot k is not cyclically in (i, j]
+        bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        m_slots [i] = m_slots [j];
+        i = j;
+      }
+      m_slots [i].node = NULL;
+      --m_size;
+    }
+  };
   
   /**
    * A type erasure of a cache
@@ -309,6 +516,9 @@ namespace expr
     virtual bool owns (const void *p) = 0;
     /** erases val from the underlying cache */
     virtual void erase (ENode *val) = 0;
+    /** erases a batch of values */
+    virtual void eraseAll (const std::vector<ENode*> &vals)
+    { for (ENode *v : vals) erase (v); }
     virtual ~CacheStub () { }
   };
   
@@ -342,8 +552,21 @@ namespace expr
     /** pool for small objects */
     boost::pool<> small;
 
+    /** 
+     * true if the allocator is shared between threads. The pools are
+     * then bypassed: memory comes from the global heap, whose
+     * per-thread arenas do not serialize the threads on a single
+     * lock. Memory is not released together with the allocator.
+     */
+    bool m_concurrent;
+
   public:
-    ExprFactoryAllocator () : tiny(8, 65536), small (64, 65536) {};
+    ExprFactoryAllocator () : tiny(8, 65536), small (64, 65536),
+                              m_concurrent (false) {};
+    
+    /** must be called before anything is allocated */
+    void setConcurrent (bool v) { m_concurrent = v; }
+    bool isConcurrent () const { return m_concurrent; }
     
     void *allocate (size_t n);
     void free (void *block);
@@ -357,7 +580,17 @@ namespace expr
   {
   protected:
 
+    // -- Implementation of the unique table. FLAT_UNIQUE_TABLE selects
+    // -- a single open-addressing table keyed by operator tag and
+    // -- arguments. Otherwise, there is a table per operator type that
+    // -- is either an unordered_set (UNORDERED_SET_UNIQUE_TABLE) or a set
+#ifndef NO_FLAT_UNIQUE_TABLE
+#define FLAT_UNIQUE_TABLE 1
+#endif
 #define UNORDERED_SET_UNIQUE_TABLE 1
+#ifdef FLAT_UNIQUE_TABLE
+    typedef ENodeFlatTable unique_type;
+#else
 #ifndef UNORDERED_SET_UNIQUE_TABLE
     // -- type of unique table entry
     typedef std::set<ENode*,LessENode> unique_entry_type;
@@ -369,74 +602,160 @@ namespace expr
     typedef const char* unique_key_type;
     // -- type of the unique table
     typedef std::map<unique_key_type,unique_entry_type> unique_type;
+#endif
 
-    typedef boost::ptr_vector<CacheStub> caches_type;
+    /** 
+     * A stripe of the unique table. A node is stored in the shard
+     * selected by its structural hash. In concurrent mode each shard
+     * is protected by its own lock.
+     */
+    struct unique_shard
+    {
+      std::mutex mutex;
+      unique_type table;
+    };
+    
+#define UNIQUE_TABLE_SHARDS 64
+    typedef std::array<unique_shard, UNIQUE_TABLE_SHARDS> shards_type;
+    
+    /** 
+     * The list of registered caches is copied on write. In concurrent
+     * mode, caches are cleared from a snapshot of the list outside of
+     * cachesMutex since clearing a cache can release nodes and
+     * re-enter clearCaches ().
+     */
+    typedef std::vector<std::shared_ptr<CacheStub> > caches_type;
+    typedef std::shared_ptr<const caches_type> caches_ptr;
     
+    typedef std::unique_lock<std::mutex> lock_type;
 
     /** pool allocator */
     ExprFactoryAllocator allocator;
 
     /** list of registered caches */
-    caches_type caches;
+    caches_ptr caches;
     
     // -- unique table
-    unique_type unique;
+    shards_type unique;
+
+    /** true if the factory is shared between threads */
+    const bool m_concurrent;
+    
+    /** protects the pointer to the list of registered caches in
+        concurrent mode */
+    std::mutex cachesMutex;
 
     /** counter for assigning unique ids*/
-    unsigned int idCount;
+    std::atomic<unsigned int> idCount;
     
     /** returns a unique id > 0 */
     unsigned int uniqueId () { return ++idCount; }
+
+    /** acquires m if the factory is in concurrent mode */
+    lock_type lock (std::mutex &m)
+    { return m_concurrent ? lock_type (m) : lock_type (m, std::defer_lock); }
+    
+    /** the shard of v. Uses the high bits of the hash, the low bits
+        index into the shard */
+    unique_shard &shardOf (ENode *v)
+    { return unique [(v->hash () >> 20) % UNIQUE_TABLE_SHARDS]; }
     
     /** 
-     * Remove value from unique table
+     * Remove value from a shard of the unique table. 
+     * The lock of the shard must be held.
      */
-    void Remove (ENode *val)
-    { 
-      clearCaches (val);
-      if (!val->isMutable ())
-	{
-	  unique_type::iterator it = unique.find (typeid (val->op ()).name ());
-	  // -- can only remove things that have been inserted before
-	  assert (it != unique.end ());
-	  it->second.erase (val);
-	  if (it->second.empty ()) unique.erase (it);
-	}
-
-      freeNode (val);
+    void eraseUnique (unique_shard &shard, ENode *val)
+    {
+#ifdef FLAT_UNIQUE_TABLE
+      shard.table.erase (val);
+#else
+      unique_type::iterator it = shard.table.find (typeid (val->op ()).name ());
+      // -- can only remove things that have been inserted before
+      assert (it != shard.table.end ());
+      it->second.erase (val);
+      if (it->second.empty ()) shard.table.erase (it);
+#endif
+    }
+    
+    /** applies f to every node in the unique table */
+    template <typename F>
+    void forEachUnique (F f)
+    {
+      for (unique_shard &shard : unique)
+#ifdef FLAT_UNIQUE_TABLE
+        shard.table.forEach (f);
+#else
+        for (auto &kv : shard.table)
+          for (ENode *n : kv.second) f (n);
+#endif
+    }
+    
+    /** 
+     * Returns the node in the shard equal to v, inserting v if there
+     * is none. The lock of the shard must be held.
+     */
+    ENode *insertUnique (unique_shard &shard, ENode *v)
+    {
+#ifdef FLAT_UNIQUE_TABLE
+      return shard.table.insert (v);
+#else
+      return *(shard.table [typeid (v->op ()).name ()].insert (v).first);
+#endif
     }
 
     /**
      * Clear val from all registered caches
      */
-    void clearCaches (ENode *val) { for (CacheStub &c : caches) c.erase (val); }
+    void clearCaches (ENode *val) 
+    {
+      if (!m_concurrent)
+        {
+          for (const std::shared_ptr<CacheStub> &c : *caches) c->erase (val);
+          return;
+        }
+      
+      caches_ptr snapshot = cachesSnapshot ();
+      for (const std::shared_ptr<CacheStub> &c : *snapshot) c->erase (val);
+    }
+    
+    /** the current list of registered caches */
+    caches_ptr cachesSnapshot ()
+    {
+      lock_type lk = lock (cachesMutex);
+      return caches;
+    }
     
     
 
     /**
-     * Return the canonical (unique) representetive of the input
+     * Return the canonical (unique) representetive of the input. The
+     * result is returned referenced: the reference is taken while the
+     * unique table is locked so that a concurrent Deref cannot
+     * reclaim the node before the caller gets hold of it.
      */
     ENode* canonize (ENode* v)
     {
       if (v->isMutable ()) 
 	{
 	  v->setId (uniqueId ());
+          v->Ref ();
 	  return v;
 	}
       
-
-      std::pair<unique_entry_type::iterator,bool> x = 
-	unique [typeid (v->op ()).name ()].insert (v);
-      if (x.second) 
-	{ 
-	  v->setId (uniqueId ());
-	  return v;
-	}
-      else
-	{
-	  freeNode (v);
-	  return *x.first;
-	}
+      v->computeHash ();
+      unique_shard &shard = shardOf (v);
+      ENode *res;
+      {
+        lock_type lk = lock (shard.mutex);
+        res = insertUnique (shard, v);
+        res->Ref ();
+        if (res == v) v->setId (uniqueId ());
+      }
+      
+      // -- freeing a node dereferences its children and must be done
+      // -- without holding the lock
+      if (res != v) freeNode (v);
+      return res;
     }
 
     ENode* mkExpr (const Operator &op)
@@ -476,6 +795,17 @@ namespace expr
       return canonize (eVal);
     }
 
+    /** allocates the arguments of n at once when the size of the
+        range is known in advance */
+    template <typename iterator>
+    static void reserveArgs (ENode *n, iterator begin, iterator end,
+                             std::forward_iterator_tag)
+    { n->reserve (std::distance (begin, end)); }
+    
+    template <typename iterator>
+    static void reserveArgs (ENode *n, iterator begin, iterator end,
+                             std::input_iterator_tag) {}
+    
     /* n-ary 
        iterator ranges over cost ENode*
     */
@@ -485,6 +815,8 @@ namespace expr
 		    iterator end)
     {
       ENode* eVal = allocNode (op);
+      reserveArgs (eVal, begin, end, 
+                   typename std::iterator_traits<iterator>::iterator_category ());
       for (; begin != end; ++begin)
 	eVal->push_back (eptr (*begin));
       return canonize (eVal);
@@ -493,36 +825,172 @@ namespace expr
   private:
 
 
+    /** nesting depth of reclamation batches */
+    unsigned m_batch;
+    /** nodes that died in the current batch, or during teardown. In
+        concurrent mode, protected by freeListMutex */
+    std::vector<ENode*> m_dead;
+    /** set when the factory is about to be destroyed */
+    std::atomic<bool> m_teardown;
+    
+    /** marks a node of a batch that is being reclaimed */
+#define ENODE_DEAD_MARK (~0U)
+    
 #define FREE_LIST_MAX_SIZE 1024*4
     std::vector<ENode*> freeList;
+    /** protects freeList in concurrent mode */
+    std::mutex freeListMutex;
     void freeNode (ENode *n);
+    void recycleNode (ENode *n);
+    void releaseStorage (ENode *n);
+    void sweep ();
     ENode *allocNode (const Operator &op);
+    
+    /** returns an operator equal to op to be stored in a node */
+    const Operator *internOp (const Operator &op)
+    {
+      const Operator *res = op.interned ();
+      return res ? res : op.clone (allocator);
+    }
+    
+    /** releases an operator returned by internOp */
+    void releaseOp (const Operator *op)
+    {
+      if (op->interned ()) return;
+      op->~Operator ();
+      allocator.free (const_cast<Operator*> (op));
+    }
 
     
 
 
   public:
-    ExprFactory () : idCount(0) {}
+    /** 
+     * \param concurrent if true, the factory can be used by several
+     * threads at the same time. Registered caches are not made
+     * thread-safe by the factory.
+     */
+    ExprFactory (bool concurrent = false) : 
+      caches (std::make_shared<caches_type> ()),
+      m_concurrent (concurrent), idCount(0), m_batch (0), m_teardown (false)
+    { allocator.setConcurrent (concurrent); }
+    
+    ~ExprFactory ();
+    
+    /**
+     * Starts a reclamation batch. Until the matching endBatch (),
+     * nodes that die are queued instead of being removed from the
+     * unique table and the caches one at a time. Batches nest; the
+     * outermost one reclaims all queued nodes at once. Ignored in
+     * concurrent mode.
+     */
+    void beginBatch () { if (!m_concurrent) ++m_batch; }
+    void endBatch ()
+    {
+      if (m_concurrent) return;
+      assert (m_batch > 0);
+      // -- nodes that die while the batch is reclaimed are queued
+      // -- and reclaimed by the same sweep
+      if (m_batch == 1) sweep ();
+      --m_batch;
+    }
+    
+    /**
+     * The factory is about to be destroyed. From now on nodes that
+     * die are only removed from the registered caches; they are not
+     * reclaimed individually and all memory is released together
+     * with the factory. Must only be called by the last owner of
+     * the factory (see ExprFactoryTeardown).
+     */
+    void prepareTeardown () { m_teardown.store (true); }
 
-    /** Derefernce a value */
-    void Deref (ENode* val)
+    bool isConcurrent () const { return m_concurrent; }
+    
+    /** 
+     * Drops a reference to val. Returns true if it was the last one.
+     * val is then removed from the unique table and from the caches,
+     * and must be freed by the caller.
+     */
+    bool release (ENode* val)
     {
-      val->Deref ();
-      if (val->isGarbage ()) Remove (val);
+      if (!m_concurrent)
+        {
+          val->Deref ();
+          if (!val->isGarbage ()) return false;
+          if (m_teardown)
+            {
+              // -- a mutable node is not in the unique table, it is
+              // -- freed by ~ExprFactory () from m_dead
+              if (val->isMutable ()) m_dead.push_back (val);
+              clearCaches (val);
+              return false;
+            }
+          if (m_batch > 0)
+            {
+              // -- reclaimed by sweep (). Until then the node stays in
+              // -- the unique table and canonize () may resurrect it
+              m_dead.push_back (val);
+              return false;
+            }
+          if (!val->isMutable ()) eraseUnique (shardOf (val), val);
+          clearCaches (val);
+          return true;
+        }
+      
+      // -- not the last reference, nothing else to do
+      if (val->DerefShared ()) return false;
+      
+      if (val->isMutable ())
+        {
+          val->Deref ();
+          if (!val->isGarbage ()) return false;
+          if (m_teardown) 
+            {
+              // -- not in the unique table, freed by ~ExprFactory ()
+              {
+                lock_type lk = lock (freeListMutex);
+                m_dead.push_back (val);
+              }
+              clearCaches (val);
+              return false;
+            }
+        }
+      else
+        {
+          // -- the last reference is dropped under the lock of the
+          // -- shard so that canonize() cannot resurrect the node
+          unique_shard &shard = shardOf (val);
+          lock_type lk = lock (shard.mutex);
+          val->Deref ();
+          if (!val->isGarbage ()) return false;
+          if (m_teardown)
+            {
+              lk.unlock ();
+              clearCaches (val);
+              return false;
+            }
+          eraseUnique (shard, val);
+        }
+      
+      clearCaches (val);
+      return true;
     }
+    
+    /** Derefernce a value */
+    void Deref (ENode* val) { if (release (val)) freeNode (val); }
 
     /** User functions */
-    Expr mkTerm (const Operator &o) { return Expr (mkExpr (o)); }
+    Expr mkTerm (const Operator &o) { return Expr (mkExpr (o), false); }
     Expr mkUnary (const Operator &o, Expr e) 
-    { return Expr (mkExpr (o, e.get ())); }
+    { return Expr (mkExpr (o, e.get ()), false); }
     Expr mkBin (const Operator &o, Expr e1, Expr e2)
-    { return Expr (mkExpr (o, e1.get (), e2.get ())); }
+    { return Expr (mkExpr (o, e1.get (), e2.get ()), false); }
     Expr mkTern (const Operator &o, Expr e1, Expr e2, 
 		 Expr e3)
-    { return Expr (mkExpr (o, e1.get (), e2.get (), e3.get ())); }
+    { return Expr (mkExpr (o, e1.get (), e2.get (), e3.get ()), false); }
     template <typename iterator>
     Expr mkNary (const Operator &o, iterator b, iterator e)
-    { return Expr (mkNExpr (o, b, e)); }
+    { return Expr (mkNExpr (o, b, e), false); }
     
     template <typename Range>
     Expr mkNary (const Operator &o, const Range &r)
@@ -534,7 +1002,13 @@ namespace expr
     {
       // -- to avoid double registration
       unregisterCache (cache);
-      caches.push_back (static_cast<CacheStub*> (new CacheStubTmpl<Cache> (cache)));
+      std::shared_ptr<CacheStub> stub = 
+        std::make_shared<CacheStubTmpl<Cache> > (cache);
+      
+      lock_type lk = lock (cachesMutex);
+      std::shared_ptr<caches_type> res = std::make_shared<caches_type> (*caches);
+      res->push_back (stub);
+      caches = res;
     }
     
     template <typename Cache>
@@ -542,24 +1016,91 @@ namespace expr
     {
       const void *ptr = static_cast<const void*> (&cache);
       
-      for (caches_type::iterator it = caches.begin (), end = caches.end ();
-	   it != end; ++it)
-	if (it->owns (ptr)) 
-	  {
-	    caches.erase (it);
-	    return true;
-	  }
-      return false;
+      std::shared_ptr<CacheStub> stub;
+      {
+        lock_type lk = lock (cachesMutex);
+        caches_type::const_iterator it = 
+          std::find_if (caches->begin (), caches->end (),
+                        [ptr] (const std::shared_ptr<CacheStub> &c)
+                        { return c->owns (ptr); });
+        if (it == caches->end ()) return false;
+        
+        stub = *it;
+        std::shared_ptr<caches_type> res = std::make_shared<caches_type> ();
+        res->reserve (caches->size () - 1);
+        for (const std::shared_ptr<CacheStub> &c : *caches)
+          if (c != stub) res->push_back (c);
+        caches = res;
+      }
+      
+      // -- wait for the threads that are still clearing the cache
+      // -- from an older snapshot of the list
+      if (m_concurrent)
+        while (stub.use_count () > 1) std::this_thread::yield ();
+      return true;
     }
     
     friend class ENode;
   };
 
+  /**
+   * Tears down the factory of its owner. To be declared right after
+   * the factory, so that it is destroyed after every other member of
+   * the owner, when the owner holds no more terms. The destructor of
+   * the owner calls begin (): the nodes that die while the members
+   * are destroyed are reclaimed in one batch, and the factory is put
+   * in teardown mode just before it is destroyed.
+   */
+  class ExprFactoryTeardown : boost::noncopyable
+  {
+    ExprFactory &m_efac;
+    bool m_begun;
+  public:
+    ExprFactoryTeardown (ExprFactory &efac) : m_efac (efac), m_begun (false) {}
+    void begin ()
+    {
+      if (m_begun) return;
+      m_efac.beginBatch ();
+      m_begun = true;
+    }
+    ~ExprFactoryTeardown ()
+    {
+      if (m_begun) m_efac.endBatch ();
+      m_efac.prepareTeardown ();
+    }
+  };
+
+  /** Reclaims the nodes that die during its lifetime in one batch */
+  class ScopedReclaimBatch : boost::noncopyable
+  {
+    ExprFactory &m_efac;
+  public:
+    ScopedReclaimBatch (ExprFactory &efac) : m_efac (efac) 
+    { m_efac.beginBatch (); }
+    ~ScopedReclaimBatch () { m_efac.endBatch (); }
+  };
+  
+  // -- reference counts are only updated atomically when the factory
+  // -- is shared between threads
+  inline void ENode::Ref ()
+  {
+    if (fac->isConcurrent ()) count.fetch_add (1, std::memory_order_relaxed);
+    else count.store (count.load (std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+  }
+  
+  inline void ENode::Deref ()
+  {
+    unsigned int c = count.load (std::memory_order_relaxed);
+    if (!fac->isConcurrent ()) 
+      { if (c > 0) count.store (c - 1, std::memory_order_relaxed); }
+    else
+      while (c > 0 && !count.compare_exchange_weak (c, c - 1)) ;
+  }
+  
   inline ENode::ENode (ExprFactory &f, const Operator &o) :
-    count(0), fac(&f), 
-    oper(o.clone (f.allocator), 
-	 f.allocator.get_deleter (),
-	 boost::pool_allocator<char> ()) {}
+    id(0), count(0), m_hash(0), fac(&f), oper (f.internOp (o)),
+    m_args (m_inline), m_arity (0), m_capacity (ENODE_INLINE_ARGS) {}
 }
 
 inline void * operator new (size_t n, expr::ExprFactoryAllocator &alloc)
@@ -572,40 +1113,148 @@ namespace expr
 {
   inline void ExprFactory::freeNode (ENode *n)
   {
-    if (freeList.size () < FREE_LIST_MAX_SIZE) 
-      {      
-	for (ENode *a : n->args) Deref (a);
-	n->args.clear ();
-	n->oper.reset ();
-
-	if (freeList.size () < FREE_LIST_MAX_SIZE) 
-	  { 
-	    assert (n->count == 0);
-	    freeList.push_back (n);
-	    return;
-	  }
+    // -- children that lose their last reference are freed from a
+    // -- work list rather than recursively, so that deep terms do
+    // -- not overflow the stack
+    std::vector<ENode*> garbage;
+    for (;;)
+      {
+        for (unsigned i = 0; i < n->m_arity; ++i) 
+          if (release (n->m_args [i])) garbage.push_back (n->m_args [i]);
+        recycleNode (n);
+        
+        if (garbage.empty ()) return;
+        n = garbage.back ();
+        garbage.pop_back ();
       }
+  }
+  
+  /** releases the argument array and the operator of n */
+  inline void ExprFactory::releaseStorage (ENode *n)
+  {
+    n->m_arity = 0;
+    n->releaseArgs ();
+    releaseOp (n->oper);
+    n->oper = NULL;
+  }
+  
+  /** returns a node whose children are released to the free list */
+  inline void ExprFactory::recycleNode (ENode *n)
+  {
+    releaseStorage (n);
+    assert (n->count == 0);
+    
+    {
+      lock_type lk = lock (freeListMutex);
+      if (freeList.size () < FREE_LIST_MAX_SIZE) 
+        { 
+          freeList.push_back (n);
+          return;
+        }
+    }
 
+    n->~ENode ();
     operator delete (static_cast<void*>(n), allocator);
   }
 
+  /** reclaims the nodes queued during a batch */
+  inline void ExprFactory::sweep ()
+  {
+    std::vector<ENode*> dead;
+    while (!m_dead.empty ())
+      {
+        dead.clear ();
+        dead.swap (m_dead);
+        
+        // -- skip nodes resurrected by canonize (). A node that died
+        // -- again after being resurrected is queued more than once,
+        // -- it is marked the first time it is seen
+        size_t sz = 0;
+        for (ENode *v : dead)
+          {
+            if (v->count.load (std::memory_order_relaxed) != 0) continue;
+            v->count.store (ENODE_DEAD_MARK, std::memory_order_relaxed);
+            if (!v->isMutable ()) eraseUnique (shardOf (v), v);
+            dead [sz++] = v;
+          }
+        dead.resize (sz);
+        
+        for (const std::shared_ptr<CacheStub> &c : *caches) c->eraseAll (dead);
+        
+        // -- children that die are queued for the next round
+        for (ENode *v : dead)
+          {
+            v->count.store (0, std::memory_order_relaxed);
+            freeNode (v);
+          }
+      }
+  }
+  
+  inline ExprFactory::~ExprFactory ()
+  {
+    // -- release the storage of the remaining nodes without
+    // -- dereferencing their children or updating the table. The
+    // -- nodes themselves live in the pools of the allocator, unless
+    // -- the allocator is concurrent
+    std::vector<ENode*> nodes;
+    forEachUnique ([&nodes] (ENode *n) { nodes.push_back (n); });
+    for (ENode *n : m_dead) 
+      if (n->isMutable () && n->isGarbage ()) nodes.push_back (n);
+    for (ENode *n : nodes) releaseStorage (n);
+    
+    if (!allocator.isConcurrent ()) return;
+    nodes.insert (nodes.end (), freeList.begin (), freeList.end ());
+    for (ENode *n : nodes)
+      {
+        n->~ENode ();
+        operator delete (static_cast<void*>(n), allocator);
+      }
+  }
+  
   inline ENode *ExprFactory::allocNode (const Operator &op)
   {
-    if (freeList.empty ())
+    ENode *res = NULL;
+    {
+      lock_type lk = lock (freeListMutex);
+      if (!freeList.empty ())
+        {
+          res = freeList.back ();
+          freeList.pop_back ();
+        }
+    }
+    
+    if (res == NULL)
       return new(allocator) ENode (*this, op);
       
-    ENode *res = freeList.back ();
-    freeList.pop_back ();
-    res->oper.reset (op.clone (allocator), 
-		     allocator.get_deleter (),
-		     boost::pool_allocator<char> ());
+    res->oper = internOp (op);
     assert (res->count == 0);
     return res;
   }
+  
+  inline void ENode::reserve (unsigned n)
+  {
+    if (n <= m_capacity) return;
+    
+    ENode **args = 
+      static_cast<ENode**> (fac->allocator.allocate (n * sizeof (ENode*)));
+    std::copy (m_args, m_args + m_arity, args);
+    releaseArgs ();
+    m_args = args;
+    m_capacity = n;
+  }
+  
+  inline void ENode::releaseArgs ()
+  {
+    if (m_args != m_inline) fac->allocator.free (m_args);
+    m_args = m_inline;
+    m_capacity = ENODE_INLINE_ARGS;
+  }
     
 
   inline void *ExprFactoryAllocator::allocate (size_t n)
   { 
+    if (m_concurrent) return ::operator new (n);
+    
     if (n <= tiny.get_requested_size ()) return tiny.malloc ();
     else if (n <= small.get_requested_size ()) return small.malloc ();
     
@@ -615,6 +1264,12 @@ namespace expr
 
   inline void ExprFactoryAllocator::free (void *block) 
   { 
+    if (m_concurrent) 
+      {
+        ::operator delete (block);
+        return;
+      }
+    
     if (tiny.is_from (block)) tiny.free (block);
     else if (small.is_from (block)) small.free (block);
     else delete [] static_cast<char * const> (block); 
@@ -685,6 +1340,8 @@ namespace expr
 
     size_t hash () const { return terminal_type::hash (val); }
     
+    unsigned typeTag () const 
+    { return details::OperatorTag<this_type>::get (); }
   };
 
   template<> struct TerminalTrait<std::string>
@@ -755,6 +1412,30 @@ namespace expr
   };
 
 
+  /** 64-bit integer numerals. Printed like mpz_class */
+  template <> struct TerminalTrait<int64_t>
+  {
+    static inline void print (std::ostream &OS, int64_t v, 
+			      int depth, bool brkt)
+    {
+      /* print large numbers in hex */
+      if (v >= 65535 || v <= -65535)
+        {
+          // -- hex output of negative numbers is two's complement
+          if (v < 0) OS << "-";
+          OS << std::hex << std::showbase 
+             << (v < 0 ? -(uint64_t)v : (uint64_t)v);
+          OS << std::dec << std::noshowbase;
+        }
+      else
+        OS << v;
+    }
+    
+    static inline bool less (int64_t v1, int64_t v2) { return v1 < v2; }
+    static inline bool equal_to (int64_t v1, int64_t v2) { return v1 == v2; }
+    static inline size_t hash (int64_t v) { return std::hash<int64_t> () (v); }
+  };
+  
   template <> struct TerminalTrait<mpz_class>
   {
     static inline void print (std::ostream &OS, const mpz_class &v, 
@@ -777,9 +1458,11 @@ namespace expr
     
     static inline size_t hash (const mpz_class &v)
     {
-      std::string str = boost::lexical_cast<std::string> (v);
-      std::hash<std::string> hasher;
-      return hasher (str);
+      mpz_srcptr z = v.get_mpz_t ();
+      size_t seed = mpz_sgn (z) + 1;
+      for (size_t i = 0, sz = mpz_size (z); i < sz; ++i)
+        boost::hash_combine (seed, mpz_getlimbn (z, i));
+      return seed;
     }
     
     
@@ -818,7 +1501,32 @@ namespace expr
     typedef Terminal<unsigned long> ULONG;
     
     typedef Terminal<mpq_class> MPQ;
+    /** 
+     * Integer numerals. A numeral that fits in 64 bits is always an
+     * INT64, larger ones are MPZ. isOpX<MPZ> and getTerm<mpz_class>
+     * accept both.
+     */
     typedef Terminal<mpz_class> MPZ;
+    typedef Terminal<int64_t> INT64;
+  }
+  
+  namespace details
+  {
+    /** implements isOpX */
+    template <typename O>
+    struct IsOpX
+    {
+      static bool is (const Operator &op) 
+      { return typeid (op) == typeid (O); }
+    };
+    
+    template <>
+    struct IsOpX<op::MPZ>
+    {
+      static bool is (const Operator &op) 
+      { return typeid (op) == typeid (op::MPZ) || 
+          typeid (op) == typeid (op::INT64); }
+    };
   }
 
   namespace ps
@@ -1002,16 +1710,36 @@ namespace expr
 
     size_t hash () const { return typeHash (this); }
     
+    unsigned typeTag () const 
+    {
+      // -- odr-use the registrar so that it is instantiated
+      (void)&s_registrar;
+      return details::OperatorTag<this_type>::get ();
+    }
+    
+    /** all instances are equal, nodes share a single one */
+    const Operator* interned () const 
+    { 
+      static const this_type instance;
+      return &instance;
+    }
+    
     this_type * clone (ExprFactoryAllocator &allocator) const 
     { return new (allocator) this_type (*this); }
-      
+
+  private:
+    static const details::OperatorRegistrar<this_type> s_registrar;
   };
 
+  template <typename T, typename B, typename P>
+  const details::OperatorRegistrar<DefOp<T,B,P> > DefOp<T,B,P>::s_registrar;
+
   inline ENode::~ENode () 
   {
-    for (args_iterator b = args.begin (), e = args.end ();
+    for (args_iterator b = args_begin (), e = args_end ();
 	 b != e; ++b)
       efac().Deref (*b);
+    releaseArgs ();
   }
 
 
@@ -1019,17 +1747,15 @@ namespace expr
   template <typename iterator>
   void ENode::renew_args (iterator b, iterator e)
   {
-    std::vector<ENode*> old = args;
-    args = std::vector<ENode*> ();
+    std::vector<ENode*> old (args_begin (), args_end ());
+    m_arity = 0;
     
     // -- increment reference count of all new arguments
     for (; b != e; ++b)
       this->push_back (eptr (*b));
     
     // -- decrement reference count of all old arguments
-    for (args_iterator b = old.begin (), e = old.end ();
-	 b != e; ++b)
-      efac().Deref (*b);
+    for (ENode *a : old) efac().Deref (a);
   }
 
 
@@ -1096,8 +1822,7 @@ namespace expr
 
     // skipKids or doKids
     VisitAction (bool kids = false) : 
-      _skipKids (kids), fn (new ExprFunctionoid<IdentityRewriter> 
-                            (std::make_shared<IdentityRewriter> ())) {}
+      _skipKids (kids), fn (identity ()) {}
     
     // changeTo or doKidsRewrite
     template <typename R>
@@ -1117,10 +1842,10 @@ namespace expr
     static inline VisitAction skipKids () { return VisitAction (true); }
     static inline VisitAction doKids () { return VisitAction (false); }
     static inline VisitAction changeTo (Expr e) 
-    { return VisitAction (e, true, std::make_shared<IdentityRewriter> ());}
+    { return VisitAction (e, true, identity ());}
     
     static inline VisitAction changeDoKids (Expr e) 
-    { return VisitAction (e, false, std::make_shared<IdentityRewriter> ());}
+    { return VisitAction (e, false, identity ());}
     
     template <typename R> 
     static inline VisitAction changeDoKidsRewrite (Expr e, std::shared_ptr<R> r) 
@@ -1131,69 +1856,186 @@ namespace expr
     Expr expr;
   private:
     std::shared_ptr<ExprFn> fn;
+
+    VisitAction (Expr e, bool kids, std::shared_ptr<ExprFn> f) :
+      _skipKids (kids), expr (e), fn (f) {}
+    
+    /** the identity rewriter, shared by all actions that do not
+        rewrite */
+    static std::shared_ptr<ExprFn> identity ()
+    {
+      static std::shared_ptr<ExprFn> fn 
+        (new ExprFunctionoid<IdentityRewriter> 
+         (std::make_shared<IdentityRewriter> ()));
+      return fn;
+    }
   };
 
 
   typedef std::unordered_map<ENode*,Expr> DagVisitCache;
 
-  template <typename ExprVisitor> 
-  Expr visit (ExprVisitor &v, Expr expr, DagVisitCache &cache)
+  namespace details
   {
-    if (!expr) return expr;
+    /** A node whose children are being visited */
+    struct VisitFrame
+    {
+      /** the visited node */
+      Expr expr;
+      /** the node whose children are visited. Differs from expr
+          when the visitor asked for changeDoKids */
+      Expr res;
+      VisitAction va;
+      /** index of the next child of res to visit */
+      unsigned next;
+      /** position of the result of the first child of res in the
+          result stack */
+      size_t base;
+      
+      VisitFrame (Expr e, Expr r, VisitAction a, size_t b) :
+        expr (e), res (r), va (a), next (0), base (b) {}
+    };
+
+    /** 
+     * Work stacks of the visitor. Kept between visits so that
+     * repeated visits do not allocate. 
+     */
+    struct VisitScratch
+    {
+      std::vector<VisitFrame> frames;
+      std::vector<Expr> results;
+    };
     
-    if (expr->use_count () > 1)
+    /** Does not memoize: visits the expression as a tree */
+    struct NoVisitCache
+    {
+      bool lookup (const Expr &e, Expr &res) { return false; }
+      void store (const Expr &e, const Expr &res) {}
+    };
+    
+    /** Memoizes the results of shared nodes in a DagVisitCache */
+    struct DagVisitCacheRef
+    {
+      DagVisitCache &m_cache;
+      DagVisitCacheRef (DagVisitCache &c) : m_cache (c) {}
+      
+      bool lookup (const Expr &e, Expr &res)
       {
-	DagVisitCache::const_iterator cit 
-	  = cache.find (&*expr);
-	if (cit != cache.end ()) return cit->second;
+        if (e->use_count () <= 1) return false;
+        DagVisitCache::const_iterator cit = m_cache.find (&*e);
+        if (cit == m_cache.end ()) return false;
+        res = cit->second;
+        return true;
       }
+      
+      void store (const Expr &e, const Expr &res)
+      {
+        if (e->use_count () <= 1) return;
+        e->Ref ();
+        m_cache [&*e] = res;
+      }
+    };
     
-    
-    VisitAction va = v(expr);
-    Expr res;
+    /**
+     * Post-order traversal of expr with an explicit stack. Results
+     * are memoized by Cache (see NoVisitCache for the interface).
+     * Re-entrant: the visitor may start another visit with the same
+     * scratch space.
+     */
+    template <typename ExprVisitor, typename Cache>
+    class VisitEngine
+    {
+      ExprVisitor &m_v;
+      Cache m_cache;
+      VisitScratch &m_s;
 
-    if (va.isSkipKids ())
-      res = expr;
-    else if (va.isChangeTo ())
-      res = va.getExpr ();
-    else
+      /** records res as the result of visiting e */
+      void done (const Expr &e, Expr res)
       {
-	res = va.isChangeDoKidsRewrite () ? va.getExpr () : expr;
-	if (res->arity () > 0) 
-	  {
-	    bool changed = false;
-            std::vector<Expr> kids;
+        m_cache.store (e, res);
+        m_s.results.push_back (res);
+      }
 
-	    for (ENode::args_iterator b = res->args_begin (), 
-		   e = res->args_end (); 
-		 b != e; ++b)
-	      {
-		Expr k = visit (v, *b, cache);
-		kids.push_back (k);
-		changed  = (changed || k.get () != *b);
-	      }
-	    
-	    if (changed)
-	      {
-		if (!res->isMutable ())
-		  res = res->getFactory ().mkNary (res->op (),
-						   kids.begin (),
-						   kids.end ());
-		else
-		  res->renew_args (kids.begin (), kids.end ());
-	      }
-	  }
-    
-	res = va.rewrite (res);
+      /** starts visiting e. Either pushes its result or a frame */
+      void enter (Expr e)
+      {
+        if (!e) 
+          {
+            m_s.results.push_back (e);
+            return;
+          }
+        
+        Expr cached;
+        if (m_cache.lookup (e, cached))
+          {
+            m_s.results.push_back (cached);
+            return;
+          }
+        
+        VisitAction va = m_v (e);
+        if (va.isSkipKids ()) done (e, e);
+        else if (va.isChangeTo ()) done (e, va.getExpr ());
+        else
+          {
+            Expr res = va.isChangeDoKidsRewrite () ? va.getExpr () : e;
+            if (res->arity () == 0) done (e, va.rewrite (res));
+            else 
+              m_s.frames.push_back (VisitFrame (e, res, va, 
+                                                m_s.results.size ()));
+          }
       }
 
-    if (expr->use_count () > 1)
+      /** finishes the top frame once all its children are visited */
+      void leave ()
       {
-	expr->Ref ();
-	cache[&*expr] = res;
+        VisitFrame f (std::move (m_s.frames.back ()));
+        m_s.frames.pop_back ();
+        
+        std::vector<Expr>::iterator kids = m_s.results.begin () + f.base;
+        bool changed = false;
+        for (unsigned i = 0, sz = f.res->arity (); i < sz; ++i)
+          changed = changed || kids [i].get () != f.res->arg (i);
+        
+        if (changed)
+          {
+            if (!f.res->isMutable ())
+              f.res = f.res->getFactory ().mkNary (f.res->op (),
+                                                   kids, m_s.results.end ());
+            else
+              f.res->renew_args (kids, m_s.results.end ());
+          }
+        m_s.results.resize (f.base);
+        
+        done (f.expr, f.va.rewrite (f.res));
       }
-    
-    return res;
+      
+    public:
+      VisitEngine (ExprVisitor &v, Cache cache, VisitScratch &s) :
+        m_v (v), m_cache (cache), m_s (s) {}
+      
+      Expr operator() (Expr expr)
+      {
+        size_t depth = m_s.frames.size ();
+        enter (expr);
+        while (m_s.frames.size () > depth)
+          {
+            VisitFrame &f = m_s.frames.back ();
+            if (f.next < f.res->arity ()) enter (f.res->arg (f.next++));
+            else leave ();
+          }
+        
+        Expr res = m_s.results.back ();
+        m_s.results.pop_back ();
+        return res;
+      }
+    };
+  }
+  
+  template <typename ExprVisitor> 
+  Expr visit (ExprVisitor &v, Expr expr, DagVisitCache &cache)
+  {
+    details::VisitScratch s;
+    return details::VisitEngine<ExprVisitor, details::DagVisitCacheRef> 
+      (v, cache, s) (expr);
   }  
 
   inline void clearDagVisitCache (DagVisitCache &cache)
@@ -1209,12 +2051,17 @@ namespace expr
   {
     ExprVisitor &m_v;
     DagVisitCache m_cache;
+    details::VisitScratch m_scratch;
     
     DagVisit (ExprVisitor &v) : m_v (v) {}
     DagVisit (const DagVisit &o) : m_v (o.m_v) {} 
     ~DagVisit () { clearDagVisitCache (m_cache); }
     
-    Expr operator() (Expr e)  { return visit (m_v, e, m_cache); }
+    Expr operator() (Expr e)  
+    { 
+      return details::VisitEngine<ExprVisitor, details::DagVisitCacheRef> 
+        (m_v, m_cache, m_scratch) (e); 
+    }
     
   };
   
@@ -1232,44 +2079,13 @@ namespace expr
     for (auto &e : vec) e = dv (e);
   }
 
+  /** visits expr as a tree: shared sub-terms are visited every time */
   template <typename ExprVisitor>
   Expr visit (ExprVisitor &v, Expr expr)
   {
-    VisitAction va = v (expr);
-    
-    if (va.isSkipKids ()) return expr;
-
-    if (va.isChangeTo ()) return va.getExpr ();
-    
-    Expr res = va.isChangeDoKidsRewrite () ? va.getExpr () : expr;
-    
-    if (res->arity () == 0) return va.rewrite (res);
-
-    bool changed = false;
-    std::vector<Expr> kids;
-
-    for (ENode::args_iterator b = res->args_begin (), 
-	   e = res->args_end (); 
-	 b != e; ++b)
-      {
-	Expr k = visit (v, *b);
-	kids.push_back (k);
-	changed  = (changed || k.get () != *b);
-      }
-
-    if (changed)
-      {
-	if (!res->isMutable ())
-	  res = res->getFactory ().mkNary (res->op (),
-					   kids.begin (),
-					   kids.end ());
-	else
-	  res->renew_args (kids.begin (), kids.end ());
-      }
-    
-    res = va.rewrite (res);
-
-    return res;
+    details::VisitScratch s;
+    return details::VisitEngine<ExprVisitor, details::NoVisitCache> 
+      (v, details::NoVisitCache (), s) (expr);
   }
 
   /**********************************************************************/
@@ -1294,7 +2110,7 @@ namespace expr
   // -- usage isOpX<TYPE>(EXPR) . Returns true if top operator of
   // -- expression is of type TYPE.    
   template <typename O, typename T> bool isOpX (T e)
-  { return typeid (eptr (e)->op ()) == typeid (O); }
+  { return details::IsOpX<O>::is (eptr (e)->op ()); }
 
   /**********************************************************************/
   /* Creation */
@@ -1322,6 +2138,23 @@ namespace expr
     return dynamic_cast<const term_type&>(e->op ()).get ();
   }
   
+  /** Integer numerals that fit in 64 bits are created as INT64 */
+  template <> inline Expr mkTerm<mpz_class> (mpz_class v, ExprFactory &f)
+  {
+    if (v.fits_slong_p () && sizeof (long) == sizeof (int64_t))
+      return mkTerm<int64_t> (v.get_si (), f);
+    op::MPZ op (v);
+    return f.mkTerm (op);
+  }
+  
+  /** The value of an integer numeral, either INT64 or MPZ */
+  template <> inline mpz_class getTerm<mpz_class> (Expr e)
+  {
+    if (const op::INT64 *small = dynamic_cast<const op::INT64*> (&e->op ()))
+      return mpz_class ((long) small->get ());
+    return dynamic_cast<const op::MPZ&> (e->op ()).get ();
+  }
+  
 
   /* Creates a unary expression with a given operator. 
    * Usage: mk<NEG> (exp)
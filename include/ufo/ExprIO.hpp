@@ -1,6 +1,515 @@
 #ifndef __EXPR_IO_HPP_
 #define __EXPR_IO_HPP_
 
+/**
+ * Binary serialization of Expr DAGs.
+ *
+ * A file holds a set of root terms and the DAG below them. Every node
+ * is written once, after its arguments, so that a file is written in
+ * a single traversal and read in a single pass without a symbol
+ * table. The layout is a fixed header followed by five arrays:
+ *
+ *   ops    -- one entry per operator: the name of its type and, for
+ *             terminals, the encoded value. Both live in the pool
+ *   nodes  -- operator index, arity and index of the first argument
+ *   args   -- node indices of the arguments of all nodes
+ *   roots  -- node indices of the roots
+ *   pool   -- bytes of names and terminal values
+ *
+ * All fields are 32-bit (the pool size is 64-bit) in host byte order.
+ * The arrays are read in place from a memory-mapped file.
+ *
+ * Operators that carry no data (DefOp) are recovered by the name of
+ * their type, which is stable for a given build. Terminals are
+ * encoded by a TerminalCodec registered for their type. Codecs for
+ * strings, machine integers, numerals, bit-vector sorts and bound
+ * variables are built in. Mutable operators and terminals without a
+ * codec, e.g., pointers to LLVM values, cannot be written.
+ */
+
 #include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ufo/Expr.hpp"
+
+namespace expr
+{
+  namespace io
+  {
+    namespace details
+    {
+      struct Header
+      {
+        char magic [8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t numOps;
+        uint32_t numNodes;
+        uint32_t numArgs;
+        uint32_t numRoots;
+        uint64_t poolSize;
+      };
+
+      struct OpEntry
+      {
+        uint32_t nameOff;
+        uint32_t nameLen;
+        uint32_t dataOff;
+        uint32_t dataLen;
+      };
+
+      struct NodeEntry
+      {
+        uint32_t op;
+        uint32_t arity;
+        uint32_t firstArg;
+      };
+
+      static const char MAGIC [8] = {'E', 'X', 'P', 'R', 'D', 'A', 'G', 0};
+      static const uint32_t VERSION = 1;
+      static const uint32_t ENDIAN_MARK = 0x01020304;
+
+      template <typename... Ops>
+      void addOps ()
+      {
+        int dummy [] = {0, (expr::details::OperatorRegistry::add
+                            (Ops ().interned ()), 0)...};
+        (void)dummy;
+      }
+
+      /** registers the operators of Expr.hpp. Operators that a
+          program uses are registered anyway, but a program that only
+          reads a file might not use all of them */
+      inline void registerStandardOps ()
+      {
+        static const bool done =
+          (addOps<TRUE, FALSE, AND, OR, XOR, NEG, IMPL, ITE, IFF,
+                  OUT_G, AND_G, OR_G, NEG_G,
+                  PLUS, MINUS, MULT, DIV, IDIV, MOD, REM, UN_MINUS, ABS,
+                  PINFTY, NINFTY, ITV,
+                  EQ, NEQ, LEQ, GEQ, LT, GT,
+                  NONDET, ASM, TUPLE, VARIANT, TAG,
+                  INT_TY, CHAR_TY, REAL_TY, VOID_TY, BOOL_TY, UNINT_TY, ARRAY_TY,
+                  SELECT, STORE, CONST_ARRAY, ARRAY_MAP, ARRAY_DEFAULT, AS_ARRAY,
+                  BIND, FDECL, FAPP, FORALL, EXISTS, LAMBDA> (),
+           addOps<BNOT, BREDAND, BREDOR, BAND, BOR, BXOR, BNAND, BNOR, BXNOR,
+                  BNEG, BADD, BSUB, BMUL, BUDIV, BSDIV, BUREM, BSREM, BSMOD,
+                  BULT, BSLT, BULE, BSLE, BUGE, BSGE, BUGT, BSGT,
+                  BCONCAT, BEXTRACT, BSEXT, BZEXT, BREPEAT,
+                  BSHL, BLSHR, BASHR, BROTATE_LEFT, BROTATE_RIGHT,
+                  BEXT_ROTATE_LEFT, BEXT_ROTATE_RIGHT, INT2BV, BV2INT> (),
+           true);
+        (void)done;
+      }
+    }
+
+    /** Encodes and decodes the values of one type of terminal */
+    struct TerminalCodec
+    {
+      /** appends the encoding of the value of op to out */
+      std::function<void (const Operator &op, std::string &out)> encode;
+      /** returns the terminal encoded by [data, data + len) */
+      std::function<Expr (const char *data, size_t len, ExprFactory &efac)> decode;
+    };
+
+    /** Terminal codecs by the name of the type of the terminal */
+    class TerminalCodecs
+    {
+      typedef std::map<std::string, TerminalCodec> table_type;
+      table_type m_codecs;
+      std::mutex m_lock;
+
+      template <typename T>
+      static void addPod (TerminalCodecs &c)
+      {
+        c.add<T> ([] (const T &v, std::string &out)
+                  { out.append (reinterpret_cast<const char*> (&v), sizeof (T)); },
+                  [] (const char *data, size_t len, T &v)
+                  {
+                    if (len != sizeof (T)) return false;
+                    std::memcpy (&v, data, sizeof (T));
+                    return true;
+                  });
+      }
+
+      TerminalCodecs ()
+      {
+        add<std::string> ([] (const std::string &v, std::string &out)
+                          { out.append (v); },
+                          [] (const char *data, size_t len, std::string &v)
+                          { v.assign (data, len); return true; });
+        addPod<int> (*this);
+        addPod<unsigned int> (*this);
+        addPod<unsigned long> (*this);
+        addPod<int64_t> (*this);
+
+        // -- sign byte followed by the magnitude, most significant first
+        add<mpz_class> ([] (const mpz_class &v, std::string &out)
+                        {
+                          out.push_back (v < 0 ? '-' : '+');
+                          size_t cnt = (mpz_sizeinbase (v.get_mpz_t (), 2) + 7) / 8;
+                          size_t pos = out.size ();
+                          out.resize (pos + cnt);
+                          mpz_export (&out [pos], &cnt, 1, 1, 1, 0, v.get_mpz_t ());
+                          out.resize (pos + cnt);
+                        },
+                        [] (const char *data, size_t len, mpz_class &v)
+                        {
+                          if (len == 0) return false;
+                          mpz_import (v.get_mpz_t (), len - 1, 1, 1, 1, 0, data + 1);
+                          if (data [0] == '-') v = -v;
+                          return true;
+                        });
+        add<mpq_class> ([] (const mpq_class &v, std::string &out)
+                        { out.append (v.get_str (16)); },
+                        [] (const char *data, size_t len, mpq_class &v)
+                        {
+                          return v.set_str (std::string (data, len), 16) == 0;
+                        });
+        add<const op::bv::BvSort> ([] (const op::bv::BvSort &v, std::string &out)
+                                   {
+                                     uint32_t w = v.m_width;
+                                     out.append (reinterpret_cast<const char*> (&w),
+                                                 sizeof (w));
+                                   });
+        add<op::bind::BoundVar> ([] (const op::bind::BoundVar &v, std::string &out)
+                                 {
+                                   uint32_t var = v.var;
+                                   out.append (reinterpret_cast<const char*> (&var),
+                                               sizeof (var));
+                                 });
+      }
+
+      /** registers a codec for BvSort and BoundVar, which are not
+          default constructible */
+      template <typename T>
+      void add (std::function<void (const T&, std::string&)> enc)
+      {
+        TerminalCodec c;
+        c.encode = [enc] (const Operator &op, std::string &out)
+          { enc (static_cast<const Terminal<T>&> (op).get (), out); };
+        c.decode = [] (const char *data, size_t len, ExprFactory &efac)
+          {
+            uint32_t v;
+            if (len != sizeof (v)) return Expr ();
+            std::memcpy (&v, data, sizeof (v));
+            return mkTerm<T> (T (v), efac);
+          };
+        add (typeid (Terminal<T>).name (), c);
+      }
+
+    public:
+      static TerminalCodecs &get ()
+      {
+        static TerminalCodecs codecs;
+        return codecs;
+      }
+
+      void add (const std::string &name, const TerminalCodec &c)
+      {
+        std::lock_guard<std::mutex> guard (m_lock);
+        m_codecs [name] = c;
+      }
+
+      /** registers a codec for Terminal<T> from a function that
+          encodes a value and one that decodes it */
+      template <typename T>
+      void add (std::function<void (const T&, std::string&)> enc,
+                std::function<bool (const char*, size_t, T&)> dec)
+      {
+        TerminalCodec c;
+        c.encode = [enc] (const Operator &op, std::string &out)
+          { enc (static_cast<const Terminal<T>&> (op).get (), out); };
+        c.decode = [dec] (const char *data, size_t len, ExprFactory &efac)
+          {
+            T v;
+            if (!dec (data, len, v)) return Expr ();
+            return mkTerm<T> (v, efac);
+          };
+        add (typeid (Terminal<T>).name (), c);
+      }
+
+      /** removes the codec of terminals called name */
+      void remove (const std::string &name)
+      {
+        std::lock_guard<std::mutex> guard (m_lock);
+        m_codecs.erase (name);
+      }
+
+      /** returns the codec of terminals called name, or NULL */
+      const TerminalCodec *find (const std::string &name)
+      {
+        std::lock_guard<std::mutex> guard (m_lock);
+        auto it = m_codecs.find (name);
+        return it == m_codecs.end () ? NULL : &it->second;
+      }
+    };
+
+    /**
+     * Writes the DAG of roots to out. Returns false, and sets why if
+     * it is not NULL, if the DAG contains an operator that cannot be
+     * serialized.
+     */
+    inline bool write (std::ostream &out, const ExprVector &roots,
+                       std::string *why = NULL)
+    {
+      using namespace details;
+      registerStandardOps ();
+
+      std::vector<OpEntry> ops;
+      std::vector<NodeEntry> nodes;
+      std::vector<uint32_t> args;
+      std::vector<uint32_t> rootIdx;
+      std::string pool;
+
+      std::unordered_map<const ENode*, uint32_t> index;
+      std::unordered_map<unsigned, uint32_t> defOps;
+      std::unordered_map<std::string, uint32_t> names;
+
+      auto fail = [&] (const std::string &msg)
+        {
+          if (why) *why = msg;
+          return false;
+        };
+
+      auto addName = [&] (const char *name, OpEntry &entry)
+        {
+          auto it = names.insert (std::make_pair (std::string (name),
+                                                  (uint32_t) pool.size ()));
+          if (it.second) pool.append (name);
+          entry.nameOff = it.first->second;
+          entry.nameLen = std::strlen (name);
+        };
+
+      auto addOp = [&] (const Operator &op, uint32_t &res)
+        {
+          if (op.isMutable ()) return fail ("mutable operator");
+
+          const char *name = typeid (op).name ();
+          if (op.interned ())
+          {
+            auto it = defOps.find (op.typeTag ());
+            if (it != defOps.end ()) { res = it->second; return true; }
+            OpEntry entry = {0, 0, 0, 0};
+            addName (name, entry);
+            res = ops.size ();
+            ops.push_back (entry);
+            defOps [op.typeTag ()] = res;
+            return true;
+          }
+
+          const TerminalCodec *codec = TerminalCodecs::get ().find (name);
+          if (!codec) return fail (std::string ("no codec for operator ") + name);
+
+          OpEntry entry = {0, 0, 0, 0};
+          addName (name, entry);
+          entry.dataOff = pool.size ();
+          codec->encode (op, pool);
+          entry.dataLen = pool.size () - entry.dataOff;
+          res = ops.size ();
+          ops.push_back (entry);
+          return true;
+        };
+
+      // -- iterative post-order traversal. A node is emitted once all
+      // -- of its arguments are
+      std::vector<std::pair<const ENode*, bool> > stack;
+      for (const Expr &r : roots)
+      {
+        stack.push_back (std::make_pair (r.get (), false));
+        while (!stack.empty ())
+        {
+          const ENode *n = stack.back ().first;
+          bool expanded = stack.back ().second;
+          if (index.count (n)) { stack.pop_back (); continue; }
+
+          if (!expanded)
+          {
+            stack.back ().second = true;
+            for (auto it = n->args_begin (), end = n->args_end (); it != end; ++it)
+              if (!index.count (*it)) stack.push_back (std::make_pair (*it, false));
+            continue;
+          }
+          stack.pop_back ();
+
+          NodeEntry entry;
+          if (!addOp (n->op (), entry.op)) return false;
+          entry.arity = n->arity ();
+          entry.firstArg = args.size ();
+          for (auto it = n->args_begin (), end = n->args_end (); it != end; ++it)
+            args.push_back (index [*it]);
+          index [n] = nodes.size ();
+          nodes.push_back (entry);
+        }
+        rootIdx.push_back (index [r.get ()]);
+      }
+
+      if (pool.size () > UINT32_MAX || args.size () > UINT32_MAX)
+        return fail ("DAG too large");
+
+      Header h;
+      std::memcpy (h.magic, MAGIC, sizeof (MAGIC));
+      h.version = VERSION;
+      h.byteOrder = ENDIAN_MARK;
+      h.numOps = ops.size ();
+      h.numNodes = nodes.size ();
+      h.numArgs = args.size ();
+      h.numRoots = rootIdx.size ();
+      h.poolSize = pool.size ();
+
+      out.write (reinterpret_cast<const char*> (&h), sizeof (h));
+      out.write (reinterpret_cast<const char*> (ops.data ()),
+                 ops.size () * sizeof (OpEntry));
+      out.write (reinterpret_cast<const char*> (nodes.data ()),
+                 nodes.size () * sizeof (NodeEntry));
+      out.write (reinterpret_cast<const char*> (args.data ()),
+                 args.size () * sizeof (uint32_t));
+      out.write (reinterpret_cast<const char*> (rootIdx.data ()),
+                 rootIdx.size () * sizeof (uint32_t));
+      out.write (pool.data (), pool.size ());
+      return out.good () ? true : fail ("write error");
+    }
+
+    /**
+     * Re-creates in efac the DAG stored in [data, data + size) and
+     * appends its roots to roots. Returns false, and sets why if it
+     * is not NULL, if the data is not a valid DAG or refers to an
+     * operator that is unknown to this program.
+     */
+    inline bool read (const char *data, size_t size, ExprFactory &efac,
+                      ExprVector &roots, std::string *why = NULL)
+    {
+      using namespace details;
+      registerStandardOps ();
+
+      auto fail = [&] (const std::string &msg)
+        {
+          if (why) *why = msg;
+          return false;
+        };
+
+      if (size < sizeof (Header)) return fail ("truncated header");
+      const Header &h = *reinterpret_cast<const Header*> (data);
+      if (std::memcmp (h.magic, MAGIC, sizeof (MAGIC)) != 0)
+        return fail ("not an Expr DAG");
+      if (h.version != VERSION) return fail ("unsupported version");
+      if (h.byteOrder != ENDIAN_MARK) return fail ("wrong byte order");
+
+      uint64_t expected = sizeof (Header) +
+        (uint64_t) h.numOps * sizeof (OpEntry) +
+        (uint64_t) h.numNodes * sizeof (NodeEntry) +
+        ((uint64_t) h.numArgs + h.numRoots) * sizeof (uint32_t) +
+        h.poolSize;
+      if (expected != size) return fail ("size mismatch");
+
+      const OpEntry *ops = reinterpret_cast<const OpEntry*> (&h + 1);
+      const NodeEntry *nodes = reinterpret_cast<const NodeEntry*> (ops + h.numOps);
+      const uint32_t *args = reinterpret_cast<const uint32_t*> (nodes + h.numNodes);
+      const uint32_t *rootIdx = args + h.numArgs;
+      const char *pool = reinterpret_cast<const char*> (rootIdx + h.numRoots);
+
+      auto inPool = [&] (uint32_t off, uint32_t len)
+        { return (uint64_t) off + len <= h.poolSize; };
+
+      // -- operators. A terminal is decoded into its node directly
+      std::vector<const Operator*> opPtrs (h.numOps, NULL);
+      std::vector<Expr> terms (h.numOps);
+      for (uint32_t i = 0; i < h.numOps; ++i)
+      {
+        const OpEntry &o = ops [i];
+        if (!inPool (o.nameOff, o.nameLen) || !inPool (o.dataOff, o.dataLen))
+          return fail ("bad operator entry");
+        std::string name (pool + o.nameOff, o.nameLen);
+
+        opPtrs [i] = expr::details::OperatorRegistry::find (name);
+        if (opPtrs [i]) continue;
+
+        const TerminalCodec *codec = TerminalCodecs::get ().find (name);
+        if (!codec) return fail ("unknown operator " + name);
+        terms [i] = codec->decode (pool + o.dataOff, o.dataLen, efac);
+        if (!terms [i]) return fail ("bad value for " + name);
+      }
+
+      std::vector<Expr> res (h.numNodes);
+      ExprVector kids;
+      for (uint32_t i = 0; i < h.numNodes; ++i)
+      {
+        const NodeEntry &n = nodes [i];
+        if (n.op >= h.numOps || (uint64_t) n.firstArg + n.arity > h.numArgs)
+          return fail ("bad node entry");
+
+        if (terms [n.op])
+        {
+          if (n.arity != 0) return fail ("terminal with arguments");
+          res [i] = terms [n.op];
+          continue;
+        }
+
+        kids.clear ();
+        for (uint32_t j = 0; j < n.arity; ++j)
+        {
+          uint32_t a = args [n.firstArg + j];
+          // -- arguments precede their parents
+          if (a >= i) return fail ("bad argument index");
+          kids.push_back (res [a]);
+        }
+        res [i] = efac.mkNary (*opPtrs [n.op], kids.begin (), kids.end ());
+      }
+
+      for (uint32_t i = 0; i < h.numRoots; ++i)
+      {
+        if (rootIdx [i] >= h.numNodes) return fail ("bad root index");
+        roots.push_back (res [rootIdx [i]]);
+      }
+      return true;
+    }
+
+    /** writes the DAG of roots to the file path */
+    inline bool writeFile (const std::string &path, const ExprVector &roots,
+                           std::string *why = NULL)
+    {
+      std::ofstream out (path.c_str (), std::ios::binary | std::ios::trunc);
+      if (!out)
+      {
+        if (why) *why = "cannot open " + path;
+        return false;
+      }
+      return write (out, roots, why);
+    }
+
+    /** maps the file path and re-creates its DAG in efac */
+    inline bool readFile (const std::string &path, ExprFactory &efac,
+                          ExprVector &roots, std::string *why = NULL)
+    {
+      int fd = ::open (path.c_str (), O_RDONLY);
+      struct stat st;
+      if (fd < 0 || ::fstat (fd, &st) != 0 || st.st_size == 0)
+      {
+        if (fd >= 0) ::close (fd);
+        if (why) *why = "cannot open " + path;
+        return false;
+      }
+
+      void *data = ::mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close (fd);
+      if (data == MAP_FAILED)
+      {
+        if (why) *why = "cannot map " + path;
+        return false;
+      }
+
+      bool res = read (static_cast<const char*> (data), st.st_size, efac,
+                       roots, why);
+      ::munmap (data, st.st_size);
+      return res;
+    }
+  }
+}
 
 #endif
@@ -0,0 +1,218 @@
+/**
+Memoization of rewriters across visits.
+*/
+#ifndef _EXPR_MEMO__HH_
+#define _EXPR_MEMO__HH_
+
+#include "ufo/Expr.hpp"
+#include "ufo/Stats.hh"
+
+namespace expr
+{
+  /**
+   * A memo of the results of rewriters that is shared between
+   * visits.
+   *
+   * A rewriter is identified by a name and a key term. The caller
+   * guarantees that all visitors used with the same name and key
+   * rewrite a term in the same way. For example, a substitution of
+   * bound variables by the arguments of a predicate application is
+   * determined by the application. The result of every visited
+   * sub-term is remembered by the id of the sub-term, so that
+   * rewriting another term that shares sub-terms with a previous one
+   * only traverses the new parts.
+   *
+   * The memo is registered with the factory and forgets a term when
+   * the term dies. It is bounded: once the current generation of
+   * entries is full, the previous generation is dropped. Hits and
+   * misses are reported to ufo::Stats as memo.<name>.hit and
+   * memo.<name>.miss.
+   */
+  class RewriteMemo : boost::noncopyable
+  {
+    /** the result of a rewriter on a node */
+    struct Entry
+    {
+      unsigned rw;
+      Expr res;
+      Entry (unsigned r, Expr e) : rw (r), res (e) {}
+    };
+
+    /** node id to the results of all rewriters on it */
+    typedef std::unordered_multimap<unsigned, Entry> table_type;
+
+    /** counters of a named rewriter */
+    struct Named
+    {
+      std::string hitName;
+      std::string missName;
+      unsigned hits;
+      unsigned misses;
+      Named (const std::string &name) :
+        hitName ("memo." + name + ".hit"),
+        missName ("memo." + name + ".miss"),
+        hits (0), misses (0) {}
+    };
+
+    /** memoizes the visit of a single rewriter */
+    struct Cache
+    {
+      RewriteMemo &m_memo;
+      unsigned m_rw;
+      /** index of the name of the rewriter in m_named */
+      unsigned m_name;
+
+      Cache (RewriteMemo &memo, unsigned rw, unsigned name) :
+        m_memo (memo), m_rw (rw), m_name (name) {}
+
+      bool lookup (const Expr &e, Expr &res)
+      {
+        if (e->isMutable ()) return false;
+        Named &named = m_memo.m_named [m_name];
+        if (m_memo.find (m_rw, e->getId (), res))
+          {
+            ++named.hits;
+            return true;
+          }
+        ++named.misses;
+        return false;
+      }
+
+      void store (const Expr &e, const Expr &res)
+      { if (!e->isMutable ()) m_memo.insert (m_rw, e->getId (), res); }
+    };
+
+    ExprFactory &m_efac;
+    /** maximal number of entries */
+    size_t m_capacity;
+
+    /** entries of the current and of the previous generation */
+    table_type m_young;
+    table_type m_old;
+
+    std::vector<Named> m_named;
+    std::map<std::string, unsigned> m_nameIds;
+    /** (name, key id) to rewriter id */
+    std::map<std::pair<unsigned, unsigned>, unsigned> m_rws;
+
+    details::VisitScratch m_scratch;
+
+    static bool findIn (table_type &t, unsigned rw, unsigned id, Expr &res)
+    {
+      auto range = t.equal_range (id);
+      for (auto it = range.first; it != range.second; ++it)
+        if (it->second.rw == rw)
+          {
+            res = it->second.res;
+            return true;
+          }
+      return false;
+    }
+
+    bool find (unsigned rw, unsigned id, Expr &res)
+    {
+      if (findIn (m_young, rw, id, res)) return true;
+      if (!findIn (m_old, rw, id, res)) return false;
+      // -- keep entries that are still in use
+      insert (rw, id, res);
+      return true;
+    }
+
+    void insert (unsigned rw, unsigned id, const Expr &res)
+    {
+      if (m_young.size () >= m_capacity / 2)
+        {
+          // -- results are released after the tables are consistent
+          // -- since releasing them can call erase ()
+          table_type dead;
+          dead.swap (m_old);
+          m_old.swap (m_young);
+        }
+      m_young.insert (std::make_pair (id, Entry (rw, res)));
+    }
+
+    static void eraseFrom (table_type &t, unsigned id)
+    {
+      auto range = t.equal_range (id);
+      if (range.first == range.second) return;
+
+      // -- results are released after the entries are gone since
+      // -- releasing them can call erase ()
+      ExprVector dead;
+      for (auto it = range.first; it != range.second; ++it)
+        dead.push_back (it->second.res);
+      t.erase (range.first, range.second);
+    }
+
+    /** returns the id of the rewriter (name, key) and sets nameId
+        to the index of name in m_named */
+    unsigned rewriterId (const std::string &name, Expr key, unsigned &nameId)
+    {
+      auto nit = m_nameIds.find (name);
+      if (nit == m_nameIds.end ())
+        {
+          nit = m_nameIds.insert (std::make_pair (name, m_named.size ())).first;
+          m_named.push_back (Named (name));
+        }
+
+      nameId = nit->second;
+      auto k = std::make_pair (nameId, key ? key->getId () : 0);
+      auto it = m_rws.find (k);
+      if (it == m_rws.end ())
+        it = m_rws.insert (std::make_pair (k, m_rws.size ())).first;
+      return it->second;
+    }
+
+  public:
+    RewriteMemo (ExprFactory &efac, size_t capacity = 1 << 20) :
+      m_efac (efac), m_capacity (std::max (capacity, (size_t)2))
+    { m_efac.registerCache (*this); }
+
+    ~RewriteMemo ()
+    {
+      m_efac.unregisterCache (*this);
+      clear ();
+    }
+
+    /** applies v to e as the rewriter (name, key) */
+    template <typename ExprVisitor>
+    Expr visit (const std::string &name, Expr key, ExprVisitor &v, Expr e)
+    {
+      unsigned nameId;
+      unsigned rw = rewriterId (name, key, nameId);
+      Expr res = details::VisitEngine<ExprVisitor, Cache>
+        (v, Cache (*this, rw, nameId), m_scratch) (e);
+
+      const Named &named = m_named [nameId];
+      ufo::Stats::uset (named.hitName, named.hits);
+      ufo::Stats::uset (named.missName, named.misses);
+      return res;
+    }
+
+    /** replace () memoized as the rewriter (name, key) */
+    template <typename M>
+    Expr replace (const std::string &name, Expr key, Expr e, const M &map)
+    {
+      RV<M> rv (map);
+      return visit (name, key, rv, e);
+    }
+
+    /** forgets the results for n. Called by the factory when n dies */
+    void erase (ENode *n)
+    {
+      eraseFrom (m_young, n->getId ());
+      eraseFrom (m_old, n->getId ());
+    }
+
+    void clear ()
+    {
+      table_type young, old;
+      young.swap (m_young);
+      old.swap (m_old);
+    }
+
+    size_t size () const { return m_young.size () + m_old.size (); }
+  };
+}
+
+#endif
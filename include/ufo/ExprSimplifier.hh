@@ -0,0 +1,720 @@
+/**
+Rule-based simplifier over Expr.
+*/
+#ifndef _EXPR_SIMPLIFIER__HH_
+#define _EXPR_SIMPLIFIER__HH_
+
+#include "ufo/Expr.hpp"
+
+namespace expr
+{
+  namespace op
+  {
+    namespace simp
+    {
+      /** true if e is an integer numeral */
+      inline bool isNum (Expr e) { return isOpX<MPZ> (e); }
+
+      /** true if e is a numeral, a bit-vector numeral or a terminal */
+      inline bool isValue (Expr e)
+      { return e->arity () == 0 || bv::is_bvnum (e); }
+
+      /** true if e is known to be of integer sort */
+      inline bool isIntTerm (Expr e)
+      {
+        while (true)
+        {
+          if (isNum (e)) return true;
+          if (bind::isIntVar (e)) return true;
+          if (bind::isFapp (e))
+            return isOpX<FDECL> (e->left ()) &&
+              isOpX<INT_TY> (bind::rangeTy (e->left ()));
+          if (isOpX<MOD> (e) || isOpX<IDIV> (e)) return true;
+
+          if (isOpX<VARIANT> (e)) e = variant::mainVariant (e);
+          else if (isOpX<ITE> (e)) e = e->arg (1);
+          else if (isOpX<PLUS> (e) || isOpX<MINUS> (e) || isOpX<MULT> (e) ||
+                   isOpX<UN_MINUS> (e) || isOpX<ABS> (e) || isOpX<DIV> (e))
+            e = e->left ();
+          else return false;
+        }
+      }
+
+      /**
+       * A linear combination of integer atoms plus a constant.
+       */
+      struct LinearForm
+      {
+        typedef std::pair<Expr, mpz_class> Term;
+
+        std::vector<Term> terms;
+        std::unordered_map<ENode*, size_t> index;
+        mpz_class k;
+
+        LinearForm () : k (0) {}
+
+        void add (Expr atom, const mpz_class &c)
+        {
+          auto it = index.insert (std::make_pair (&*atom, terms.size ()));
+          if (it.second) terms.push_back (Term (atom, c));
+          else terms [it.first->second].second += c;
+        }
+
+        /** drops terms with zero coefficients and orders the rest by
+            the id of the atom */
+        void normalize ()
+        {
+          std::vector<Term> res;
+          for (Term &t : terms)
+            if (t.second != 0) res.push_back (t);
+          std::sort (res.begin (), res.end (),
+                     [] (const Term &a, const Term &b)
+                     { return a.first->getId () < b.first->getId (); });
+          terms.swap (res);
+          index.clear ();
+        }
+
+        void negate ()
+        {
+          for (Term &t : terms) t.second = -t.second;
+          k = -k;
+        }
+
+        /** gcd of the coefficients, 0 if there are none */
+        mpz_class gcd () const
+        {
+          mpz_class g (0);
+          for (const Term &t : terms)
+            mpz_gcd (g.get_mpz_t (), g.get_mpz_t (), t.second.get_mpz_t ());
+          return g;
+        }
+      };
+
+      /**
+       * Simplifies a term whose arguments are already simplified.
+       *
+       * The rules are local: constant folding of integer and
+       * bit-vector operators, Boolean absorption, lifting of
+       * operators over an ite of values, and normalization of sums
+       * and comparisons over integer atoms into a linear form. Terms
+       * that are not known to be integer are only folded, so that a
+       * rule never changes the sort of a term.
+       */
+      class Simplifier : public std::unary_function<Expr,Expr>
+      {
+        ExprFactory &m_efac;
+        Expr m_true;
+        Expr m_false;
+
+        /** bound on the number of nodes visited to build a linear form */
+        static const unsigned LINEAR_LIMIT = 256;
+
+        Expr mkNum (const mpz_class &v) { return mkTerm<mpz_class> (v, m_efac); }
+        Expr mkBool (bool v) { return v ? m_true : m_false; }
+
+        /** non-negative remainder of v modulo 2^w */
+        static mpz_class mod2 (const mpz_class &v, unsigned w)
+        {
+          mpz_class r;
+          mpz_fdiv_r_2exp (r.get_mpz_t (), v.get_mpz_t (), w);
+          return r;
+        }
+
+        /** v as a signed value of width w */
+        static mpz_class toSigned (const mpz_class &v, unsigned w)
+        {
+          mpz_class r = mod2 (v, w);
+          if (w > 0 && mpz_tstbit (r.get_mpz_t (), w - 1))
+            r -= mpz_class (1) << w;
+          return r;
+        }
+
+        static unsigned bvWidth (Expr n) { return bv::width (n->right ()); }
+        static mpz_class bvVal (Expr n) { return mod2 (bv::toMpz (n), bvWidth (n)); }
+        Expr mkBv (const mpz_class &v, Expr sort)
+        { return bv::bvnum (mkNum (mod2 (v, bv::width (sort))), sort); }
+
+        Expr sum (const ExprVector &args)
+        {
+          if (args.empty ()) return mkNum (0);
+          if (args.size () == 1) return args [0];
+          return mknary<PLUS> (args);
+        }
+
+        Expr term (const mpz_class &c, Expr atom)
+        { return c == 1 ? atom : mk<MULT> (mkNum (c), atom); }
+
+        /** collects e into f. Fails if an atom is not integer or if e
+            is too large */
+        bool linear (Expr e, LinearForm &f)
+        {
+          std::vector<std::pair<Expr, mpz_class> > todo;
+          todo.push_back (std::make_pair (e, mpz_class (1)));
+          unsigned steps = 0;
+
+          while (!todo.empty ())
+          {
+            if (++steps > LINEAR_LIMIT) return false;
+            Expr t = todo.back ().first;
+            mpz_class c = todo.back ().second;
+            todo.pop_back ();
+
+            if (isNum (t)) f.k += c * getTerm<mpz_class> (t);
+            else if (isOpX<PLUS> (t))
+              for (auto it = t->args_begin (), end = t->args_end (); it != end; ++it)
+                todo.push_back (std::make_pair (Expr (*it), c));
+            else if (isOpX<MINUS> (t))
+            {
+              todo.push_back (std::make_pair (t->left (), c));
+              for (auto it = ++t->args_begin (), end = t->args_end (); it != end; ++it)
+                todo.push_back (std::make_pair (Expr (*it), mpz_class (-c)));
+            }
+            else if (isOpX<UN_MINUS> (t))
+              todo.push_back (std::make_pair (t->left (), mpz_class (-c)));
+            else if (isOpX<MULT> (t) && numFactor (t, c, todo)) {}
+            else
+            {
+              if (!isIntTerm (t)) return false;
+              f.add (t, c);
+            }
+          }
+          return true;
+        }
+
+        /** c * t where t is a product with at most one non-numeral
+            factor. Returns false if t has more than one */
+        bool numFactor (Expr t, const mpz_class &c,
+                        std::vector<std::pair<Expr, mpz_class> > &todo)
+        {
+          mpz_class p (c);
+          Expr atom;
+          for (auto it = t->args_begin (), end = t->args_end (); it != end; ++it)
+          {
+            if (isNum (*it)) p *= getTerm<mpz_class> (*it);
+            else if (atom) return false;
+            else atom = *it;
+          }
+
+          todo.push_back (atom ? std::make_pair (atom, p) :
+                          std::make_pair (mkNum (p), mpz_class (1)));
+          return true;
+        }
+
+        /** builds the linear form f as a sum and a difference */
+        Expr fromLinear (LinearForm &f)
+        {
+          f.normalize ();
+          ExprVector pos, neg;
+          for (const LinearForm::Term &t : f.terms)
+            if (t.second > 0) pos.push_back (term (t.second, t.first));
+            else neg.push_back (term (-t.second, t.first));
+
+          if (f.k > 0 || (f.k != 0 && pos.empty () && neg.empty ()))
+            pos.push_back (mkNum (f.k));
+          else if (f.k < 0) neg.push_back (mkNum (-f.k));
+
+          if (neg.empty ()) return sum (pos);
+          if (pos.empty ()) return mk<UN_MINUS> (sum (neg));
+          return mk<MINUS> (sum (pos), sum (neg));
+        }
+
+        Expr negate (Expr e) { return boolean (mk<NEG> (e)); }
+
+        Expr nary (Expr e, bool isAnd)
+        {
+          Expr unit = isAnd ? m_true : m_false;
+          Expr zero = isAnd ? m_false : m_true;
+
+          ExprVector args;
+          std::unordered_set<ENode*> seen;
+          auto addArg = [&] (Expr a)
+            {
+              if (a == unit) return true;
+              if (a == zero) return false;
+              if (seen.insert (&*a).second) args.push_back (a);
+              return true;
+            };
+
+          // -- arguments are simplified, so one level of flattening suffices
+          for (auto it = e->args_begin (), end = e->args_end (); it != end; ++it)
+          {
+            Expr a (*it);
+            if (isAnd ? isOpX<AND> (a) : isOpX<OR> (a))
+            {
+              for (auto kt = a->args_begin (), kend = a->args_end (); kt != kend; ++kt)
+                if (!addArg (*kt)) return zero;
+            }
+            else if (!addArg (a)) return zero;
+          }
+
+          ExprVector res;
+          for (Expr a : args)
+          {
+            // -- x && !x
+            if (isOpX<NEG> (a) && seen.count (a->left ())) return zero;
+
+            // -- x && (x || y)
+            bool absorbed = false;
+            if (isAnd ? isOpX<OR> (a) : isOpX<AND> (a))
+              for (auto it = a->args_begin (), end = a->args_end ();
+                   !absorbed && it != end; ++it)
+                absorbed = seen.count (*it) > 0;
+            if (!absorbed) res.push_back (a);
+          }
+
+          if (res.empty ()) return unit;
+          if (res.size () == 1) return res [0];
+          return isAnd ? mknary<AND> (res) : mknary<OR> (res);
+        }
+
+        Expr ite (Expr c, Expr t, Expr f)
+        {
+          if (isOpX<NEG> (c)) { c = c->left (); std::swap (t, f); }
+
+          if (c == m_true) return t;
+          if (c == m_false) return f;
+          if (t == f) return t;
+
+          // -- ite (c, ite (c, a, b), d)
+          if (isOpX<ITE> (t) && t->arg (0) == c) t = t->arg (1);
+          if (isOpX<ITE> (f) && f->arg (0) == c) f = f->arg (2);
+          if (t == f) return t;
+
+          if (t == m_true && f == m_false) return c;
+          if (t == m_false && f == m_true) return negate (c);
+          if (t == m_true || t == c) return nary (mk<OR> (c, f), false);
+          if (f == m_false || f == c) return nary (mk<AND> (c, t), true);
+          if (t == m_false) return nary (mk<AND> (negate (c), f), true);
+          if (f == m_true) return nary (mk<OR> (negate (c), t), false);
+
+          return mk<ITE> (c, t, f);
+        }
+
+        Expr boolean (Expr e)
+        {
+          if (isOpX<AND> (e)) return nary (e, true);
+          if (isOpX<OR> (e)) return nary (e, false);
+          if (isOpX<ITE> (e) && e->arity () == 3)
+            return ite (e->arg (0), e->arg (1), e->arg (2));
+
+          if (isOpX<NEG> (e))
+          {
+            Expr a = e->left ();
+            if (a == m_true) return m_false;
+            if (a == m_false) return m_true;
+            if (isOpX<NEG> (a)) return a->left ();
+            if (isOpX<EQ> (a)) return compare (mk<NEQ> (a->left (), a->right ()));
+            if (isOpX<NEQ> (a)) return compare (mk<EQ> (a->left (), a->right ()));
+            if (isOpX<LT> (a)) return compare (mk<GEQ> (a->left (), a->right ()));
+            if (isOpX<LEQ> (a)) return compare (mk<GT> (a->left (), a->right ()));
+            if (isOpX<GT> (a)) return compare (mk<LEQ> (a->left (), a->right ()));
+            if (isOpX<GEQ> (a)) return compare (mk<LT> (a->left (), a->right ()));
+            return e;
+          }
+
+          if (e->arity () != 2) return e;
+          Expr a = e->left ();
+          Expr b = e->right ();
+
+          if (isOpX<IMPL> (e))
+          {
+            if (a == m_true) return b;
+            if (a == m_false || b == m_true || a == b) return m_true;
+            if (b == m_false) return negate (a);
+            return e;
+          }
+
+          if (isOpX<IFF> (e) || isOpX<XOR> (e))
+          {
+            bool iff = isOpX<IFF> (e);
+            if (a == b) return mkBool (iff);
+            if (b == m_true || b == m_false) std::swap (a, b);
+            if (a == m_true) return iff ? b : negate (b);
+            if (a == m_false) return iff ? negate (b) : b;
+          }
+          return e;
+        }
+
+        /** folds comparisons of numerals and normalizes comparisons
+            of integer linear terms to P op N + k */
+        Expr compare (Expr e)
+        {
+          if (e->arity () != 2) return e;
+          Expr a = e->left ();
+          Expr b = e->right ();
+          bool eq = isOpX<EQ> (e);
+          bool neq = isOpX<NEQ> (e);
+
+          if (a == b) return mkBool (eq || isOpX<LEQ> (e) || isOpX<GEQ> (e));
+
+          if (isNum (a) && isNum (b))
+          {
+            int cmp = ::cmp (getTerm<mpz_class> (a), getTerm<mpz_class> (b));
+            if (eq) return mkBool (cmp == 0);
+            if (neq) return mkBool (cmp != 0);
+            if (isOpX<LEQ> (e)) return mkBool (cmp <= 0);
+            if (isOpX<GEQ> (e)) return mkBool (cmp >= 0);
+            if (isOpX<LT> (e)) return mkBool (cmp < 0);
+            if (isOpX<GT> (e)) return mkBool (cmp > 0);
+            return e;
+          }
+
+          if (!eq && !neq && !isOpX<LEQ> (e) && !isOpX<GEQ> (e) &&
+              !isOpX<LT> (e) && !isOpX<GT> (e))
+            return e;
+
+          if (eq || neq)
+          {
+            if (bv::is_bvnum (a) && bv::is_bvnum (b))
+              return mkBool ((bvVal (a) == bvVal (b)) == eq);
+            if (b == m_true || b == m_false) std::swap (a, b);
+            if (a == m_true) return eq ? b : negate (b);
+            if (a == m_false) return eq ? negate (b) : b;
+          }
+
+          // -- a - b op 0
+          LinearForm f;
+          if (!linear (a, f)) return e;
+          LinearForm g;
+          if (!linear (b, g)) return e;
+          g.negate ();
+          for (const LinearForm::Term &t : g.terms) f.add (t.first, t.second);
+          f.k += g.k;
+          f.normalize ();
+
+          if (f.terms.empty ())
+          {
+            int s = sgn (f.k);
+            if (eq) return mkBool (s == 0);
+            if (neq) return mkBool (s != 0);
+            if (isOpX<LEQ> (e)) return mkBool (s <= 0);
+            if (isOpX<GEQ> (e)) return mkBool (s >= 0);
+            if (isOpX<LT> (e)) return mkBool (s < 0);
+            return mkBool (s > 0);
+          }
+
+          // -- everything is f <= 0, f = 0 or f != 0
+          if (isOpX<GEQ> (e) || isOpX<GT> (e)) f.negate ();
+          if (isOpX<LT> (e) || isOpX<GT> (e)) f.k += 1;
+
+          mpz_class gcd = f.gcd ();
+          if (eq || neq)
+          {
+            if (f.k % gcd != 0) return mkBool (neq);
+            if (f.terms [0].second < 0) f.negate ();
+            f.k /= gcd;
+          }
+          else
+            mpz_cdiv_q (f.k.get_mpz_t (), f.k.get_mpz_t (), gcd.get_mpz_t ());
+          for (LinearForm::Term &t : f.terms) t.second /= gcd;
+
+          // -- P - N + k op 0 becomes P op N - k
+          mpz_class k = -f.k;
+          f.k = 0;
+          ExprVector pos, neg;
+          for (const LinearForm::Term &t : f.terms)
+            if (t.second > 0) pos.push_back (term (t.second, t.first));
+            else neg.push_back (term (-t.second, t.first));
+
+          Expr lhs, rhs;
+          if (pos.empty ())
+          {
+            // -- 0 <= N + k is N >= -k
+            lhs = sum (neg);
+            rhs = mkNum (-k);
+            if (eq) return mk<EQ> (lhs, rhs);
+            if (neq) return mk<NEQ> (lhs, rhs);
+            return mk<GEQ> (lhs, rhs);
+          }
+
+          lhs = sum (pos);
+          if (k != 0) neg.push_back (mkNum (k));
+          rhs = sum (neg);
+          if (eq) return mk<EQ> (lhs, rhs);
+          if (neq) return mk<NEQ> (lhs, rhs);
+          return mk<LEQ> (lhs, rhs);
+        }
+
+        /** division of integer numerals as in SMT-LIB */
+        static mpz_class ediv (const mpz_class &a, const mpz_class &b)
+        {
+          mpz_class q;
+          if (b > 0) mpz_fdiv_q (q.get_mpz_t (), a.get_mpz_t (), b.get_mpz_t ());
+          else mpz_cdiv_q (q.get_mpz_t (), a.get_mpz_t (), b.get_mpz_t ());
+          return q;
+        }
+
+        Expr arith (Expr e)
+        {
+          if (isOpX<UN_MINUS> (e) && e->arity () == 1)
+          {
+            Expr a = e->left ();
+            if (isNum (a)) return mkNum (-getTerm<mpz_class> (a));
+            if (isOpX<UN_MINUS> (a)) return a->left ();
+          }
+          else if (isOpX<ABS> (e) && e->arity () == 1)
+          {
+            if (isNum (e->left ())) return mkNum (abs (getTerm<mpz_class> (e->left ())));
+            return e;
+          }
+          else if ((isOpX<DIV> (e) || isOpX<IDIV> (e) || isOpX<MOD> (e)) &&
+                   e->arity () == 2)
+          {
+            Expr a = e->left ();
+            Expr b = e->right ();
+            if (!isNum (b)) return e;
+            mpz_class d = getTerm<mpz_class> (b);
+            if (d == 0) return e;
+            if (d == 1 && !isOpX<MOD> (e)) return a;
+            if (!isNum (a)) return e;
+
+            mpz_class n = getTerm<mpz_class> (a);
+            mpz_class q = ediv (n, d);
+            return isOpX<MOD> (e) ? mkNum (n - q * d) : mkNum (q);
+          }
+          else if (!isOpX<PLUS> (e) && !isOpX<MINUS> (e) && !isOpX<MULT> (e))
+            return e;
+
+          LinearForm f;
+          if (linear (e, f)) return fromLinear (f);
+
+          // -- not known to be integer. Only combine numerals
+          if (isOpX<MINUS> (e))
+          {
+            if (e->arity () == 2 && isNum (e->right ()) &&
+                getTerm<mpz_class> (e->right ()) == 0)
+              return e->left ();
+            return e;
+          }
+
+          bool plus = isOpX<PLUS> (e);
+          mpz_class k (plus ? 0 : 1);
+          ExprVector args;
+          unsigned nums = 0;
+          for (auto it = e->args_begin (), end = e->args_end (); it != end; ++it)
+          {
+            if (!isNum (*it)) { args.push_back (*it); continue; }
+            ++nums;
+            if (plus) k += getTerm<mpz_class> (*it);
+            else k *= getTerm<mpz_class> (*it);
+          }
+
+          if (nums == 0 || (nums == 1 && k != (plus ? 0 : 1))) return e;
+          if (k != (plus ? 0 : 1) || args.empty ()) args.push_back (mkNum (k));
+          if (args.size () == 1) return args [0];
+          return plus ? mknary<PLUS> (args) : mknary<MULT> (args);
+        }
+
+        Expr bvfold (Expr e)
+        {
+          if (isOpX<BEXTRACT> (e))
+          {
+            Expr a = bv::earg (e);
+            if (!bv::is_bvnum (a)) return e;
+            unsigned w = bv::high (e) - bv::low (e) + 1;
+            mpz_class v = bvVal (a) >> bv::low (e);
+            return mkBv (v, bv::bvsort (w, m_efac));
+          }
+
+          if (e->arity () == 1)
+          {
+            Expr a = e->left ();
+            if ((isOpX<BNOT> (e) && isOpX<BNOT> (a)) ||
+                (isOpX<BNEG> (e) && isOpX<BNEG> (a)))
+              return a->left ();
+            if (!bv::is_bvnum (a)) return e;
+            if (isOpX<BNOT> (e)) return mkBv (~bvVal (a), a->right ());
+            if (isOpX<BNEG> (e)) return mkBv (-bvVal (a), a->right ());
+            return e;
+          }
+
+          if (e->arity () != 2) return e;
+          Expr a = e->left ();
+          Expr b = e->right ();
+
+          if (isOpX<BZEXT> (e) || isOpX<BSEXT> (e))
+          {
+            if (!bv::is_bvnum (a)) return e;
+            mpz_class v = isOpX<BZEXT> (e) ? bvVal (a) : toSigned (bvVal (a), bvWidth (a));
+            return mkBv (v, b);
+          }
+
+          bool na = bv::is_bvnum (a);
+          bool nb = bv::is_bvnum (b);
+
+          if (a == b)
+          {
+            if (isOpX<BAND> (e) || isOpX<BOR> (e)) return a;
+            if (isOpX<BULE> (e) || isOpX<BSLE> (e) ||
+                isOpX<BUGE> (e) || isOpX<BSGE> (e))
+              return m_true;
+            if (isOpX<BULT> (e) || isOpX<BSLT> (e) ||
+                isOpX<BUGT> (e) || isOpX<BSGT> (e))
+              return m_false;
+          }
+
+          if (na != nb)
+          {
+            Expr n = na ? a : b;
+            Expr x = na ? b : a;
+            mpz_class v = bvVal (n);
+            mpz_class ones = (mpz_class (1) << bvWidth (n)) - 1;
+            bool comm = isOpX<BADD> (e) || isOpX<BMUL> (e) || isOpX<BAND> (e) ||
+              isOpX<BOR> (e) || isOpX<BXOR> (e);
+
+            if (comm || nb)
+            {
+              if (v == 0 && (isOpX<BADD> (e) || isOpX<BOR> (e) ||
+                             isOpX<BXOR> (e) || isOpX<BSUB> (e) ||
+                             isOpX<BSHL> (e) || isOpX<BLSHR> (e) ||
+                             isOpX<BASHR> (e)))
+                return x;
+              if (v == 0 && (isOpX<BMUL> (e) || isOpX<BAND> (e))) return n;
+              if (v == 1 && (isOpX<BMUL> (e) || isOpX<BUDIV> (e))) return x;
+              if (v == ones && isOpX<BAND> (e)) return x;
+              if (v == ones && isOpX<BOR> (e)) return n;
+            }
+            return e;
+          }
+          if (!na) return e;
+
+          unsigned w = bvWidth (a);
+          Expr sort = a->right ();
+          mpz_class x = bvVal (a);
+          mpz_class y = bvVal (b);
+          mpz_class sx = toSigned (x, w);
+          mpz_class sy = toSigned (y, w);
+
+          if (isOpX<BADD> (e)) return mkBv (x + y, sort);
+          if (isOpX<BSUB> (e)) return mkBv (x - y, sort);
+          if (isOpX<BMUL> (e)) return mkBv (x * y, sort);
+          if (isOpX<BAND> (e)) return mkBv (x & y, sort);
+          if (isOpX<BOR> (e)) return mkBv (x | y, sort);
+          if (isOpX<BXOR> (e)) return mkBv (x ^ y, sort);
+          if (isOpX<BNAND> (e)) return mkBv (~(x & y), sort);
+          if (isOpX<BNOR> (e)) return mkBv (~(x | y), sort);
+          if (isOpX<BXNOR> (e)) return mkBv (~(x ^ y), sort);
+
+          // -- division by zero as in SMT-LIB
+          if (isOpX<BUDIV> (e)) return mkBv (y == 0 ? mpz_class (-1) : mpz_class (x / y), sort);
+          if (isOpX<BUREM> (e)) return mkBv (y == 0 ? x : mpz_class (x % y), sort);
+          if (y != 0)
+          {
+            // -- mpz division truncates
+            if (isOpX<BSDIV> (e)) return mkBv (sx / sy, sort);
+            if (isOpX<BSREM> (e)) return mkBv (sx % sy, sort);
+            if (isOpX<BSMOD> (e))
+            {
+              mpz_class r = sx % sy;
+              if (r != 0 && sgn (r) != sgn (sy)) r += sy;
+              return mkBv (r, sort);
+            }
+          }
+
+          if (isOpX<BULT> (e)) return mkBool (x < y);
+          if (isOpX<BULE> (e)) return mkBool (x <= y);
+          if (isOpX<BUGT> (e)) return mkBool (x > y);
+          if (isOpX<BUGE> (e)) return mkBool (x >= y);
+          if (isOpX<BSLT> (e)) return mkBool (sx < sy);
+          if (isOpX<BSLE> (e)) return mkBool (sx <= sy);
+          if (isOpX<BSGT> (e)) return mkBool (sx > sy);
+          if (isOpX<BSGE> (e)) return mkBool (sx >= sy);
+
+          if (isOpX<BCONCAT> (e))
+            return mkBv ((x << bvWidth (b)) | y,
+                         bv::bvsort (w + bvWidth (b), m_efac));
+
+          unsigned sh = y < w ? (unsigned) y.get_ui () : w;
+          if (isOpX<BSHL> (e)) return mkBv (sh < w ? mpz_class (x << sh) : mpz_class (0), sort);
+          if (isOpX<BLSHR> (e)) return mkBv (x >> sh, sort);
+          if (isOpX<BASHR> (e))
+          {
+            mpz_class r;
+            mpz_fdiv_q_2exp (r.get_mpz_t (), sx.get_mpz_t (), sh);
+            return mkBv (r, sort);
+          }
+          return e;
+        }
+
+        /** op (.., ite (c, u, v), ..) is ite (c, op (.., u, ..), op (.., v, ..))
+            when all other arguments and u and v are values */
+        Expr liftIte (Expr e)
+        {
+          int pos = -1;
+          for (unsigned i = 0, sz = e->arity (); i < sz; ++i)
+          {
+            Expr a = e->arg (i);
+            if (isValue (a)) continue;
+            if (pos < 0 && isOpX<ITE> (a) && a->arity () == 3 &&
+                isValue (a->arg (1)) && isValue (a->arg (2)))
+              pos = i;
+            else
+              return Expr ();
+          }
+          if (pos < 0) return Expr ();
+
+          Expr c = e->arg (pos);
+          ExprVector kids (e->args_begin (), e->args_end ());
+          kids [pos] = c->arg (1);
+          Expr t = (*this) (m_efac.mkNary (e->op (), kids));
+          kids [pos] = c->arg (2);
+          Expr f = (*this) (m_efac.mkNary (e->op (), kids));
+          return ite (c->arg (0), t, f);
+        }
+
+      public:
+        Simplifier (ExprFactory &efac) :
+          m_efac (efac), m_true (mk<TRUE> (efac)), m_false (mk<FALSE> (efac)) {}
+
+        Expr operator() (Expr e)
+        {
+          if (e->arity () == 0) return e;
+          if (isOp<BoolOp> (e)) return boolean (e);
+
+          bool num = isOp<NumericOp> (e);
+          bool cmp = isOp<ComparissonOp> (e);
+          bool bvop = isOp<BvOp> (e);
+          if (!num && !cmp && !bvop) return e;
+
+          Expr res = liftIte (e);
+          if (res) return res;
+
+          if (num) return arith (e);
+          if (cmp) return compare (e);
+          return bvfold (e);
+        }
+      };
+
+      namespace details
+      {
+        struct SimpVisitor : public std::unary_function<Expr,VisitAction>
+        {
+          std::shared_ptr<Simplifier> m_rw;
+
+          SimpVisitor (ExprFactory &efac) :
+            m_rw (std::make_shared<Simplifier> (efac)) {}
+
+          VisitAction operator() (Expr e) const
+          {
+            // -- names, sorts and bit-vector numerals are left alone
+            if (e->arity () == 0 || isOpX<FDECL> (e) || isOpX<BIND> (e))
+              return VisitAction::skipKids ();
+            return VisitAction::changeDoKidsRewrite (e, m_rw);
+          }
+        };
+      }
+
+      /**
+       * Simplifies e bottom-up without a round trip through the
+       * solver. The result is equivalent to e and of the same sort.
+       */
+      inline Expr simplify (Expr e)
+      {
+        details::SimpVisitor v (e->efac ());
+        return dagVisit (v, e);
+      }
+    }
+  }
+}
+
+#endif
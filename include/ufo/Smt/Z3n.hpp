@@ -30,6 +30,7 @@ DM-0002198
 
 
 #include <sstream>
+#include <algorithm>
 
 #include <unordered_map>
 #include <unordered_set>
@@ -38,11 +39,13 @@ DM-0002198
 #include <boost/range/algorithm/copy.hpp>
 #include <boost/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
+#include <boost/bimap/list_of.hpp>
 #include <boost/logic/tribool.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include "ufo/Expr.hpp"
 #include "ufo/ExprInterp.hh"
+#include "ufo/Stats.hh"
 
 namespace z3
 {
@@ -220,6 +223,88 @@ namespace ufo
 
   using namespace boost;
 
+  /// -- counters of the Expr <-> ast cache of a ZContext
+  struct ZCacheStats
+  {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    ZCacheStats () : hits (0), misses (0), evictions (0) {}
+  };
+
+  /**
+   * Names of the declarations and variables evicted from the cache of
+   * a ZContext that cannot be recovered from their Z3 symbols, i.e.,
+   * names that are not strings. Keyed by the Z3 symbol, which Z3 never
+   * frees.
+   */
+  struct ZNameTable
+  {
+    /// -- the name of an evicted function declaration
+    std::unordered_map<Z3_symbol, Expr> decls;
+    /// -- an evicted bool, int or real variable
+    std::unordered_map<Z3_symbol, Expr> vars;
+  };
+
+  /**
+   * The view of one side of the cache of a ZContext given to the
+   * marshaler and the unmarshaler. Counts hits and insertions, and
+   * moves every hit entry to the back of the eviction order.
+   */
+  template <typename Cache, typename View>
+  class ZCacheView
+  {
+    Cache &m_cache;
+    View &m_view;
+    ZCacheStats &m_stats;
+    const ZNameTable &m_names;
+
+    static Expr lookupName (const std::unordered_map<Z3_symbol,Expr> &m,
+                            Z3_symbol s)
+    {
+      if (m.empty ()) return Expr ();
+      auto it = m.find (s);
+      return it == m.end () ? Expr () : it->second;
+    }
+
+  public:
+    typedef typename View::const_iterator const_iterator;
+    typedef typename View::value_type value_type;
+
+    ZCacheView (Cache &cache, View &view, ZCacheStats &stats,
+                const ZNameTable &names) :
+      m_cache (cache), m_view (view), m_stats (stats), m_names (names) {}
+
+    template <typename K>
+    const_iterator find (const K &k)
+    {
+      typename View::iterator it = m_view.find (k);
+      if (it != m_view.end ())
+      {
+        ++m_stats.hits;
+        m_cache.relocate (m_cache.end (), m_cache.project_up (it));
+      }
+      return it;
+    }
+
+    const_iterator end () const { return m_view.end (); }
+
+    std::pair<const_iterator,bool> insert (const value_type &v)
+    {
+      std::pair<typename View::iterator,bool> res = m_view.insert (v);
+      if (res.second) ++m_stats.misses;
+      return std::make_pair (const_iterator (res.first), res.second);
+    }
+
+    /// -- the name of an evicted declaration named s, if any
+    Expr evictedName (Z3_symbol s) const
+    { return lookupName (m_names.decls, s); }
+    /// -- the evicted variable named s, if any
+    Expr evictedVar (Z3_symbol s) const
+    { return lookupName (m_names.vars, s); }
+    bool hasEvictedVars () const { return !m_names.vars.empty (); }
+  };
+
   /**
    * AST manager. Responsible for converting between Z3 ast and Expr.
    *
@@ -231,35 +316,195 @@ namespace ufo
   {
   private:
     typedef ZContext<M,U> this_type;
+    /// -- entries are kept from the least to the most recently used
     typedef bimap< bimaps::unordered_set_of<Expr>,
 		   bimaps::unordered_set_of<z3::ast,
 					    z3::ast_ptr_hash,
-					    z3::ast_ptr_equal_to> > cache_type;
+					    z3::ast_ptr_equal_to>,
+                   bimaps::list_of_relation> cache_type;
+    typedef ZCacheView<cache_type,
+                       typename cache_type::left_map> expr_cache_view;
+    typedef ZCacheView<cache_type,
+                       typename cache_type::right_map> ast_cache_view;
 
     ExprFactory& efac;
     z3::context ctx;
 
+    /**
+     * Constants, sorts, declarations and applications of uninterpreted
+     * functions that have been converted. Unmarshaling relies on it to
+     * recover the Expr names that are not strings.
+     *
+     * If a memory budget is set, the cache is kept below it by
+     * evicting, least recently used first, the entries whose Expr is
+     * referenced only by the cache. Such an Expr cannot be given to
+     * toAst again, and Z3 keeps the ast alive for as long as it is in
+     * use. Entries in use are never evicted, so the budget is exceeded
+     * when they alone do not fit. The names of evicted declarations
+     * and variables that are not strings are kept in m_names.
+     */
     cache_type cache;
+    ZNameTable m_names;
+    /// -- memory budget of the cache in bytes. 0 means unbounded
+    size_t m_cacheBudget;
+    /// -- number of entries at which the cache is swept next
+    size_t m_cacheSweepAt;
+    size_t m_cachePeak;
+    ZCacheStats m_cacheStats;
+    /// -- part of m_cacheStats that is already in ufo::Stats
+    ZCacheStats m_cachePublished;
+
+    /// -- scratch tables of a single conversion. Kept between
+    /// -- conversions to reuse their buckets
+    expr_ast_map m_toAstSeen;
+    ast_expr_map m_toExprSeen;
 
     void init ()
     {
+      m_cacheSweepAt = m_cacheBudget / cacheEntryBytes ();
       Z3_set_ast_print_mode (ctx, Z3_PRINT_SMTLIB2_COMPLIANT);
     }
 
+    /// -- empties a scratch table. A table that is much larger than
+    /// -- the last conversion is released since clearing it costs its
+    /// -- number of buckets
+    template <typename Map>
+    static void clearScratch (Map &m)
+    {
+      if (m.bucket_count () > 1024 && m.size () * 4 < m.bucket_count ())
+	Map ().swap (m);
+      else
+	m.clear ();
+    }
+
+    /// -- approximate size of a cache entry: the relation, the links
+    /// -- of its three indices and a bucket of each hashed index
+    static size_t cacheEntryBytes ()
+    { return sizeof (typename cache_type::value_type) + 6 * sizeof (void*); }
+
+    /// -- true if e is a declaration or variable whose name is not a
+    /// -- string. Its name cannot be recovered from the ast without
+    /// -- the cache
+    static bool hasOpaqueName (const Expr &e)
+    {
+      Expr name;
+      if (bind::isFdecl (e)) name = bind::fname (e);
+      else if (bind::isBoolVar (e) || bind::isIntVar (e) || bind::isRealVar (e))
+        name = bind::name (e);
+      else return false;
+      return !isOpX<STRING> (name);
+    }
+
+    /// -- records the name of e, the Expr of an evicted entry of ast a
+    void rememberName (const Expr &e, const z3::ast &a)
+    {
+      if (bind::isFdecl (e))
+        m_names.decls [Z3_get_decl_name (ctx, Z3_to_func_decl (ctx, a))] =
+          bind::fname (e);
+      else
+        m_names.vars [Z3_get_decl_name
+                      (ctx, Z3_get_app_decl (ctx, Z3_to_app (ctx, a)))] = e;
+    }
+
+    /// -- evicts unreferenced entries if the cache is over budget
+    void shrinkCache ()
+    {
+      size_t sz = cache.size ();
+      if (sz > m_cachePeak) m_cachePeak = sz;
+      if (m_cacheBudget == 0 || sz <= m_cacheSweepAt) return;
+
+      size_t limit = m_cacheBudget / cacheEntryBytes ();
+      // -- evict down to 3/4 of the budget so that sweeps are rare
+      size_t target = limit - limit / 4;
+
+      // -- evicting an entry may release the last reference to the
+      // -- Expr of an older entry, e.g., the fdecl of a constant
+      bool progress = true;
+      while (cache.size () > target && progress)
+      {
+        progress = false;
+        typename cache_type::iterator it = cache.begin ();
+        while (it != cache.end () && cache.size () > target)
+        {
+          if (it->left.get ()->use_count () == 1)
+          {
+            if (hasOpaqueName (it->left)) rememberName (it->left, it->right);
+            it = cache.erase (it);
+            ++m_cacheStats.evictions;
+            progress = true;
+          }
+          else
+            ++it;
+        }
+      }
+
+      // -- when the entries in use do not fit, wait for the cache to
+      // -- grow by half before the next sweep
+      m_cacheSweepAt = std::max (limit, cache.size () + cache.size () / 2);
+      publishCacheStats ();
+    }
+
+    void publishCacheStats ()
+    {
+      Stats::uset ("ZContext.cache.hits",
+                   Stats::get ("ZContext.cache.hits") +
+                   (m_cacheStats.hits - m_cachePublished.hits));
+      Stats::uset ("ZContext.cache.misses",
+                   Stats::get ("ZContext.cache.misses") +
+                   (m_cacheStats.misses - m_cachePublished.misses));
+      Stats::uset ("ZContext.cache.evictions",
+                   Stats::get ("ZContext.cache.evictions") +
+                   (m_cacheStats.evictions - m_cachePublished.evictions));
+      unsigned bytes = m_cachePeak * cacheEntryBytes ();
+      if (bytes > Stats::get ("ZContext.cache.peak_bytes"))
+        Stats::uset ("ZContext.cache.peak_bytes", bytes);
+      m_cachePublished = m_cacheStats;
+    }
+
   protected:
     z3::context &get_ctx () { return ctx; }
 
     z3::ast toAst (Expr e)
     {
-      expr_ast_map seen;
-      return M::marshal (e, get_ctx (), cache.left, seen);
+      expr_cache_view view (cache, cache.left, m_cacheStats, m_names);
+      z3::ast res (M::marshal (e, get_ctx (), view, m_toAstSeen));
+      clearScratch (m_toAstSeen);
+      shrinkCache ();
+      return res;
     }
     Expr toExpr (z3::ast a)
     {
       if (!a) return Expr();
 
-      ast_expr_map seen;
-      return U::unmarshal (a, get_efac (), cache.right, seen);
+      ast_cache_view view (cache, cache.right, m_cacheStats, m_names);
+      Expr res (U::unmarshal (a, get_efac (), view, m_toExprSeen));
+      clearScratch (m_toExprSeen);
+      shrinkCache ();
+      return res;
+    }
+
+    /// -- converts a range of Expr in one pass. Sub-expressions shared
+    /// -- between elements are converted once
+    template <typename Range, typename OutputIterator>
+    void toAst (const Range &rng, OutputIterator out)
+    {
+      expr_cache_view view (cache, cache.left, m_cacheStats, m_names);
+      for (const Expr &e : rng)
+	*(out++) = M::marshal (e, get_ctx (), view, m_toAstSeen);
+      clearScratch (m_toAstSeen);
+      shrinkCache ();
+    }
+
+    /// -- converts a range of z3::ast in one pass
+    template <typename Range, typename OutputIterator>
+    void toExpr (const Range &rng, OutputIterator out)
+    {
+      ast_cache_view view (cache, cache.right, m_cacheStats, m_names);
+      for (const z3::ast &a : rng)
+	*(out++) = a ? U::unmarshal (a, get_efac (), view,
+				     m_toExprSeen) : Expr ();
+      clearScratch (m_toExprSeen);
+      shrinkCache ();
     }
 
     ExprFactory &get_efac () { return efac; }
@@ -284,14 +529,44 @@ namespace ufo
 
   public:
 
-    ZContext (ExprFactory &ef) : efac(ef) { init (); }
-    ZContext (ExprFactory &ef, z3::config &c) : efac (ef), ctx(c) { init (); }
+    /// -- default memory budget of the Expr <-> ast cache. Eviction is
+    /// -- opt-in, see setCacheBudget. SeaHorn sets the budget of its
+    /// -- contexts with --zctx-cache-budget
+    static const size_t DEFAULT_CACHE_BUDGET = 0;
 
-    ~ZContext () { cache.clear (); }
+    ZContext (ExprFactory &ef) :
+      efac(ef), m_cacheBudget (DEFAULT_CACHE_BUDGET), m_cachePeak (0)
+    { init (); }
+    ZContext (ExprFactory &ef, z3::config &c) :
+      efac (ef), ctx(c), m_cacheBudget (DEFAULT_CACHE_BUDGET), m_cachePeak (0)
+    { init (); }
+
+    ~ZContext ()
+    {
+      publishCacheStats ();
+      m_toAstSeen.clear ();
+      m_toExprSeen.clear ();
+      cache.clear ();
+      m_names.decls.clear ();
+      m_names.vars.clear ();
+    }
 
     template <typename V>
     void set (char const *p, V v) { ctx.set (p, v); }
 
+    /// -- sets the memory budget of the Expr <-> ast cache in bytes.
+    /// -- 0 disables eviction
+    void setCacheBudget (size_t bytes)
+    {
+      m_cacheBudget = bytes;
+      m_cacheSweepAt = bytes / cacheEntryBytes ();
+      shrinkCache ();
+    }
+    size_t getCacheBudget () const { return m_cacheBudget; }
+
+    size_t cacheSize () const { return cache.size (); }
+    const ZCacheStats &cacheStats () const { return m_cacheStats; }
+
     std::string toSmtLib (Expr e)
     { return boost::lexical_cast<std::string> (this->toAst (e)); }
 
@@ -429,6 +704,46 @@ namespace ufo
       return mk<NONDET> (efac);
     }
 
+    /// Evaluates every Expr in rng and writes the values to out, in
+    /// order. The terms and the values are converted in one pass each
+    /// so that sub-terms shared between them are converted once
+    template <typename Range, typename OutputIterator>
+    void eval (const Range &rng, OutputIterator out, bool completion = false)
+    {
+      assert (model);
+      std::vector<z3::ast> asts;
+      z3.toAst (rng, std::back_inserter (asts));
+
+      // -- vals[i] is null when the value of asts[i] is not converted
+      // -- by z3.toExpr but is given by other[i]
+      std::vector<z3::ast> vals (asts.size (), z3::ast (ctx));
+      ExprVector other (asts.size ());
+      for (size_t i = 0, sz = asts.size (); i < sz; ++i)
+      {
+        Z3_ast raw_val = NULL;
+        if (Z3_model_eval (ctx, model, asts [i], completion, &raw_val) && raw_val)
+        {
+          z3::ast val (ctx, raw_val);
+          ctx.check_error ();
+          if (!isAsArray (val)) { vals [i] = val; continue; }
+
+          Z3_func_decl fdecl = Z3_get_as_array_func_decl (ctx, val);
+          z3::func_interp zfunc (ctx, Z3_model_get_func_interp (ctx, model, fdecl));
+          ctx.check_error ();
+          other [i] = finterpToExpr (zfunc);
+          continue;
+        }
+        ctx.check_error ();
+        other [i] = mk<NONDET> (efac);
+      }
+
+      ExprVector res;
+      res.reserve (vals.size ());
+      z3.toExpr (vals, std::back_inserter (res));
+      for (size_t i = 0, sz = res.size (); i < sz; ++i)
+        *(out++) = other [i] ? other [i] : res [i];
+    }
+
     ExprFactory &getExprFactory () { return z3.getExprFactory (); }
     Expr operator() (Expr e) { return eval (e); }
 
@@ -544,6 +859,17 @@ namespace ufo
       ctx.check_error ();
     }
 
+    /// Asserts every Expr in rng. The range is converted in one pass
+    /// so sub-expressions shared between its elements are converted once
+    template <typename Range>
+    void assertExprs (const Range &rng)
+    {
+      std::vector<z3::ast> asts;
+      z3.toAst (rng, std::back_inserter (asts));
+      for (const z3::ast &a : asts) Z3_solver_assert (ctx, solver, a);
+      ctx.check_error ();
+    }
+
     /// return assertions currently in the solver
     template <typename OutputIterator>
     void assertions (OutputIterator out) const
@@ -36,6 +36,18 @@ namespace ufo
   };
 
 
+  /**
+   * Converts Expr to z3::ast without recursion.
+   *
+   * marshal () walks the DAG with an explicit stack. shape () classifies
+   * an expression once, kids () lists the sub-expressions that are
+   * converted before it, and build () converts it from the asts of its
+   * kids. Converted expressions are kept in the cache (constants,
+   * sorts, declarations) or in seen (everything else). Since seen is
+   * shared by all expressions converted with it, a caller that converts
+   * many expressions with one seen converts every shared sub-expression
+   * once.
+   */
   template <typename M>
   struct BasicExprMarshal
   {
@@ -44,48 +56,184 @@ namespace ufo
 			    C &cache, expr_ast_map &seen)
     {
       assert (e);
-      if (isOpX<TRUE>(e)) return z3::ast (ctx, Z3_mk_true (ctx));
-      if (isOpX<FALSE>(e)) return z3::ast (ctx, Z3_mk_false (ctx));
+      // -- pending expressions. The kids of a frame are on the stack
+      // -- above it once numKids is set
+      std::vector<Frame> stack;
+      // -- asts of converted kids. Pinned by the cache or by seen
+      std::vector<Z3_ast> done;
+      ExprVector ks;
+
+      stack.push_back (Frame (e));
+      while (!stack.empty ())
+      {
+        Frame &top = stack.back ();
+        if (top.numKids < 0)
+        {
+          if (Z3_ast res = lookup (top.e, cache, seen))
+          {
+            done.push_back (res);
+            stack.pop_back ();
+            continue;
+          }
+
+          top.shape = shape (top.e);
+          ks.clear ();
+          kids (top.e, top.shape, ks);
+          top.numKids = ks.size ();
+          if (!ks.empty ())
+          {
+            for (ExprVector::reverse_iterator it = ks.rbegin (),
+                   end = ks.rend (); it != end; ++it)
+              stack.push_back (Frame (*it));
+            continue;
+          }
+        }
+
+        Frame f = top;
+        stack.pop_back ();
+        Z3_ast res = build (f.e, f.shape, done.data () + done.size () - f.numKids,
+                            ctx, cache, seen);
+        done.resize (done.size () - f.numKids);
+        done.push_back (res);
+      }
 
-      /** check the cache */
+      assert (done.size () == 1);
+      return z3::ast (ctx, done.back ());
+    }
+
+  private:
+    enum Shape { LEAF, BVAR, ARRAY_SORT, FDECL, FAPP, QUANTIFIER, OPERATOR };
+
+    struct Frame
+    {
+      Expr e;
+      int numKids;
+      Shape shape;
+      Frame (Expr x) : e (x), numKids (-1), shape (LEAF) {}
+    };
+
+    template <typename C>
+    static Z3_ast lookup (const Expr &e, C &cache, expr_ast_map &seen)
+    {
       {
 	typename C::const_iterator it = cache.find (e);
 	if (it != cache.end ()) return it->second;
       }
-
-      /** check computed table */
       {
 	typename expr_ast_map::const_iterator it = seen.find (e);
 	if (it != seen.end ()) return it->second;
       }
+      return NULL;
+    }
+
+    static Shape shape (const Expr &e)
+    {
+      if (isOpX<TRUE> (e) || isOpX<FALSE> (e)) return LEAF;
+      if (bind::isBVar (e)) return BVAR;
+      if (isOpX<INT_TY> (e) || isOpX<REAL_TY> (e) || isOpX<BOOL_TY> (e))
+        return LEAF;
+      if (isOpX<ARRAY_TY> (e)) return ARRAY_SORT;
+      if (isOpX<BVSORT> (e) || isOpX<INT> (e) || isOpX<MPQ> (e) ||
+          isOpX<INT64> (e) || isOpX<MPZ> (e) || bv::is_bvnum (e) ||
+          bind::isBoolVar (e) || bind::isIntVar (e) || bind::isRealVar (e))
+        return LEAF;
+      if (bind::isFdecl (e)) return FDECL;
+      if (bind::isFapp (e)) return FAPP;
+      if (isOpX<FORALL> (e) || isOpX<EXISTS> (e)) return QUANTIFIER;
+      return OPERATOR;
+    }
+
+    static bool isNaryOp (const Expr &e)
+    {
+      return isOpX<AND> (e) || isOpX<OR> (e) ||
+        isOpX<ITE> (e) || isOpX<XOR> (e) ||
+        isOpX<PLUS> (e) || isOpX<MINUS> (e) ||
+        isOpX<MULT> (e) ||
+        isOpX<STORE> (e) || isOpX<ARRAY_MAP> (e);
+    }
+
+    /// -- the kids of e in the order in which build () expects them
+    static void kids (const Expr &e, Shape s, ExprVector &out)
+    {
+      switch (s)
+      {
+      case LEAF:
+        return;
+      case BVAR:
+        out.push_back (bind::type (e));
+        return;
+      case ARRAY_SORT:
+        out.push_back (e->left ());
+        out.push_back (e->right ());
+        return;
+      case FDECL:
+        for (size_t i = 0; i < bind::domainSz (e); ++i)
+          out.push_back (bind::domainTy (e, i));
+        out.push_back (bind::rangeTy (e));
+        return;
+      // -- the fdecl followed by the arguments
+      case FAPP:
+        out.insert (out.end (), e->args_begin (), e->args_end ());
+        return;
+      case QUANTIFIER:
+        for (unsigned i = 0; i < bind::numBound (e); ++i)
+          out.push_back (bind::decl (e, i));
+        out.push_back (bind::body (e));
+        return;
+      case OPERATOR:
+        break;
+      }
+
+      if (e->arity () == 1)
+      {
+        if (isOpX<UN_MINUS> (e) || isOpX<NEG> (e) ||
+            isOpX<ARRAY_DEFAULT> (e) || isOpX<BNOT> (e) ||
+            isOpX<BNEG> (e) || isOpX<BREDAND> (e) || isOpX<BREDOR> (e))
+          out.push_back (e->left ());
+      }
+      // -- an unknown binary operator is given to M with its kids
+      // -- converted
+      else if (e->arity () == 2)
+      {
+        out.push_back (e->left ());
+        out.push_back (e->right ());
+      }
+      else if (isOpX<BEXTRACT> (e))
+        out.push_back (bv::earg (e));
+      else if (isNaryOp (e))
+        out.insert (out.end (), e->args_begin (), e->args_end ());
+    }
 
+    /// -- converts e given the asts of its kids
+    template <typename C>
+    static Z3_ast build (const Expr &e, Shape s, const Z3_ast *args,
+                         z3::context &ctx, C &cache, expr_ast_map &seen)
+    {
       Z3_ast res = NULL;
 
+      if (s == OPERATOR) return buildOp (e, args, ctx, cache, seen);
 
-      if (bind::isBVar (e))
-	{
-	  z3::ast sort (marshal (bind::type (e), ctx, cache, seen));
-	  res = Z3_mk_bound (ctx, bind::bvarId (e),
-			     reinterpret_cast<Z3_sort>
-			     (static_cast<Z3_ast> (sort)));
-	}
+      if (isOpX<TRUE>(e) || isOpX<FALSE>(e))
+      {
+        z3::ast ast (ctx, isOpX<TRUE> (e) ? Z3_mk_true (ctx) :
+                     Z3_mk_false (ctx));
+        seen.insert (expr_ast_map::value_type (e, ast));
+        return ast;
+      }
+
+      if (s == BVAR)
+	res = Z3_mk_bound (ctx, bind::bvarId (e),
+                           reinterpret_cast<Z3_sort> (args [0]));
       else if (isOpX<INT_TY> (e))
 	res = reinterpret_cast<Z3_ast> (Z3_mk_int_sort (ctx));
       else if (isOpX<REAL_TY> (e))
 	res = reinterpret_cast<Z3_ast> (Z3_mk_real_sort (ctx));
       else if (isOpX<BOOL_TY> (e))
 	res = reinterpret_cast<Z3_ast> (Z3_mk_bool_sort (ctx));
-      else if (isOpX<ARRAY_TY> (e))
-      {
-        z3::ast _idx_sort (marshal (e->left (), ctx, cache, seen));
-        z3::ast _val_sort (marshal (e->right (), ctx, cache, seen));
-        Z3_sort idx_sort = reinterpret_cast<Z3_sort> 
-          (static_cast<Z3_ast> (_idx_sort));
-        Z3_sort val_sort = reinterpret_cast<Z3_sort> 
-          (static_cast<Z3_ast> (_val_sort));
+      else if (s == ARRAY_SORT)
         res = reinterpret_cast<Z3_ast> 
-          (Z3_mk_array_sort (ctx, idx_sort, val_sort));       
-      }
+          (Z3_mk_array_sort (ctx, reinterpret_cast<Z3_sort> (args [0]),
+                             reinterpret_cast<Z3_sort> (args [1])));
       else if (isOpX<BVSORT> (e))
         res = reinterpret_cast<Z3_ast> (Z3_mk_bv_sort (ctx, bv::width (e)));
       
@@ -105,6 +253,8 @@ namespace ufo
 	  std::string sname = boost::lexical_cast<std::string>(op.get());
 	  res = Z3_mk_numeral (ctx, sname.c_str (), sort);
 	}
+      else if (isOpX<INT64>(e))
+	res = Z3_mk_int64 (ctx, getTerm<int64_t> (e), Z3_mk_int_sort (ctx));
       else if (isOpX<MPZ>(e))
 	{
 	  const MPZ& op = dynamic_cast<const MPZ&>(e->op ());
@@ -115,10 +265,13 @@ namespace ufo
       else if (bv::is_bvnum (e))
       {
         z3::sort sort (ctx, Z3_mk_bv_sort (ctx, bv::width (e->arg (1))));
-        const MPZ& num = dynamic_cast<const MPZ&> (e->arg (0)->op ());
-        
-        std::string val = boost::lexical_cast<std::string> (num.get ());
-        res = Z3_mk_numeral (ctx, val.c_str (), sort);
+        if (isOpX<INT64> (e->arg (0)))
+          res = Z3_mk_int64 (ctx, getTerm<int64_t> (e->arg (0)), sort);
+        else
+        {
+          std::string val = boost::lexical_cast<std::string> (bv::toMpz (e));
+          res = Z3_mk_numeral (ctx, val.c_str (), sort);
+        }
       }
       else if (bind::isBoolVar (e))
 	{
@@ -165,25 +318,12 @@ namespace ufo
 	}
 
       /** function declaration */
-      else if (bind::isFdecl (e))
+      else if (s == FDECL)
 	{
-	  z3::ast_vector pinned (ctx);
-	  pinned.resize (e->arity ());
-	  std::vector<Z3_sort> domain (e->arity ());
-
-	  for (size_t i = 0; i < bind::domainSz (e); ++i)
-	    {
-	      z3::ast a (marshal (bind::domainTy (e, i), ctx, cache, seen));
-	      pinned.push_back (a);
-	      domain [i] = reinterpret_cast<Z3_sort> (static_cast<Z3_ast>(a));
-	    }
-
-
-	  z3::sort range (ctx,
-			  reinterpret_cast<Z3_sort>
-			  (static_cast<Z3_ast>
-			   (marshal (bind::rangeTy (e), ctx, cache, seen))));
-
+          size_t sz = bind::domainSz (e);
+	  std::vector<Z3_sort> domain (sz);
+	  for (size_t i = 0; i < sz; ++i)
+	    domain [i] = reinterpret_cast<Z3_sort> (args [i]);
 
 	  Expr fname = bind::fname (e);
           std::string sname;
@@ -195,46 +335,19 @@ namespace ufo
 
 	  z3::symbol symname = ctx.str_symbol (sname.c_str ());
 
-	  res = reinterpret_cast<Z3_ast> (Z3_mk_func_decl (ctx,
-							   symname,
-							   bind::domainSz (e),
-							   &domain[0], range));
+	  res = reinterpret_cast<Z3_ast>
+            (Z3_mk_func_decl (ctx, symname, sz, domain.data (),
+                              reinterpret_cast<Z3_sort> (args [sz])));
 	}
 
       /** function application */
-      else if (bind::isFapp (e))
-	{
-
-	  z3::func_decl zfdecl (ctx,
-				reinterpret_cast<Z3_func_decl>
-				(static_cast<Z3_ast>
-				 (marshal (bind::fname (e), ctx, cache, seen))));
-
-
-	  // -- marshall all arguments except for the first one
-	  // -- (which is the fdecl)
-	  std::vector<Z3_ast> args (e->arity ());
-	  z3::ast_vector pinned_args (ctx);
-	  pinned_args.resize (e->arity ());
-
-	  unsigned pos = 0;
-	  for (ENode::args_iterator it = ++ (e->args_begin ()),
-		 end = e->args_end (); it != end; ++it)
-	    {
-	      z3::ast a (marshal (*it, ctx, cache, seen));
-	      pinned_args.push_back (a);
-	      args [pos++] = a;
-	    }
-
-
-	  res = Z3_mk_app (ctx, zfdecl, e->arity () - 1, &args [0]);
-	}
+      else if (s == FAPP)
+	res = Z3_mk_app (ctx, reinterpret_cast<Z3_func_decl> (args [0]),
+                         e->arity () - 1, args + 1);
       /** quantifier */
-      else if (isOpX<FORALL> (e) || isOpX<EXISTS> (e))
+      else if (s == QUANTIFIER)
       {
         unsigned num_bound = bind::numBound (e);
-        z3::ast_vector pinned (ctx);
-        pinned.resize (num_bound);
         std::vector<Z3_sort> bound_sorts;
         bound_sorts.reserve (num_bound);
         std::vector<Z3_symbol> bound_names;
@@ -242,81 +355,62 @@ namespace ufo
         
         for (unsigned i = 0; i < num_bound; ++i)
         {
-          z3::ast z (marshal (bind::decl (e, i), ctx, cache, seen));
-          pinned.push_back (z);
-          
-          Z3_func_decl decl = Z3_to_func_decl (ctx, z);
+          Z3_func_decl decl = Z3_to_func_decl (ctx, args [i]);
           bound_sorts.push_back (Z3_get_range (ctx, decl));
           bound_names.push_back (Z3_get_decl_name (ctx, decl));
         }
         
-        
-        z3::ast body (marshal (bind::body (e), ctx, cache, seen));
         res = Z3_mk_quantifier (ctx, isOpX<FORALL> (e), 0, 0, NULL,
-                                num_bound, &bound_sorts[0], &bound_names[0], body);
+                                num_bound, bound_sorts.data (),
+                                bound_names.data (), args [num_bound]);
       }
 
       // -- cache the result for unmarshaling
       if (res)
 	{
-	  z3::ast ast (ctx, res);
-	  cache.insert (typename C::value_type (e, ast));
+          z3::ast ast (ctx, res);
+          // -- another expression may already own the ast in the cache
+	  if (!cache.insert (typename C::value_type (e, ast)).second)
+            seen.insert (expr_ast_map::value_type (e, ast));
 	  return ast;
 	}
 
+      /** other terminal expressions */
+      return fallback (e, ctx, cache, seen);
+    }
+
+    template <typename C>
+    static Z3_ast buildOp (const Expr &e, const Z3_ast *args, z3::context &ctx,
+                           C &cache, expr_ast_map &seen)
+    {
+      Z3_ast res = NULL;
       int arity = e->arity ();
       /** other terminal expressions */
-      if (arity == 0) return M::marshal (e, ctx, cache, seen);
+      if (arity == 0) return fallback (e, ctx, cache, seen);
 
       else if (arity == 1)
       {
-        // -- then it's a NEG or UN_MINUS
         if (isOpX<UN_MINUS>(e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_unary_minus(ctx, arg));
-        }
-
-        if (isOpX<NEG>(e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_not(ctx, arg));
-        }
-        if (isOpX<ARRAY_DEFAULT> (e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_array_default (ctx, arg));
-        }
-        if (isOpX<BNOT>(e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_bvnot(ctx, arg));
-        }
-        if (isOpX<BNEG>(e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_bvneg(ctx, arg));
-        }
-        if (isOpX<BREDAND>(e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_bvredand(ctx, arg));
-        }
-        if (isOpX<BREDOR>(e))
-        {
-          z3::ast arg = marshal (e->left(), ctx, cache, seen);
-          return z3::ast (ctx, Z3_mk_bvredor(ctx, arg));
-        }
-
-        return M::marshal (e, ctx, cache, seen);
+          res = Z3_mk_unary_minus (ctx, args [0]);
+        else if (isOpX<NEG>(e))
+          res = Z3_mk_not (ctx, args [0]);
+        else if (isOpX<ARRAY_DEFAULT> (e))
+          res = Z3_mk_array_default (ctx, args [0]);
+        else if (isOpX<BNOT>(e))
+          res = Z3_mk_bvnot (ctx, args [0]);
+        else if (isOpX<BNEG>(e))
+          res = Z3_mk_bvneg (ctx, args [0]);
+        else if (isOpX<BREDAND>(e))
+          res = Z3_mk_bvredand (ctx, args [0]);
+        else if (isOpX<BREDOR>(e))
+          res = Z3_mk_bvredor (ctx, args [0]);
+        else
+          return fallback (e, ctx, cache, seen);
       }
       else if (arity == 2)
       {
-        z3::ast t1 = marshal(e->left(), ctx, cache, seen);
-        z3::ast t2 = marshal(e->right(), ctx, cache, seen);
-
-        Z3_ast args [2] = {t1, t2};
-
+        Z3_ast t1 = args [0];
+        Z3_ast t2 = args [1];
 
         /** BoolOp */
         if (isOpX<AND>(e))
@@ -364,7 +458,7 @@ namespace ufo
         /** Array Const */
         else if (isOpX<CONST_ARRAY>(e)) 
         {
-          Z3_sort domain = reinterpret_cast<Z3_sort> (static_cast<Z3_ast> (t1));
+          Z3_sort domain = reinterpret_cast<Z3_sort> (t1);
           res = Z3_mk_const_array (ctx, domain, t2);
           assert (res);
         }
@@ -377,16 +471,9 @@ namespace ufo
           assert (t1_sz > 0);
           assert (t1_sz < bv::width (e->arg (1)));
           if (isOpX<BSEXT> (e))
-            res = z3::ast (ctx,
-                           Z3_mk_sign_ext (ctx,
-                                           bv::width (e->arg (1)) - t1_sz,
-                                           t1));
-          else if (isOpX<BZEXT> (e))
-            res = z3::ast (ctx, 
-                           Z3_mk_zero_ext (ctx,
-                                           bv::width (e->arg (1)) - t1_sz,
-                                           t1));
-          else assert (0);
+            res = Z3_mk_sign_ext (ctx, bv::width (e->arg (1)) - t1_sz, t1);
+          else
+            res = Z3_mk_zero_ext (ctx, bv::width (e->arg (1)) - t1_sz, t1);
         }
         else if (isOpX<BAND> (e))
           res = Z3_mk_bvand (ctx, t1, t2);
@@ -442,73 +529,69 @@ namespace ufo
           res = Z3_mk_bvashr (ctx, t1, t2);
       
         else
-          return M::marshal (e, ctx, cache, seen);
+          return fallback (e, ctx, cache, seen);
       }
       else if (isOpX<BEXTRACT> (e))
       {
         assert (bv::high (e) > bv::low (e));
-        z3::ast a (ctx, marshal (bv::earg (e), ctx, cache, seen));
-        res = Z3_mk_extract (ctx, bv::high (e), bv::low (e), a);
+        res = Z3_mk_extract (ctx, bv::high (e), bv::low (e), args [0]);
       }
-      else if (isOpX<AND> (e) || isOpX<OR> (e) ||
-               isOpX<ITE> (e) || isOpX<XOR> (e) ||
-               isOpX<PLUS> (e) || isOpX<MINUS> (e) ||
-               isOpX<MULT> (e) ||
-               isOpX<STORE> (e) || isOpX<ARRAY_MAP> (e))
+      else if (isNaryOp (e))
       {
-        std::vector<z3::ast> pinned;
-        std::vector<Z3_ast> args;
-
-        for (ENode::args_iterator it = e->args_begin(), end = e->args_end();
-             it != end; ++it)
-        {
-          z3::ast a = z3::ast (ctx, marshal (*it, ctx, cache, seen));
-          args.push_back (a);
-          pinned.push_back (a);
-        }
-
-
+        unsigned sz = e->arity ();
         if (isOp<ITE>(e))
         {
-          assert (e->arity () == 3);
+          assert (sz == 3);
           res = Z3_mk_ite(ctx,args[0],args[1],args[2]);
         }
         else if (isOp<AND>(e))
-          res = Z3_mk_and (ctx, args.size (), &args[0]);
+          res = Z3_mk_and (ctx, sz, args);
         else if (isOp<OR>(e))
-          res = Z3_mk_or (ctx, args.size (), &args[0]);
+          res = Z3_mk_or (ctx, sz, args);
         else if (isOp<PLUS>(e))
-          res = Z3_mk_add (ctx, args.size (), &args[0]);
+          res = Z3_mk_add (ctx, sz, args);
         else if (isOp<MINUS>(e))
-          res = Z3_mk_sub (ctx, args.size (), &args[0]);
+          res = Z3_mk_sub (ctx, sz, args);
         else if (isOp<MULT>(e))
-          res = Z3_mk_mul (ctx, args.size (), &args[0]);
+          res = Z3_mk_mul (ctx, sz, args);
         else if (isOp<STORE>(e))
         {
-          assert (e->arity () == 3);
+          assert (sz == 3);
           res = Z3_mk_store (ctx, args[0], args[1], args[2]);
         }
         else if (isOp<ARRAY_MAP> (e))
         {
           Z3_func_decl fdecl = reinterpret_cast<Z3_func_decl> (args[0]);
-          res = Z3_mk_map (ctx, fdecl, e->arity ()-1, &args[1]);
+          res = Z3_mk_map (ctx, fdecl, sz - 1, args + 1);
         }
       }
       else
-        return M::marshal (e, ctx, cache, seen);
+        return fallback (e, ctx, cache, seen);
 
       if (res == nullptr) ctx.check_error ();
       if (res == nullptr) errs () << "Failed to marshal: " << *e << "\n";
       
       assert (res != NULL);
-      z3::ast final (ctx, res);
-      seen.insert (expr_ast_map::value_type (e, final));
-
-      return final;
+      z3::ast ast (ctx, res);
+      seen.insert (expr_ast_map::value_type (e, ast));
+      return ast;
+    }
 
+    /// -- result of the extension marshaler
+    template <typename C>
+    static Z3_ast fallback (Expr e, z3::context &ctx,
+                            C &cache, expr_ast_map &seen)
+    {
+      z3::ast res (M::marshal (e, ctx, cache, seen));
+      return seen.insert (expr_ast_map::value_type (e, res)).first->second;
     }
   };
 
+  /**
+   * Converts z3::ast to Expr without recursion. Works like
+   * BasicExprMarshal: kids () lists the asts that are converted before
+   * an ast and build () converts it from the Exprs of its kids.
+   */
   template <typename U>
   struct BasicExprUnmarshal
   {
@@ -518,6 +601,176 @@ namespace ufo
 			   ast_expr_map &seen)
     {
       z3::context &ctx = z.ctx ();
+      // -- pending asts with the number of their kids, or -1 if the
+      // -- kids are not on the stack yet. An ast is kept alive by its
+      // -- parent, except for the bound variables of a quantifier
+      std::vector<std::pair<Z3_ast,int> > stack;
+      std::vector<z3::ast> pinned;
+      // -- Exprs of converted kids
+      ExprVector done;
+      std::vector<Z3_ast> ks;
+
+      stack.push_back (std::make_pair (static_cast<Z3_ast> (z), -1));
+      while (!stack.empty ())
+      {
+        Z3_ast top = stack.back ().first;
+        int numKids = stack.back ().second;
+
+        if (numKids < 0)
+        {
+          if (Expr res = lookup (z3::ast (ctx, top), cache, seen))
+          {
+            done.push_back (res);
+            stack.pop_back ();
+            continue;
+          }
+
+          ks.clear ();
+          kids (ctx, top, ks, pinned);
+          if (!ks.empty ())
+          {
+            stack.back ().second = ks.size ();
+            for (std::vector<Z3_ast>::reverse_iterator it = ks.rbegin (),
+                   end = ks.rend (); it != end; ++it)
+              stack.push_back (std::make_pair (*it, -1));
+            continue;
+          }
+          numKids = 0;
+        }
+
+        stack.pop_back ();
+        Expr res = build (z3::ast (ctx, top),
+                          done.data () + done.size () - numKids,
+                          efac, cache, seen);
+        done.resize (done.size () - numKids);
+        done.push_back (res);
+      }
+
+      assert (done.size () == 1);
+      return done.back ();
+    }
+
+  private:
+    template <typename C>
+    static Expr lookup (const z3::ast &z, C &cache, ast_expr_map &seen)
+    {
+      {
+	typename ast_expr_map::const_iterator it = seen.find (z);
+	if (it != seen.end ()) return it->second;
+      }
+      // -- only applications and declarations are shared with the
+      // -- marshaler. Numerals and sorts have several Expr forms
+      Z3_ast_kind kind = z.kind ();
+      if (kind == Z3_APP_AST || kind == Z3_FUNC_DECL_AST)
+      {
+	typename C::const_iterator it = cache.find (z);
+	if (it != cache.end ()) return it->second;
+      }
+      if (kind == Z3_APP_AST && cache.hasEvictedVars ())
+        return evictedVar (z, cache);
+      return Expr ();
+    }
+
+    /// -- the variable of z if z is a constant whose entry was evicted
+    /// -- from the cache
+    template <typename C>
+    static Expr evictedVar (const z3::ast &z, C &cache)
+    {
+      z3::context &ctx = z.ctx ();
+      Z3_app app = Z3_to_app (ctx, z);
+      if (Z3_get_app_num_args (ctx, app) > 0) return Expr ();
+      Z3_func_decl fdecl = Z3_get_app_decl (ctx, app);
+      if (Z3_get_decl_kind (ctx, fdecl) != Z3_OP_UNINTERPRETED) return Expr ();
+      return cache.evictedVar (Z3_get_decl_name (ctx, fdecl));
+    }
+
+    /// -- the kids of z in the order in which build () expects them
+    static void kids (z3::context &ctx, Z3_ast z, std::vector<Z3_ast> &out,
+                      std::vector<z3::ast> &pinned)
+    {
+      if (Z3_get_bool_value (ctx, z) != Z3_L_UNDEF) return;
+
+      switch (Z3_get_ast_kind (ctx, z))
+      {
+      case Z3_SORT_AST:
+        {
+          Z3_sort sort = reinterpret_cast<Z3_sort> (z);
+          if (Z3_get_sort_kind (ctx, sort) != Z3_ARRAY_SORT) return;
+          out.push_back (Z3_sort_to_ast
+                         (ctx, Z3_get_array_sort_domain (ctx, sort)));
+          out.push_back (Z3_sort_to_ast
+                         (ctx, Z3_get_array_sort_range (ctx, sort)));
+        }
+        return;
+      case Z3_VAR_AST:
+        out.push_back (Z3_sort_to_ast (ctx, Z3_get_sort (ctx, z)));
+        return;
+      case Z3_FUNC_DECL_AST:
+        {
+          Z3_func_decl fdecl = Z3_to_func_decl (ctx, z);
+          for (unsigned p = 0, sz = Z3_get_domain_size (ctx, fdecl); p < sz; ++p)
+            out.push_back (Z3_sort_to_ast (ctx, Z3_get_domain (ctx, fdecl, p)));
+          out.push_back (Z3_sort_to_ast (ctx, Z3_get_range (ctx, fdecl)));
+        }
+        return;
+      case Z3_QUANTIFIER_AST:
+        for (unsigned i = 0, sz = Z3_get_quantifier_num_bound (ctx, z);
+             i < sz; ++i)
+        {
+          Z3_func_decl decl =
+            Z3_mk_func_decl (ctx, Z3_get_quantifier_bound_name (ctx, z, i),
+                             0, nullptr,
+                             Z3_get_quantifier_bound_sort (ctx, z, i));
+          pinned.push_back (z3::ast (ctx, Z3_func_decl_to_ast (ctx, decl)));
+          out.push_back (pinned.back ());
+        }
+        out.push_back (Z3_get_quantifier_body (ctx, z));
+        return;
+      case Z3_APP_AST:
+        {
+          Z3_app app = Z3_to_app (ctx, z);
+          Z3_func_decl fdecl = Z3_get_app_decl (ctx, app);
+          Z3_decl_kind dkind = Z3_get_decl_kind (ctx, fdecl);
+
+          if (dkind == Z3_OP_AS_ARRAY)
+          {
+            out.push_back (Z3_func_decl_to_ast
+                           (ctx, Z3_get_as_array_func_decl (ctx, z)));
+            return;
+          }
+          // -- the fdecl followed by the arguments
+          if (dkind == Z3_OP_UNINTERPRETED)
+            out.push_back (Z3_func_decl_to_ast (ctx, fdecl));
+          for (unsigned i = 0, sz = Z3_get_app_num_args (ctx, app); i < sz; ++i)
+            out.push_back (Z3_get_app_arg (ctx, app, i));
+          // -- the arguments followed by the domain
+          if (dkind == Z3_OP_CONST_ARRAY)
+            out.push_back (Z3_sort_to_ast
+                           (ctx, Z3_get_array_sort_domain
+                            (ctx, Z3_get_sort (ctx, z))));
+        }
+        return;
+      default:
+        return;
+      }
+    }
+
+    /// -- converts z given the Exprs of its kids
+    template <typename C>
+    static Expr build (const z3::ast &z, const Expr *args, ExprFactory &efac,
+                       C &cache, ast_expr_map &seen)
+    {
+      Expr e = convert (z, args, efac, cache, seen);
+      assert (e);
+      seen.insert (ast_expr_map::value_type (z, e));
+      return e;
+    }
+
+    template <typename C>
+    static Expr convert (const z3::ast &z, const Expr *args, ExprFactory &efac,
+                         C &cache, ast_expr_map &seen)
+    {
+      z3::context &ctx = z.ctx ();
 
       Z3_lbool bVal = Z3_get_bool_value (ctx, z);
       if (bVal == Z3_L_TRUE) return mk<TRUE> (efac);
@@ -531,8 +784,21 @@ namespace ufo
 	{
           
           Z3_sort sort = Z3_get_sort (ctx, z);
+          Z3_sort_kind skind = Z3_get_sort_kind (ctx, sort);
+          
+          // -- numerals that fit in 64 bits do not go through strings
+          int64_t small;
+          if (skind != Z3_REAL_SORT && Z3_get_numeral_int64 (ctx, z, &small))
+          {
+            Expr num = mkTerm<int64_t> (small, efac);
+            if (skind == Z3_INT_SORT) return num;
+            if (skind == Z3_BV_SORT)
+              return bv::bvnum (num, bv::bvsort (Z3_get_bv_sort_size (ctx, sort),
+                                                 efac));
+          }
+          
 	  std::string snum = Z3_get_numeral_string (ctx, z);
-          switch (Z3_get_sort_kind (ctx, sort))
+          switch (skind)
           {
           case Z3_REAL_SORT:
             return mkTerm (mpq_class (snum), efac);
@@ -543,12 +809,12 @@ namespace ufo
                               Z3_get_bv_sort_size (ctx, sort), efac);
           default:
             assert (0 && "Unsupported numeric constant");
+            return Expr ();
           }
 	}
       else if (kind == Z3_SORT_AST)
 	{
 	  Z3_sort sort = reinterpret_cast<Z3_sort> (static_cast<Z3_ast> (z));
-          Expr domain, range;
           
 	  switch (Z3_get_sort_kind (ctx, sort))
 	    {
@@ -561,87 +827,38 @@ namespace ufo
             case Z3_BV_SORT:
               return bv::bvsort (Z3_get_bv_sort_size (ctx, sort), efac);
             case Z3_ARRAY_SORT:
-              domain = 
-                unmarshal (z3::ast (ctx, 
-                                    Z3_sort_to_ast 
-                                    (ctx, Z3_get_array_sort_domain (ctx, sort))),
-                           efac, cache, seen);
-              range = 
-                unmarshal (z3::ast (ctx, 
-                                    Z3_sort_to_ast 
-                                    (ctx, Z3_get_array_sort_range (ctx, sort))),
-                           efac, cache, seen);
-              return sort::arrayTy (domain, range);
+              return sort::arrayTy (args [0], args [1]);
 	    default:
 	      assert (0 && "Unsupported sort");
+              return Expr ();
 	    }
 	}
       else if (kind == Z3_VAR_AST)
-	{
-	  unsigned idx = Z3_get_index_value (ctx, z);
-          z3::ast zsort (ctx, Z3_sort_to_ast (ctx, Z3_get_sort (ctx, z)));
-          Expr sort = unmarshal (zsort, efac, cache, seen);
-          return bind::bvar (idx, sort);
-	}
+        return bind::bvar (Z3_get_index_value (ctx, z), args [0]);
 
       else if (kind == Z3_FUNC_DECL_AST)
 	{
-            {
-                typename C::const_iterator it = cache.find (z);
-                if (it != cache.end ()) return it->second;
-            }
 	  Z3_func_decl fdecl = Z3_to_func_decl (ctx, z);
-
 	  Z3_symbol symname = Z3_get_decl_name (ctx, fdecl);
           
-          Expr name;
-          switch (Z3_get_symbol_kind (ctx, symname))
-          {
-          case Z3_STRING_SYMBOL:
+          // -- a name that is not a string if the declaration was
+          // -- evicted from the cache
+          Expr name = cache.evictedName (symname);
+          if (!name && Z3_get_symbol_kind (ctx, symname) == Z3_STRING_SYMBOL)
             name = mkTerm<std::string> (Z3_get_symbol_string (ctx, symname), efac);
-            break;
-          case Z3_INT_SYMBOL:
+          else if (!name)
             name = mkTerm<mpz_class> (Z3_get_symbol_int (ctx, symname), efac);
-            break;
-          }
           assert (name);
 
-	  ExprVector type;
-	  for (unsigned p = 0; p < Z3_get_domain_size (ctx, fdecl); ++p)
-	    {
-	      Z3_sort sort = Z3_get_domain  (ctx, fdecl, p);
-	      type.push_back
-		(unmarshal (z3::ast (ctx, Z3_sort_to_ast (ctx, sort)),
-			    efac, cache, seen));
-	    }
-
-	  type.push_back
-	    (unmarshal (z3::ast (ctx,
-				 Z3_sort_to_ast (ctx,
-						 Z3_get_range (ctx, fdecl))),
-				     efac, cache, seen));
-
+	  ExprVector type (args, args + Z3_get_domain_size (ctx, fdecl) + 1);
 	  return bind::fdecl (name, type);
 	}
       else if (kind == Z3_QUANTIFIER_AST)
       {
-        ExprVector args;
         unsigned num_bound = Z3_get_quantifier_num_bound (ctx, z);
-        args.reserve (num_bound + 1);
-        for (unsigned i = 0; i < num_bound; ++i)
-        {
-          Z3_func_decl decl = Z3_mk_func_decl (ctx,
-                                               Z3_get_quantifier_bound_name (ctx, z, i),
-                                               0, nullptr,
-                                               Z3_get_quantifier_bound_sort (ctx, z, i));
-          z3::ast zdecl (ctx, Z3_func_decl_to_ast (ctx, decl));
-          args.push_back (unmarshal (zdecl, efac, cache, seen));
-          assert (args.back ().get ());
-        }
-        args.push_back (unmarshal (z3::ast (ctx, Z3_get_quantifier_body (ctx, z)),
-                                   efac, cache, seen));
         return Z3_is_quantifier_forall (ctx, z) ?
-          mknary<FORALL> (args) : mknary<EXISTS> (args);
+          mknary<FORALL> (args, args + num_bound + 1) :
+          mknary<EXISTS> (args, args + num_bound + 1);
       }
       
 
@@ -652,252 +869,208 @@ namespace ufo
       Z3_app app = Z3_to_app (ctx, z);
       Z3_func_decl fdecl = Z3_get_app_decl (ctx, app);
       Z3_decl_kind dkind = Z3_get_decl_kind (ctx, fdecl);
+      unsigned numArgs = Z3_get_app_num_args (ctx, app);
+      const Expr *end = args + numArgs;
 
-      if (dkind == Z3_OP_NOT)
-	{
-	  assert (Z3_get_app_num_args (ctx, app) == 1);
-	  return mk<NEG> (unmarshal
-			  (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-				    efac, cache, seen));
-    	}
-      if (dkind == Z3_OP_UMINUS)
-	return mk<UN_MINUS> (unmarshal
-			     (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-			      efac, cache, seen));
-
-      // XXX ignore to_real and to_int operators
-      if (dkind == Z3_OP_TO_REAL || dkind == Z3_OP_TO_INT)
-        return unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                          efac, cache, seen);
-      
-      if (dkind == Z3_OP_BNOT)
-        return mk<BNOT> (unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                                    efac, cache, seen));
-      if (dkind == Z3_OP_BNEG)
-        return mk<BNEG> (unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                                    efac, cache, seen));
-      if (dkind == Z3_OP_BREDAND)
-        return mk<BREDAND> (unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                                       efac, cache, seen));
-      if (dkind == Z3_OP_BREDOR)
-        return mk<BREDOR> (unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                                      efac, cache, seen));
-      if (dkind == Z3_OP_SIGN_EXT || dkind == Z3_OP_ZERO_EXT)
+      switch (dkind)
       {
-        Expr sort = bv::bvsort (Z3_get_bv_sort_size (ctx, Z3_get_sort (ctx, z)), 
-                                efac);
-        Expr arg = unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                              efac, cache, seen);
-        switch (dkind)
+      case Z3_OP_NOT:
+        assert (numArgs == 1);
+        return mk<NEG> (args [0]);
+      case Z3_OP_UMINUS:
+        return mk<UN_MINUS> (args [0]);
+      // XXX ignore to_real and to_int operators
+      case Z3_OP_TO_REAL:
+      case Z3_OP_TO_INT:
+        return args [0];
+      case Z3_OP_BNOT:
+        return mk<BNOT> (args [0]);
+      case Z3_OP_BNEG:
+        return mk<BNEG> (args [0]);
+      case Z3_OP_BREDAND:
+        return mk<BREDAND> (args [0]);
+      case Z3_OP_BREDOR:
+        return mk<BREDOR> (args [0]);
+      case Z3_OP_SIGN_EXT:
+      case Z3_OP_ZERO_EXT:
         {
-        case Z3_OP_SIGN_EXT:
-          return mk<BSEXT> (arg, sort);
-        case Z3_OP_ZERO_EXT:
-          return mk<BZEXT> (arg, sort);
-        default: assert (0);
+          Expr sort = bv::bvsort (Z3_get_bv_sort_size (ctx, Z3_get_sort (ctx, z)),
+                                  efac);
+          return dkind == Z3_OP_SIGN_EXT ?
+            mk<BSEXT> (args [0], sort) : mk<BZEXT> (args [0], sort);
         }
-      }
-      
-      if (dkind == Z3_OP_EXTRACT)
-      {
-        Expr arg = unmarshal (z3::ast (ctx, Z3_get_app_arg (ctx, app, 0)),
-                              efac, cache, seen);
-
-        Z3_func_decl d = Z3_get_app_decl (ctx, app);
-        unsigned high = Z3_get_decl_int_parameter (ctx, d, 0);
-        unsigned low = Z3_get_decl_int_parameter (ctx, d, 1);
-        return bv::extract (high, low, arg);
-      }
-          
-
-      if (dkind == Z3_OP_AS_ARRAY)
-      {
-        z3::ast zdecl 
-          (ctx, Z3_func_decl_to_ast (ctx, 
-                                     Z3_get_as_array_func_decl (ctx, z)));
-        return mk<AS_ARRAY> (unmarshal (zdecl, efac, cache, seen));
-      }
-
-      {
-	typename C::const_iterator it = cache.find (z);
-	if (it != cache.end ()) return it->second;
-      }
-      {
-	typename ast_expr_map::const_iterator it = seen.find (z);
-	if (it != seen.end ()) return it->second;
-      }
-
-      
-      Expr e;
-      ExprVector args;
-      for (size_t i = 0; i < (size_t)Z3_get_app_num_args (ctx, app); i++)
-	args.push_back (unmarshal
-			(z3::ast(ctx, Z3_get_app_arg(ctx, app, i)), efac, cache, seen));
-
+      case Z3_OP_EXTRACT:
+        {
+          unsigned high = Z3_get_decl_int_parameter (ctx, fdecl, 0);
+          unsigned low = Z3_get_decl_int_parameter (ctx, fdecl, 1);
+          return bv::extract (high, low, args [0]);
+        }
+      case Z3_OP_AS_ARRAY:
+        return mk<AS_ARRAY> (args [0]);
       /** newly introduced Z3 symbol */
-      if (dkind == Z3_OP_UNINTERPRETED)
+      case Z3_OP_UNINTERPRETED:
 	{
-	  Expr res = bind::fapp (unmarshal (z3::func_decl (ctx, fdecl),
-					    efac, cache, seen), args);
+	  Expr res = bind::fapp (args [0], ExprVector (args + 1, end + 1));
 	  // -- XXX maybe use seen instead. not sure what is best.
 	  cache.insert (typename C::value_type (z, res));
 	  return res;
 	}
+      default:
+        break;
+      }
 
+      Expr e;
       switch (dkind)
 	{
 	case Z3_OP_ITE:
-	  e = mknary<ITE> (args.begin (), args.end ());
+	  e = mknary<ITE> (args, end);
 	  break;
 	case Z3_OP_AND:
-	  e = mknary<AND> (args.begin(), args.end());
+	  e = mknary<AND> (args, end);
 	  break;
 	case Z3_OP_OR:
-	  e =  mknary<OR> (args.begin(), args.end());
+	  e =  mknary<OR> (args, end);
 	  break;
 	case Z3_OP_XOR:
-	  e = mknary<XOR> (args.begin(), args.end());
+	  e = mknary<XOR> (args, end);
 	  break;
 	case Z3_OP_IFF:
-	  e =  mknary<IFF> (args.begin(), args.end());
+	  e =  mknary<IFF> (args, end);
 	  break;
 	case Z3_OP_IMPLIES:
-	  e =  mknary<IMPL> (args.begin(), args.end());
+	  e =  mknary<IMPL> (args, end);
 	  break;
 	case Z3_OP_EQ:
-	  e =  mknary<EQ> (args.begin(), args.end());
+	  e =  mknary<EQ> (args, end);
 	  break;
 	case Z3_OP_LT:
-	  e =  mknary<LT> (args.begin(), args.end());
+	  e =  mknary<LT> (args, end);
 	  break;
 	case Z3_OP_GT:
-	  e =  mknary<GT> (args.begin(), args.end());
+	  e =  mknary<GT> (args, end);
 	  break;
 	case Z3_OP_LE:
-	  e =  mknary<LEQ> (args.begin(), args.end());
+	  e =  mknary<LEQ> (args, end);
 	  break;
 	case Z3_OP_GE:
-	  e =  mknary<GEQ> (args.begin(), args.end());
+	  e =  mknary<GEQ> (args, end);
 	  break;
 	case Z3_OP_ADD:
-	  e =  mknary<PLUS> (args.begin(), args.end());
+	  e =  mknary<PLUS> (args, end);
 	  break;
 	case Z3_OP_SUB:
-	  e =  mknary<MINUS> (args.begin(), args.end());
+	  e =  mknary<MINUS> (args, end);
 	  break;
 	case Z3_OP_MUL:
-	  e =  mknary<MULT> (args.begin(), args.end());
+	  e =  mknary<MULT> (args, end);
 	  break;
 	case Z3_OP_DIV:
-	  e = mknary<DIV> (args.begin(), args.end());
+	  e = mknary<DIV> (args, end);
 	  break;
         case Z3_OP_IDIV:
-          e = mknary<IDIV> (args.begin (), args.end ());
+          e = mknary<IDIV> (args, end);
           break;
 	case Z3_OP_MOD:
-	  e = mknary<MOD> (args.begin (), args.end ());
+	  e = mknary<MOD> (args, end);
 	  break;
         case Z3_OP_REM:
-          e = mknary<REM> (args.begin (), args.end ());
+          e = mknary<REM> (args, end);
           break;
         case Z3_OP_CONST_ARRAY:
-          {
-            assert (args.size () == 1);
-            Z3_sort sort = Z3_get_sort (ctx, z);
-            Expr domain = unmarshal
-              (z3::ast (ctx, Z3_sort_to_ast (ctx,
-                                             Z3_get_array_sort_domain (ctx, sort))),
-               efac, cache, seen);
-            
-            e = op::array::constArray (domain, args[0]);
-          }
+          assert (numArgs == 1);
+          e = op::array::constArray (args [1], args [0]);
           break;
         case Z3_OP_STORE:
-          e = mknary<STORE> (args.begin (), args.end ());
+          e = mknary<STORE> (args, end);
           break;
         case Z3_OP_SELECT:
-          e = mknary<SELECT> (args.begin (), args.end ());
+          e = mknary<SELECT> (args, end);
           break;
         case Z3_OP_BADD:
-          e = mknary<BADD> (args.begin (), args.end ());
+          e = mknary<BADD> (args, end);
           break;
         case Z3_OP_BSUB:
-          e = mknary<BSUB> (args.begin (), args.end ());
+          e = mknary<BSUB> (args, end);
           break;
         case Z3_OP_BMUL:
-          e = mknary<BMUL> (args.begin (), args.end ());
+          e = mknary<BMUL> (args, end);
           break;
         case Z3_OP_BSDIV:
-          e = mknary<BSDIV> (args.begin (), args.end ());
+          e = mknary<BSDIV> (args, end);
           break;
         case Z3_OP_BUDIV:
-          e = mknary<BUDIV> (args.begin (), args.end ());
+          e = mknary<BUDIV> (args, end);
           break;
         case Z3_OP_BSREM:
-          e = mknary<BSREM> (args.begin (), args.end ());
+          e = mknary<BSREM> (args, end);
           break;
         case Z3_OP_BUREM:
-          e = mknary<BUREM> (args.begin (), args.end ());
+          e = mknary<BUREM> (args, end);
           break;
         case Z3_OP_BSMOD:
-          e = mknary<BSMOD> (args.begin (), args.end ());
+          e = mknary<BSMOD> (args, end);
           break;
         case Z3_OP_ULEQ:
-          e = mknary<BULE> (args.begin (), args.end ());
+          e = mknary<BULE> (args, end);
           break;
         case Z3_OP_SLEQ:
-          e = mknary<BSLE> (args.begin (), args.end ());
+          e = mknary<BSLE> (args, end);
           break;
         case Z3_OP_UGEQ:
-          e = mknary<BUGE> (args.begin (), args.end ());
+          e = mknary<BUGE> (args, end);
           break;
         case Z3_OP_SGEQ:
-          e = mknary<BSGE> (args.begin (), args.end ());
+          e = mknary<BSGE> (args, end);
           break;
         case Z3_OP_ULT:
-          e = mknary<BULT> (args.begin (), args.end ());
+          e = mknary<BULT> (args, end);
           break;
         case Z3_OP_SLT:
-          e = mknary<BSLT> (args.begin (), args.end ());
+          e = mknary<BSLT> (args, end);
           break;
         case Z3_OP_UGT:
-          e = mknary<BUGT> (args.begin (), args.end ());
+          e = mknary<BUGT> (args, end);
           break;
         case Z3_OP_SGT:          
-          e = mknary<BSGT> (args.begin (), args.end ());
+          e = mknary<BSGT> (args, end);
           break;
         case Z3_OP_BAND:
-          e = mknary<BAND> (args.begin (), args.end ());
+          e = mknary<BAND> (args, end);
           break;
         case Z3_OP_BOR:
-          e = mknary<BOR> (args.begin (), args.end ());
+          e = mknary<BOR> (args, end);
           break;
         case Z3_OP_BXOR:
-          e = mknary<BXOR> (args.begin (), args.end ());
+          e = mknary<BXOR> (args, end);
           break;
         case Z3_OP_BNAND:
-          e = mknary<BNAND> (args.begin (), args.end ());
+          e = mknary<BNAND> (args, end);
           break;
         case Z3_OP_BNOR:
-          e = mknary<BNOR> (args.begin (), args.end ());
+          e = mknary<BNOR> (args, end);
           break;
         case Z3_OP_BXNOR:
-          e = mknary<BXNOR> (args.begin (), args.end ());
+          e = mknary<BXNOR> (args, end);
           break;
         case Z3_OP_BSHL:
-          e = mknary<BSHL> (args.begin (), args.end ());
+          e = mknary<BSHL> (args, end);
           break;
         case Z3_OP_BLSHR:
-          e = mknary<BLSHR> (args.begin (), args.end ());
+          e = mknary<BLSHR> (args, end);
           break;
         case Z3_OP_BASHR:
-          e = mknary<BASHR> (args.begin (), args.end ());
+          e = mknary<BASHR> (args, end);
+          break;
+        case Z3_OP_CONCAT:
+          // -- concat is associative, BCONCAT is binary
+          e = args [0];
+          for (unsigned i = 1; i < numArgs; ++i)
+            e = mk<BCONCAT> (e, args [i]);
           break;
         default:
 	  return U::unmarshal (z, efac, cache, seen);
 	}
 
-      seen [z] = e;
       return e;
     }
 
@@ -1,10 +1,176 @@
 #include "seahorn/Bmc.hh"
 #include "seahorn/UfoSymExec.hh"
 
+#include "ufo/Stats.hh"
+#include "avy/AvyDebug.h"
+
+#include "llvm/Support/CommandLine.h"
+
 #include "boost/container/flat_set.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+static llvm::cl::opt<bool>
+BmcSlice ("bmc-slice",
+          llvm::cl::desc ("Slice the path condition to the cone of influence "
+                          "of its constraints before solving"),
+          llvm::cl::init (true));
+
+static llvm::cl::opt<unsigned>
+CoreTimeout ("bmc-core-timeout",
+             llvm::cl::desc ("Time budget in seconds of unsat core "
+                             "minimization. 0 is unbounded"),
+             llvm::cl::init (0));
+
+static llvm::cl::opt<unsigned>
+CoreMaxCalls ("bmc-core-max-calls",
+              llvm::cl::desc ("Budget of solver calls of unsat core "
+                              "minimization. 0 is unbounded"),
+              llvm::cl::init (0));
+
 namespace seahorn
 {
+  namespace
+  {
+    /// If c is a definition x = e, possibly guarded by an implication,
+    /// and x does not occur in e or in the guard, returns x. Otherwise,
+    /// returns null
+    Expr definedSymbol (Expr c)
+    {
+      Expr guard;
+      if (isOpX<IMPL> (c))
+      {
+        guard = c->arg (0);
+        c = c->arg (1);
+      }
+      if (!isOpX<EQ> (c) && !isOpX<IFF> (c)) return Expr ();
+      
+      Expr x = c->arg (0);
+      if (!bind::IsConst () (x)) return Expr ();
+      if (contains (c->arg (1), x)) return Expr ();
+      if (guard && contains (guard, x)) return Expr ();
+      return x;
+    }
+    
+    /// the value of the definition c of a symbol
+    Expr definedValue (Expr c)
+    { return isOpX<IMPL> (c) ? c->arg (1)->arg (1) : c->arg (1); }
+    
+    /**
+     * Minimizes unsat cores over assumption literals with QuickXplain,
+     * within the time and solver-call budgets given on the command
+     * line. A probe that fails or runs out of budget keeps the probed
+     * literals, so the result is always a core, if not a minimal one.
+     */
+    class CoreMinimizer
+    {
+      ufo::ZSolver<ufo::EZ3> &m_solver;
+      std::chrono::steady_clock::time_point m_deadline;
+      unsigned m_calls;
+      bool m_exhausted;
+      
+      /// milliseconds left in the time budget, UINT_MAX if unbounded
+      unsigned remainingMs ()
+      {
+        if (CoreTimeout == 0) return UINT_MAX;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds> 
+          (m_deadline - std::chrono::steady_clock::now ()).count ();
+        return left > 0 ? std::min<long long> (left, UINT_MAX - 1) : 0;
+      }
+      
+      /// reserves a solver call. False if the budget is exhausted
+      bool reserveCall ()
+      {
+        if (m_exhausted) return false;
+        if ((CoreMaxCalls > 0 && m_calls >= CoreMaxCalls) || remainingMs () == 0)
+        {
+          m_exhausted = true;
+          return false;
+        }
+        ++m_calls;
+        return true;
+      }
+      
+    public:
+      CoreMinimizer (ufo::ZSolver<ufo::EZ3> &solver) :
+        m_solver (solver), m_calls (0), m_exhausted (false)
+      {
+        m_deadline = std::chrono::steady_clock::now () + 
+          std::chrono::seconds (CoreTimeout);
+      }
+      
+      ~CoreMinimizer ()
+      {
+        if (CoreTimeout == 0) return;
+        ufo::ZParams<ufo::EZ3> params (m_solver.getContext ());
+        params.set (":timeout", UINT_MAX);
+        m_solver.set (params);
+      }
+      
+      bool exhausted () const { return m_exhausted; }
+      
+      /// true if the assumptions are unsat. Fills core, if given, with
+      /// the unsat core
+      bool isUnsat (const ExprVector &asms, ExprVector *core = nullptr)
+      {
+        if (!reserveCall ()) return false;
+        
+        if (CoreTimeout > 0)
+        {
+          ufo::ZParams<ufo::EZ3> params (m_solver.getContext ());
+          params.set (":timeout", remainingMs ());
+          m_solver.set (params);
+        }
+        
+        boost::tribool res = asms.empty () ? m_solver.solve () :
+          m_solver.solveAssuming (asms);
+        if (!res && core) m_solver.unsatCore (std::back_inserter (*core));
+        return bool (!res);
+      }
+      
+      /// Appends to out a minimal subset X of [b, e) such that bg + X
+      /// is unsat, where bg + [b, e) is unsat. When delta is set, bg
+      /// alone is checked first
+      void quickXplain (ExprVector &bg, ExprVector::const_iterator b,
+                        ExprVector::const_iterator e, bool delta,
+                        ExprVector &out)
+      {
+        if (b == e) return;
+        if (delta && isUnsat (bg)) return;
+        if (e - b == 1)
+        {
+          out.push_back (*b);
+          return;
+        }
+        
+        auto m = b + (e - b) / 2;
+        size_t bgSz = bg.size ();
+        size_t outSz = out.size ();
+        
+        // -- the part of the core in the second half, assuming the first
+        bg.insert (bg.end (), b, m);
+        quickXplain (bg, m, e, true, out);
+        bg.resize (bgSz);
+        
+        // -- the part of the core in the first half
+        bg.insert (bg.end (), out.begin () + outSz, out.end ());
+        quickXplain (bg, b, m, out.size () > outSz, out);
+        bg.resize (bgSz);
+      }
+      
+      /// publishes the counters of the minimization
+      void publish (size_t coreSz)
+      {
+        ufo::Stats::uset ("BmcEngine.core.calls",
+                          ufo::Stats::get ("BmcEngine.core.calls") + m_calls);
+        ufo::Stats::uset ("BmcEngine.core.size", coreSz);
+        if (m_exhausted) ufo::Stats::count ("BmcEngine.core.budget_exhausted");
+      }
+    };
+  }
+  
   /// computes an implicant of f (interpreted as a conjunction) that
   /// contains the given model
   static void get_model_implicant (const ExprVector &f, 
@@ -25,52 +191,194 @@ namespace seahorn
     m_cps.push_back (&cp);
   }
 
+  void BmcEngine::popCutPoint ()
+  {
+    assert (!m_cps.empty ());
+    m_result = boost::indeterminate;
+    
+    // -- the last cut point is not encoded yet
+    if (m_states.size () < m_cps.size ()) 
+    {
+      m_cps.pop_back ();
+      return;
+    }
+    
+    m_cps.pop_back ();
+    if (m_edges.empty ())
+    {
+      m_states.clear ();
+      return;
+    }
+    
+    m_edges.pop_back ();
+    m_states.pop_back ();
+    m_sideSz.pop_back ();
+    m_side.resize (m_sideSz.empty () ? 0 : m_sideSz.back ());
+    
+    if (m_incremental)
+    {
+      // -- retire the activation literal of the edge
+      m_smt_solver.assertExpr (boolop::lneg (m_acts.back ()));
+      m_acts.pop_back ();
+      
+      // -- forget the definitions of the edge. The cone is not shrunk;
+      // -- a larger cone only asserts more definitions
+      for (auto it = m_sliced.begin (); it != m_sliced.end ();)
+        if (it->second >= m_side.size ()) it = m_sliced.erase (it);
+        else ++it;
+    }
+    else
+      restoreEncoding ();
+  }
+  
   boost::tribool BmcEngine::solve ()
   {
     encode ();
-    m_result =  m_smt_solver.solve ();
+    if (m_acts.empty ()) m_result = m_smt_solver.solve ();
+    else m_result = m_smt_solver.solveAssuming (m_acts);
     return m_result;
   }
 
   void BmcEngine::encode ()
   {
-    
-    // -- only run the encoding once
-    if (!m_side.empty ()) return;
+    // -- only encode the cut points that are not encoded yet
+    if (!m_states.empty () && m_states.size () == m_cps.size ()) return;
     
     assert (m_cpg);
     assert (m_fn);
     UfoLargeSymExec sexec (m_sem);
-    m_states.push_back (SymStore (m_efac));
+    if (m_states.empty ()) m_states.push_back (SymStore (m_efac));
     
-    const CutPoint *prev = nullptr;
-    for (const CutPoint *cp : m_cps)
+    unsigned first = m_edges.size ();
+    for (unsigned i = m_states.size (); i < m_cps.size (); ++i)
     {
-      if (prev)
-      {
-        const CpEdge *edg = m_cpg->getEdge (*prev, *cp);
-        assert (edg);
-        m_edges.push_back (edg);
+      const CpEdge *edg = m_cpg->getEdge (*m_cps [i - 1], *m_cps [i]);
+      assert (edg);
+      m_edges.push_back (edg);
       
-        m_states.push_back (m_states.back ());
-        SymStore &s = m_states.back ();
-        sexec.execCpEdg (s, *edg, m_side);
+      if (i == 1) addCpConstraints (*m_cps [0], m_states [0]);
+      m_states.push_back (m_states.back ());
+      SymStore &s = m_states.back ();
+      sexec.execCpEdg (s, *edg, m_side);
+      addCpConstraints (*m_cps [i], s);
+      m_sideSz.push_back (m_side.size ());
+      
+      if (m_incremental)
+        m_acts.push_back (bind::boolConst 
+                          (mkTerm<std::string> 
+                           ("bmc.act." + std::to_string (m_actCount++), m_efac)));
+    }
+    
+    assertEdges (first, m_edges.size ());
+    
+    ufo::Stats::uset ("BmcEngine.slice.pre", m_side.size ());
+    ufo::Stats::uset ("BmcEngine.slice.post", m_side.size () - m_sliced.size ());
+  }
+  
+  void BmcEngine::addCpConstraints (const CutPoint &cp, SymStore &s)
+  {
+    if (!m_cpConstraints) return;
+    Expr c = m_cpConstraints (cp, s);
+    if (c && !isOpX<TRUE> (c)) m_side.push_back (c);
+  }
+  
+  void BmcEngine::assertEdges (unsigned from, unsigned to)
+  {
+    if (from >= to) return;
+    
+    unsigned begin = from == 0 ? 0 : m_sideSz [from - 1];
+    std::vector<unsigned> live;
+    live.reserve (m_sideSz [to - 1] - begin);
+    for (unsigned i = begin; i < m_sideSz [to - 1]; ++i)
+    {
+      Expr x = BmcSlice ? definedSymbol (m_side [i]) : Expr ();
+      if (x && !m_cone.count (x))
+      {
+        auto it = m_sliced.find (x);
+        if (it == m_sliced.end ())
+        {
+          m_sliced [x] = i;
+          continue;
+        }
+        // -- a symbol with two definitions is never sliced away
+        unsigned j = it->second;
+        m_sliced.erase (it);
+        addToCone (j, live);
       }
-      prev = cp;
+      addToCone (i, live);
+    }
+    
+    if (!m_incremental)
+    {
+      ExprVector side;
+      side.reserve (live.size ());
+      for (unsigned i : live) side.push_back (m_side [i]);
+      m_smt_solver.assertExprs (side);
+      return;
     }
     
-    for (Expr v : m_side) m_smt_solver.assertExpr (v);
+    // -- a conjunct is guarded by the literal of its edge. A definition
+    // -- may belong to an edge before from
+    ExprVector guarded;
+    guarded.reserve (live.size ());
+    for (unsigned i : live)
+    {
+      unsigned e = std::upper_bound (m_sideSz.begin (), m_sideSz.end (), i) - 
+        m_sideSz.begin ();
+      guarded.push_back (mk<IMPL> (m_acts [e], m_side [i]));
+    }
+    m_smt_solver.assertExprs (guarded);
+  }
+  
+  void BmcEngine::addToCone (unsigned i, std::vector<unsigned> &out)
+  {
+    std::vector<unsigned> todo (1, i);
+    ExprVector syms;
+    while (!todo.empty ())
+    {
+      unsigned j = todo.back ();
+      todo.pop_back ();
+      out.push_back (j);
+      
+      syms.clear ();
+      filter (m_side [j], bind::IsConst (), std::back_inserter (syms));
+      for (Expr v : syms)
+      {
+        if (!m_cone.insert (v).second) continue;
+        auto it = m_sliced.find (v);
+        if (it == m_sliced.end ()) continue;
+        todo.push_back (it->second);
+        m_sliced.erase (it);
+      }
+    }
+  }
+  
+  void BmcEngine::slicedDefs (std::vector<std::pair<Expr,Expr> > &out) const
+  {
+    std::vector<std::pair<unsigned,Expr> > defs;
+    defs.reserve (m_sliced.size ());
+    for (auto &kv : m_sliced) defs.push_back (std::make_pair (kv.second, kv.first));
+    std::sort (defs.begin (), defs.end ());
     
+    out.reserve (out.size () + defs.size ());
+    for (auto &d : defs)
+      out.push_back (std::make_pair (d.second, definedValue (m_side [d.first])));
   }
 
   void BmcEngine::reset ()
   {
+    // -- the terms of the encoding are reclaimed in a single batch
+    ScopedReclaimBatch batch (m_efac);
     m_cps.clear ();
     m_cpg = nullptr;
     m_fn = nullptr;
     m_smt_solver.reset ();
 
     m_side.clear ();
+    m_sideSz.clear ();
+    m_cone.clear ();
+    m_sliced.clear ();
+    m_acts.clear ();
     m_states.clear ();
     m_edges.clear ();
   }
@@ -78,53 +386,65 @@ namespace seahorn
   
   void BmcEngine::unsatCore (ExprVector &out)
   {
+    ufo::ScopedStats _st_ ("BmcEngine.unsatCore");
+    
     // -- re-assert the path-condition with assumptions
     m_smt_solver.reset ();
-    ExprVector assumptions;
+    ExprVector assumptions, guarded;
     assumptions.reserve (m_side.size ());
-    for (Expr v : m_side)
+    guarded.reserve (m_side.size ());
+    std::vector<bool> sliced (m_side.size (), false);
+    for (auto &kv : m_sliced) sliced [kv.second] = true;
+    for (unsigned i = 0; i < m_side.size (); ++i)
     {
+      if (sliced [i]) continue;
+      Expr v = m_side [i];
       Expr a = bind::boolConst (mk<ASM> (v));
       assumptions.push_back (a);
-      m_smt_solver.assertExpr (mk<IMPL> (a, v));
+      guarded.push_back (mk<IMPL> (a, v));
     }
+    m_smt_solver.assertExprs (guarded);
     
     ExprVector core;
-    m_smt_solver.push ();
     boost::tribool res = m_smt_solver.solveAssuming (assumptions);
     if (!res) m_smt_solver.unsatCore (std::back_inserter (core));
-    m_smt_solver.pop ();
-    if (res) return;
-
+    else
+    {
+      restoreEncoding ();
+      return;
+    }
+    
+    CoreMinimizer min (m_smt_solver);
     
     // simplify core
-    while (core.size () < assumptions.size ())
+    while (core.size () < assumptions.size () && !min.exhausted ())
     {
       assumptions.assign (core.begin (), core.end ());
       core.clear ();
-      m_smt_solver.push ();
-      res = m_smt_solver.solveAssuming (assumptions);
-      assert (!res ? 1 : 0);
-      m_smt_solver.unsatCore (std::back_inserter (core));
-      m_smt_solver.pop ();
+      if (!min.isUnsat (assumptions, &core))
+      {
+        core.assign (assumptions.begin (), assumptions.end ());
+        break;
+      }
     }    
     
     // minimize simplified core
-    for (unsigned i = 0; i < core.size ();)
-    {
-      Expr saved = core [i];
-      core [i] = core.back ();
-      res = m_smt_solver.solveAssuming 
-        (boost::make_iterator_range (core.begin (), core.end () - 1));
-      if (res) core [i++] = saved;
-      else if (!res)
-        core.pop_back ();
-      else assert (0);
-    }
+    ExprVector bg, minCore;
+    min.quickXplain (bg, core.begin (), core.end (), false, minCore);
+    min.publish (minCore.size ());
     
     // unwrap the core from ASM to corresponding expressions
-    for (Expr c : core)
+    for (Expr c : minCore)
       out.push_back (bind::fname (bind::fname (c))->arg (0));
+    restoreEncoding ();
+  }
+  
+  void BmcEngine::restoreEncoding ()
+  {
+    m_smt_solver.reset ();
+    m_cone.clear ();
+    m_sliced.clear ();
+    assertEdges (0, m_edges.size ());
   }
   
   BmcTrace BmcEngine::getTrace ()
@@ -141,6 +461,14 @@ namespace seahorn
     
     m_model = bmc.m_smt_solver.getModel ();
     
+    // -- sliced definitions may refer to each other. Resolve them once
+    // -- so that unslice is a single replace. A definition only refers
+    // -- to symbols defined before it since the encoding is in SSA
+    // -- form, so resolving in order needs one replace per definition
+    std::vector<std::pair<Expr,Expr> > defs;
+    m_bmc.slicedDefs (defs);
+    for (auto &kv : defs) m_sliced [kv.first] = unslice (kv.second);
+    
 
     // construct an implicant of the side condition
     ExprVector trace;
@@ -219,7 +547,7 @@ namespace seahorn
                        bool complete) 
   {
     Expr v = symb (loc, val);
-    if (v) v = m_model.eval (v, complete);
+    if (v) v = m_model.eval (unslice (v), complete);
     return v;
   }
   
@@ -235,7 +563,40 @@ namespace seahorn
     
     SymStore &store = m_bmc.m_states[stateidx];
     Expr v = store.eval (u);
-    return m_model.eval (v, complete);
+    return m_model.eval (unslice (v), complete);
+  }
+
+  void BmcTrace::eval (unsigned loc, ArrayRef<const llvm::Value*> vals,
+                       ExprVector &out, bool complete)
+  {
+    ExprVector symbs;
+    symbs.reserve (vals.size ());
+    ExprVector terms;
+    terms.reserve (vals.size ());
+    for (const llvm::Value *val : vals)
+    {
+      symbs.push_back (symb (loc, *val));
+      if (symbs.back ()) terms.push_back (unslice (symbs.back ()));
+    }
+
+    ExprVector res;
+    res.reserve (terms.size ());
+    m_model.eval (terms, std::back_inserter (res), complete);
+
+    out.clear ();
+    out.reserve (symbs.size ());
+    unsigned idx = 0;
+    for (Expr s : symbs) out.push_back (s ? res [idx++] : Expr ());
+  }
+
+  Expr BmcTrace::unslice (Expr e)
+  { return m_sliced.empty () ? e : replace (e, m_sliced); }
+
+  void BmcTrace::evalAll (unsigned loc, ExprVector &out, bool complete)
+  {
+    SmallVector<const llvm::Value*, 32> vals;
+    for (const Instruction &I : *bb (loc)) vals.push_back (&I);
+    eval (loc, vals, out, complete);
   }
 
   
@@ -18,6 +18,7 @@ DM-0002198
 
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
@@ -30,9 +31,32 @@ DM-0002198
 #include "seahorn/Bmc.hh"
 #include "seahorn/UfoSymExec.hh"
 #include "seahorn/BvSymExec.hh"
+#include "seahorn/ZOption.hh"
 
 #include "seahorn/Analysis/CanFail.hh"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <chrono>
+
+static llvm::cl::opt<std::string>
+BmcEntry ("bmc-entry",
+          llvm::cl::desc ("Function to analyze with BMC"),
+          llvm::cl::init ("main"));
+
+static llvm::cl::opt<bool>
+BmcPaths ("bmc-paths",
+          llvm::cl::desc ("Check all cut-point paths from the entry of the "
+                          "function to a returning cut point, up to a bound. "
+                          "Requires --horn-solve"),
+          llvm::cl::init (false));
+
+static llvm::cl::opt<unsigned>
+BmcPathBound ("bmc-path-bound",
+              llvm::cl::desc ("Maximal number of cut-point edges of a path "
+                              "checked by -bmc-paths"),
+              llvm::cl::init (8));
+
 namespace
 {
   using namespace llvm;
@@ -54,7 +78,132 @@ namespace
     virtual bool runOnModule (Module &M)
     {
       for (Function &F : M)
-        if (F.getName ().equals ("main")) return runOnFunction (F);
+        if (F.getName ().equals (BmcEntry)) 
+          return BmcPaths ? runOnPaths (F) : runOnFunction (F);
+      return false;
+    }
+    
+    /// counters of a multi-path run
+    struct PathStats
+    {
+      unsigned paths;
+      unsigned pruned;
+      unsigned unknown;
+      /// feasible paths cut off by the bound
+      unsigned truncated;
+      PathStats () : paths (0), pruned (0), unknown (0), truncated (0) {}
+    };
+    
+    /// Extends the trace of bmc, ending at cp, with every cut-point
+    /// edge out of cp, up to depth more edges. A trace that is unsat is
+    /// not extended. Returns true as soon as a trace to a returning cut
+    /// point is sat, leaving that trace in bmc. A trace that is not
+    /// unsat and has extensions beyond the bound is counted as truncated.
+    /// Every checked trace is written to m_out, if any, in its own
+    /// SMT-LIB scope
+    bool explorePaths (BmcEngine &bmc, const CutPoint &cp, unsigned depth,
+                       SmallVectorImpl<const CutPoint*> &path, PathStats &stats)
+    {
+      if (depth == 0)
+      {
+        if (cp.succ_begin () != cp.succ_end ()) ++stats.truncated;
+        return false;
+      }
+      
+      for (auto it = cp.succ_begin (), end = cp.succ_end (); it != end; ++it)
+      {
+        const CpEdge *edg = *it;
+        const CutPoint &dst = edg->target ();
+        bmc.addCutPoint (dst);
+        path.push_back (&dst);
+        
+        if (m_out)
+        {
+          *m_out << "(push 1)\n";
+          bmc.toSmtLib (*m_out);
+          *m_out << "(pop 1)\n";
+        }
+        
+        auto start = std::chrono::steady_clock::now ();
+        Stats::resume ("BMC");
+        auto res = bmc.solve ();
+        Stats::stop ("BMC");
+        double secs = std::chrono::duration<double> 
+          (std::chrono::steady_clock::now () - start).count ();
+        
+        bool ret = isReturnCp (dst);
+        if (ret || !res)
+        {
+          ++stats.paths;
+          errs () << "BMC path";
+          for (const CutPoint *p : path) errs () << " " << p->bb ().getName ();
+          errs () << ": " << (res ? "sat" : !res ? "unsat" : "unknown")
+                  << " in " << secs << "s\n";
+        }
+        
+        if (ret && res) return true;
+        if (!res) ++stats.pruned;
+        else
+        {
+          if (boost::logic::indeterminate (res)) ++stats.unknown;
+          if (explorePaths (bmc, dst, depth - 1, path, stats)) return true;
+        }
+        
+        path.pop_back ();
+        bmc.popCutPoint ();
+      }
+      return false;
+    }
+    
+    /// checks all the cut-point paths of F up to the bound with a
+    /// single incremental solver
+    bool runOnPaths (Function &F)
+    {
+      // -- the paths to explore depend on the answers of the solver
+      if (!m_solve)
+        report_fatal_error ("-bmc-paths requires --horn-solve");
+      
+      const CutPointGraph &cpg = getAnalysis<CutPointGraph> (F);
+      const CutPoint &src = cpg.getCp (F.getEntryBlock ());
+      
+      ExprFactory efac;
+      ExprFactoryTeardown teardown (efac);
+      BvSmallSymExec sem (efac, *this, F.getParent()->getDataLayout(), MEM);
+      
+      EZ3 zctx (efac);
+      zctx.setCacheBudget (zctxCacheBudget ());
+      BmcEngine bmc (sem, zctx);
+      bmc.setIncremental (true);
+      bmc.addCutPoint (src);
+      
+      PathStats stats;
+      SmallVector<const CutPoint*, 8> path;
+      path.push_back (&src);
+      
+      bool found = explorePaths (bmc, src, BmcPathBound, path, stats);
+      Stats::uset ("BMC.paths", stats.paths);
+      Stats::uset ("BMC.paths.pruned", stats.pruned);
+      Stats::uset ("BMC.paths.truncated", stats.truncated);
+      
+      // -- paths beyond the bound were not checked
+      bool complete = stats.unknown == 0 && stats.truncated == 0;
+      if (found) outs () << "sat";
+      else if (!complete) outs () << "unknown";
+      else outs () << "unsat";
+      outs () << "\n";
+      
+      if (found) Stats::sset ("Result", "FALSE");
+      else if (complete) Stats::sset ("Result", "TRUE");
+      
+      LOG ("cex", 
+           if (found) 
+           {
+             errs () << "Analyzed Function:\n" << F << "\n";
+             BmcTrace trace (bmc.getTrace ());
+             trace.print (errs ());
+           });
+      
+      teardown.begin ();
       return false;
     }
     
@@ -88,9 +237,11 @@ namespace
 
       
       ExprFactory efac;
+      ExprFactoryTeardown teardown (efac);
       BvSmallSymExec sem (efac, *this, F.getParent()->getDataLayout(), MEM);
       
       EZ3 zctx (efac);
+      zctx.setCacheBudget (zctxCacheBudget ());
       BmcEngine bmc (sem, zctx);
       
       bmc.addCutPoint (src);
@@ -135,6 +286,8 @@ namespace
                trace.print (errs ());
              });
       
+      // -- the encoding is reclaimed in one batch when it is destroyed
+      teardown.begin ();
       return false;
     }
     
@@ -54,6 +54,9 @@ namespace seahorn
     for (unsigned loc = 0; loc < trace.size(); loc++)
     {
       const BasicBlock &BB = *trace.bb(loc);
+      // -- calls that need a harness, evaluated in one batch below
+      SmallVector<const Value*, 8> calls;
+      SmallVector<const Function*, 8> callees;
       for (auto &I : BB)
       {
         if (const CallInst *ci = dyn_cast<CallInst> (&I))
@@ -96,13 +99,21 @@ namespace seahorn
           if (tli.getLibFunc (CF->getName(), libfn)) continue;
 
 
-          Expr V = trace.eval (loc, I, true);
-          if (!V) continue;
-          LOG("cex",
-	      errs () << "Producing harness for " << CF->getName () << "\n";);
-          FuncValueMap[CF].push_back(V);
+          calls.push_back (&I);
+          callees.push_back (CF);
         }
       }
+
+      ExprVector vals;
+      trace.eval (loc, calls, vals, true);
+      for (unsigned i = 0; i < vals.size (); ++i)
+      {
+        Expr V = vals [i];
+        if (!V) continue;
+        LOG("cex",
+            errs () << "Producing harness for " << callees [i]->getName () << "\n";);
+        FuncValueMap[callees [i]].push_back(V);
+      }
     }
 
     // Build harness functions
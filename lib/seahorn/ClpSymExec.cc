@@ -44,8 +44,8 @@ namespace
     {
       trueE  = mk<TRUE> (m_efac);
       falseE = mk<FALSE> (m_efac);
-      zero   = mkTerm<mpz_class> (0, m_efac);
-      one    = mkTerm<mpz_class> (1, m_efac);
+      zero   = mkTerm<int64_t> (0, m_efac);
+      one    = mkTerm<int64_t> (1, m_efac);
       // -- first two arguments are reserved for error flag
       m_fparams.push_back (falseE);
       m_fparams.push_back (falseE);
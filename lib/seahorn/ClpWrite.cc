@@ -211,11 +211,11 @@ namespace seahorn
       
       if (isOpX<MPZ>(e)) 
       { 
-        const MPZ& op = dynamic_cast<const MPZ&>(e->op ());
-        if (op.get () < 0)
-          res = ExprStr ("(" + boost::lexical_cast<std::string>(op.get()) + ")");
+        mpz_class num = getTerm<mpz_class> (e);
+        if (num < 0)
+          res = ExprStr ("(" + boost::lexical_cast<std::string>(num) + ")");
         else
-          res = ExprStr (boost::lexical_cast<std::string>(op.get()));
+          res = ExprStr (boost::lexical_cast<std::string>(num));
       }
       else if (isOpX<MPQ>(e))
       { return M::print (e, parent, rels, efac, cache, seen); }      
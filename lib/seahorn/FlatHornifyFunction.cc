@@ -64,7 +64,7 @@ namespace seahorn
     SymStore s (m_efac);
 
     // create step(pc,x1,...,xn) for entry block
-    s.write (pc, mkTerm<mpz_class> (bbOrder [&entry], m_efac));
+    s.write (pc, mkTerm<int64_t> (bbOrder [&entry], m_efac));
     args.push_back (s.read (pc));
     for (const Expr& v : glive) args.push_back (s.read (v));
     allVars.insert (++args.begin (), args.end ());
@@ -83,7 +83,7 @@ namespace seahorn
         args.clear ();
 
         // create step(pc,x1,...,xn) for pre
-        s.write (pc, mkTerm<mpz_class> (bbOrder [bb], m_efac));
+        s.write (pc, mkTerm<int64_t> (bbOrder [bb], m_efac));
         args.push_back (s.read (pc));
         for (const Expr &v : glive) args.push_back (s.read (v));
         allVars.insert (++args.begin (), args.end ());          
@@ -101,7 +101,7 @@ namespace seahorn
 
         // create step(pc,x1,...,xn) for post
         args.clear ();
-        s.write (pc, mkTerm<mpz_class> (bbOrder [dst], m_efac));
+        s.write (pc, mkTerm<int64_t> (bbOrder [dst], m_efac));
         args.push_back (s.read (pc));
         for (const Expr &v : glive) args.push_back (s.read (v));
         allVars.insert (++args.begin (), args.end ());
@@ -132,7 +132,7 @@ namespace seahorn
       allVars.clear ();
       args.clear ();
 
-      s.write (pc, mkTerm<mpz_class> (bbOrder [&BB], m_efac));
+      s.write (pc, mkTerm<int64_t> (bbOrder [&BB], m_efac));
       args.push_back (s.read (pc));
       for (const Expr &v : glive) args.push_back (s.read (v));
       allVars.insert (++args.begin (), args.end ());
@@ -141,7 +141,7 @@ namespace seahorn
       pre = boolop::land (pre, s.read (m_sem.errorFlag (BB)));
       
       args.clear ();
-      s.write (pc, mkTerm<mpz_class> (bbOrder [exit], m_efac));
+      s.write (pc, mkTerm<int64_t> (bbOrder [exit], m_efac));
       args.push_back (s.read (pc));
       for (const Expr &v : glive) args.push_back (s.read (v));
       allVars.insert (++args.begin (), args.end ());
@@ -155,7 +155,7 @@ namespace seahorn
       args.clear ();
       s.reset ();
       
-      s.write (pc, mkTerm<mpz_class> (bbOrder [exit], m_efac));
+      s.write (pc, mkTerm<int64_t> (bbOrder [exit], m_efac));
       args.push_back (s.read (pc));
       if (ls.live (exit).size () == 1)
         s.write (m_sem.errorFlag (*exit), mk<TRUE> (m_efac));
@@ -171,7 +171,7 @@ namespace seahorn
       args.clear ();
       allVars.clear ();
       
-      s.write (pc, mkTerm<mpz_class> (bbOrder [exit], m_efac));
+      s.write (pc, mkTerm<int64_t> (bbOrder [exit], m_efac));
       args.push_back (s.read (pc));
       for (const Expr &v : glive) args.push_back (s.read (v)); 
       allVars.insert (++args.begin (), args.end ());
@@ -258,7 +258,7 @@ namespace seahorn
     SymStore s (m_efac);
     
     
-    s.write (pc, mkTerm<mpz_class> (cpgOrder [&entry], m_efac));
+    s.write (pc, mkTerm<int64_t> (cpgOrder [&entry], m_efac));
     args.push_back (s.read (pc));
     for (const Expr& v : glive) args.push_back (s.read (v));
     allVars.insert (++args.begin (), args.end ());
@@ -279,7 +279,7 @@ namespace seahorn
           args.clear ();
           s.reset ();
           
-          s.write (pc, mkTerm<mpz_class> (cpgOrder [&cp.bb ()], m_efac));
+          s.write (pc, mkTerm<int64_t> (cpgOrder [&cp.bb ()], m_efac));
           args.push_back (s.read (pc));
           for (const Expr &v : glive) args.push_back (s.read (v));
           allVars.insert (++args.begin (), args.end ());
@@ -296,7 +296,7 @@ namespace seahorn
           const BasicBlock &dst = edge->target ().bb ();
           args.clear ();
           
-          s.write (pc, mkTerm<mpz_class> (cpgOrder [&dst], m_efac));
+          s.write (pc, mkTerm<int64_t> (cpgOrder [&dst], m_efac));
           args.push_back (s.read (pc));
           for (const Expr &v : glive) args.push_back (s.read (v));
           allVars.insert (++args.begin (), args.end ());
@@ -324,7 +324,7 @@ namespace seahorn
       allVars.clear ();
       args.clear ();
       
-      s.write (pc, mkTerm<mpz_class> (cpgOrder [&cp.bb ()], m_efac));
+      s.write (pc, mkTerm<int64_t> (cpgOrder [&cp.bb ()], m_efac));
       args.push_back (s.read (pc));
       for (const Expr &v : glive) args.push_back (s.read (v));
       allVars.insert (++args.begin (), args.end ());
@@ -334,7 +334,7 @@ namespace seahorn
       
       args.clear ();
       
-      s.write (pc, mkTerm<mpz_class> (cpgOrder [exit], m_efac));
+      s.write (pc, mkTerm<int64_t> (cpgOrder [exit], m_efac));
       args.push_back (s.read (pc));
       for (const Expr &v : glive) args.push_back (s.read (v));
       allVars.insert (++args.begin (), args.end ());
@@ -348,7 +348,7 @@ namespace seahorn
       args.clear ();
       s.reset ();
       
-      s.write (pc, mkTerm<mpz_class> (cpgOrder [exit], m_efac));
+      s.write (pc, mkTerm<int64_t> (cpgOrder [exit], m_efac));
       args.push_back (s.read (pc));
       if (ls.live (exit).size () == 1)
         s.write (m_sem.errorFlag (*exit), mk<TRUE> (m_efac));
@@ -365,7 +365,7 @@ namespace seahorn
       args.clear ();
       allVars.clear ();
       
-      s.write (pc, mkTerm<mpz_class> (cpgOrder [exit], m_efac));
+      s.write (pc, mkTerm<int64_t> (cpgOrder [exit], m_efac));
       args.push_back (s.read (pc));
       for (const Expr &v : glive) args.push_back (s.read (v)); 
       allVars.insert (++args.begin (), args.end ());
@@ -18,6 +18,7 @@ namespace seahorn
   {
     m_body_idx.clear ();
     m_head_idx.clear ();
+    m_indexed = false;
   }
   
   void HornClauseDB::buildIndexes ()
@@ -25,16 +26,75 @@ namespace seahorn
     resetIndexes ();
       
     /// update indexes
-    for (HornRule &r : m_rules)
+    m_hash_idx.clear ();
+    for (auto it = m_rules.begin (), end = m_rules.end (); it != end; ++it)
     {
-      // -- update head index
-      m_head_idx [bind::fname (r.head ())].insert (&r);
-      // -- update body index
-      ExprVector use;
-      r.used_relations (*this, std::back_inserter (use));
-      for (Expr decl : use) m_body_idx[decl].insert (&r);
-
+      indexRule (*it);
+      // -- the rule may have been changed in place since it was added
+      m_hash_idx.insert (std::make_pair (it->hash (), it.id ()));
     }
+    m_indexed = true;
+  }
+
+  void HornClauseDB::indexRule (HornRule &r)
+  {
+    // -- update head index
+    m_head_idx [bind::fname (r.head ())].insert (&r);
+    // -- update body index
+    ExprVector use;
+    r.used_relations (*this, std::back_inserter (use));
+    for (Expr decl : use) m_body_idx[decl].insert (&r);
+  }
+  
+  void HornClauseDB::unindexRule (HornRule &r)
+  {
+    m_head_idx [bind::fname (r.head ())].erase (&r);
+    ExprVector use;
+    r.used_relations (*this, std::back_inserter (use));
+    for (Expr decl : use) m_body_idx[decl].erase (&r);
+  }
+  
+  unsigned HornClauseDB::addRule (const HornRule &rule)
+  {
+    unsigned id = m_rules.m_rules.size ();
+    m_rules.m_rules.push_back (rule);
+    m_rules.m_removed.push_back (false);
+    ++m_rules.m_size;
+    
+    m_hash_idx.insert (std::make_pair (rule.hash (), id));
+    boost::copy (rule.vars (), std::back_inserter (m_vars));
+    if (m_indexed) indexRule (m_rules.m_rules.back ());
+    return id;
+  }
+  
+  void HornClauseDB::removeRule (const HornRule &r)
+  {
+    auto range = m_hash_idx.equal_range (r.hash ());
+    SmallVector<unsigned, 4> ids;
+    for (auto it = range.first; it != range.second; ++it)
+      if (m_rules.m_rules [it->second] == r) ids.push_back (it->second);
+    for (unsigned id : ids) removeRule (id);
+  }
+  
+  void HornClauseDB::removeRule (unsigned id)
+  {
+    assert (id < m_rules.m_rules.size ());
+    if (m_rules.m_removed [id]) return;
+    
+    HornRule &r = m_rules.m_rules [id];
+    auto range = m_hash_idx.equal_range (r.hash ());
+    for (auto it = range.first; it != range.second; ++it)
+      if (it->second == id)
+      {
+        m_hash_idx.erase (it);
+        break;
+      }
+    if (m_indexed) unindexRule (r);
+    // -- the tombstone does not keep the terms of the rule alive
+    r.release ();
+    
+    m_rules.m_removed [id] = true;
+    --m_rules.m_size;
   }
 
   void HornClauseDBCallGraph::buildCallGraph ()
@@ -46,14 +106,14 @@ namespace seahorn
     {
       // -- callees
       HornClauseDB::expr_set_type callees;
-      const boost::container::flat_set<HornRule*>& uses = m_db.use(p);
+      const HornClauseDB::horn_set_type& uses = m_db.use(p);
       for (const HornRule* r: uses)
       { callees.insert(bind::fname(r->head())); }
       m_callees.insert(std::make_pair(p, callees));
 
       // -- callers
       HornClauseDB::expr_set_type callers;
-      const boost::container::flat_set<HornRule*>& defs = m_db.def(p);
+      const HornClauseDB::horn_set_type& defs = m_db.def(p);
       for (const HornRule* r: defs)
         filter (r->body (), HornClauseDB::IsRelation(m_db),
                 std::inserter(callers, callers.begin())); 
@@ -1,5 +1,7 @@
 #include "seahorn/HornClauseDBTransf.hh"
 #include "ufo/Expr.hpp"
+#include "ufo/Stats.hh"
+#include "ufo/Smt/Z3n.hpp"
 
 namespace seahorn
 {
@@ -68,4 +70,469 @@ namespace seahorn
       db.addRule (new_rule);
     }
   }
+
+  namespace
+  {
+    /// the conjuncts of e, with nested conjunctions flattened
+    void conjuncts (Expr e, ExprVector &out)
+    {
+      if (isOpX<AND> (e))
+        for (unsigned i = 0; i < e->arity (); ++i) conjuncts (e->arg (i), out);
+      else out.push_back (e);
+    }
+
+    /// maps a relation to the positions of its arguments that may
+    /// influence a query
+    typedef std::map<Expr, std::vector<bool> > RelevantMap;
+
+    template <typename Set>
+    void addSymbols (Expr e, Set &out)
+    {filter (e, bind::IsConst (), std::inserter (out, out.end ()));}
+
+    /// marks every argument of app as relevant. Returns true if any
+    /// argument was not relevant before
+    bool markAll (Expr app, RelevantMap &relevant)
+    {
+      bool changed = false;
+      for (auto &&b : relevant [bind::fname (app)])
+        if (!b) { b = true; changed = true; }
+      return changed;
+    }
+
+    /// Marks the arguments of the body relations of r that may
+    /// influence the relevant arguments of its head or its
+    /// constraints. An argument may influence them if it is not a
+    /// symbol, or it is a symbol that occurs in the constraints, in a
+    /// relevant argument of the head or of the body, or in more than
+    /// one argument of the body. A constraint v = e, where v occurs
+    /// nowhere else in the body, can always be satisfied. It only
+    /// matters if v does. Returns true if anything was marked
+    bool propagate (const HornRule &r, HornClauseDB &db, RelevantMap &relevant)
+    {
+      IsPredApp isApp (db);
+      bool changed = false;
+
+      ExprVector body, apps, cons;
+      conjuncts (r.body (), body);
+      for (Expr c : body)
+      {
+        if (isApp (c))
+        {
+          apps.push_back (c);
+          continue;
+        }
+        // -- relations under other connectives are not sliced
+        ExprVector nested;
+        get_all_pred_apps (c, db, std::back_inserter (nested));
+        for (Expr a : nested) changed |= markAll (a, relevant);
+        cons.push_back (c);
+      }
+
+      // -- occurrences of symbols in constraints and in arguments of
+      // -- the body
+      std::map<Expr,unsigned> occurrences, argOccurrences;
+      std::vector<ExprSet> consSyms (cons.size ());
+      for (unsigned i = 0; i < cons.size (); ++i)
+      {
+        addSymbols (cons [i], consSyms [i]);
+        for (Expr v : consSyms [i]) ++occurrences [v];
+      }
+      for (Expr a : apps)
+        for (unsigned i = 1; i < a->arity (); ++i)
+        {
+          ExprSet syms;
+          addSymbols (a->arg (i), syms);
+          for (Expr v : syms)
+          {
+            ++occurrences [v];
+            ++argOccurrences [v];
+          }
+        }
+
+      // -- symbols that may influence a query
+      ExprSet live;
+      ExprVector defined (cons.size ());
+      for (unsigned i = 0; i < cons.size (); ++i)
+      {
+        Expr c = cons [i];
+        if ((isOpX<EQ> (c) || isOpX<IFF> (c)) && bind::IsConst () (c->arg (0)) &&
+            occurrences [c->arg (0)] == 1 && !contains (c->arg (1), c->arg (0)))
+          defined [i] = c->arg (0);
+        else live.insert (consSyms [i].begin (), consSyms [i].end ());
+      }
+
+      Expr h = r.head ();
+      if (isApp (h))
+      {
+        const std::vector<bool> &hr = relevant [bind::fname (h)];
+        for (unsigned i = 0; i < hr.size (); ++i)
+          if (hr [i]) addSymbols (h->arg (i + 1), live);
+      }
+      else addSymbols (h, live);
+
+      // -- a symbol in two arguments of the body joins them
+      for (auto &kv : argOccurrences)
+        if (kv.second > 1) live.insert (kv.first);
+
+      bool again = true;
+      while (again)
+      {
+        again = false;
+        for (unsigned i = 0; i < cons.size (); ++i)
+          if (defined [i] && live.count (defined [i]))
+          {
+            live.insert (consSyms [i].begin (), consSyms [i].end ());
+            defined [i] = Expr ();
+            again = true;
+          }
+
+        for (Expr a : apps)
+        {
+          std::vector<bool> &ar = relevant [bind::fname (a)];
+          for (unsigned i = 0; i < ar.size (); ++i)
+          {
+            Expr arg = a->arg (i + 1);
+            if (!ar [i] && (!bind::IsConst () (arg) || live.count (arg)))
+            {
+              ar [i] = true;
+              changed = true;
+            }
+            if (!ar [i]) continue;
+
+            size_t sz = live.size ();
+            addSymbols (arg, live);
+            if (live.size () != sz) again = true;
+          }
+        }
+      }
+      return changed;
+    }
+
+    /// arguments V_0 ... V_n of a relation, as used by HornDbModel
+    ExprVector modelArgs (Expr rel)
+    {
+      ExprVector args;
+      Expr v = mkTerm<std::string> ("V", rel->efac ());
+      for (unsigned i = 0, sz = bind::domainSz (rel); i < sz; ++i)
+        args.push_back (bind::fapp (bind::constDecl (variant::variant (i, v),
+                                                     bind::domainTy (rel, i))));
+      return args;
+    }
+  }
+
+  bool SliceHornModelConverter::convert (HornDbModel &in, HornDbModel &out)
+  {
+    for (Expr rel : m_rels)
+    {
+      ExprVector args = modelArgs (rel);
+      Expr app = bind::fapp (rel, args);
+
+      auto it = m_slices.find (rel);
+      if (it == m_slices.end ())
+      {
+        out.addDef (app, mk<TRUE> (rel->efac ()));
+        continue;
+      }
+
+      ExprVector sargs;
+      for (unsigned i : m_kept [rel]) sargs.push_back (args [i]);
+      out.addDef (app, in.getDef (bind::fapp (it->second, sargs)));
+    }
+    return true;
+  }
+
+  void sliceHornClauseDB (HornClauseDB &db, HornClauseDB &out,
+                          SliceHornModelConverter &converter)
+  {
+    ufo::ScopedStats _st_ ("HornClauseDB.slice");
+    IsPredApp isApp (db);
+
+    // -- relations backward reachable from the queries
+    ExprSet reach;
+    ExprVector todo;
+    auto visit = [&] (Expr e)
+      {
+        ExprVector apps;
+        get_all_pred_apps (e, db, std::back_inserter (apps));
+        for (Expr a : apps)
+          if (reach.insert (bind::fname (a)).second)
+            todo.push_back (bind::fname (a));
+      };
+    for (Expr q : db.getQueries ()) visit (q);
+    for (const HornRule &r : db.getRules ())
+      if (!isApp (r.head ())) visit (r.body ());
+    while (!todo.empty ())
+    {
+      Expr p = todo.back ();
+      todo.pop_back ();
+      for (const HornRule *r : db.def (p)) visit (r->body ());
+    }
+
+    std::vector<const HornRule*> rules;
+    for (const HornRule &r : db.getRules ())
+      if (!isApp (r.head ()) || reach.count (bind::fname (r.head ())))
+        rules.push_back (&r);
+
+    // -- argument positions that may influence a query
+    RelevantMap relevant;
+    for (Expr p : reach)
+      relevant [p] = std::vector<bool> (bind::domainSz (p), false);
+    for (Expr q : db.getQueries ())
+    {
+      ExprVector apps;
+      get_all_pred_apps (q, db, std::back_inserter (apps));
+      for (Expr a : apps) markAll (a, relevant);
+    }
+    bool changed = true;
+    while (changed)
+    {
+      changed = false;
+      for (const HornRule *r : rules) changed |= propagate (*r, db, relevant);
+    }
+
+    // -- the sliced relations
+    ExprMap slices;
+    unsigned args = 0, keptArgs = 0;
+    for (Expr p : db.getRelations ())
+    {
+      converter.addRelation (p);
+      args += bind::domainSz (p);
+      if (!reach.count (p)) continue;
+
+      const std::vector<bool> &pr = relevant [p];
+      std::vector<unsigned> kept;
+      for (unsigned i = 0; i < pr.size (); ++i)
+        if (pr [i]) kept.push_back (i);
+      keptArgs += kept.size ();
+
+      Expr s = p;
+      if (kept.size () < pr.size ())
+      {
+        ExprVector decl;
+        decl.push_back (variant::tag (bind::fname (p), "slice"));
+        for (unsigned i : kept) decl.push_back (bind::domainTy (p, i));
+        decl.push_back (bind::rangeTy (p));
+        s = mknary<FDECL> (decl);
+      }
+      out.registerRelation (s);
+      slices [p] = s;
+      converter.addSlice (p, s, kept);
+    }
+
+    // -- replaces every relation of e by its slice
+    auto sliceApps = [&] (Expr e)
+      {
+        ExprVector apps;
+        get_all_pred_apps (e, db, std::back_inserter (apps));
+        ExprMap sub;
+        for (Expr a : apps)
+        {
+          Expr p = bind::fname (a);
+          Expr s = slices [p];
+          if (s == p) continue;
+          const std::vector<bool> &pr = relevant [p];
+          ExprVector sargs;
+          for (unsigned i = 0; i < pr.size (); ++i)
+            if (pr [i]) sargs.push_back (a->arg (i + 1));
+          sub [a] = bind::fapp (s, sargs);
+        }
+        return sub.empty () ? e : replace (e, sub);
+      };
+
+    for (const HornRule *r : rules)
+    {
+      Expr head = sliceApps (r->head ());
+      Expr body = sliceApps (r->body ());
+      // -- drop the variables of the sliced arguments
+      ExprSet used;
+      addSymbols (head, used);
+      addSymbols (body, used);
+      ExprVector vars;
+      for (Expr v : r->vars ())
+        if (used.count (v)) vars.push_back (v);
+      out.addRule (HornRule (vars, head, body));
+    }
+
+    for (Expr q : db.getQueries ()) out.addQuery (sliceApps (q));
+
+    // -- constraints that only refer to kept arguments
+    for (auto &kv : slices)
+    {
+      Expr p = kv.first;
+      if (!db.hasConstraints (p)) continue;
+
+      ExprVector pargs = modelArgs (p);
+      ExprSet keptSyms;
+      ExprVector sargs;
+      const std::vector<bool> &pr = relevant [p];
+      for (unsigned i = 0; i < pr.size (); ++i)
+        if (pr [i])
+        {
+          keptSyms.insert (pargs [i]);
+          sargs.push_back (pargs [i]);
+        }
+
+      ExprVector lemmas, kept;
+      conjuncts (db.getConstraints (bind::fapp (p, pargs)), lemmas);
+      for (Expr l : lemmas)
+      {
+        ExprSet syms;
+        addSymbols (l, syms);
+        if (std::includes (keptSyms.begin (), keptSyms.end (),
+                           syms.begin (), syms.end ()))
+          kept.push_back (l);
+      }
+      if (!kept.empty ())
+        out.addConstraint (bind::fapp (kv.second, sargs),
+                           mknary<AND> (mk<TRUE> (p->efac ()), kept));
+    }
+
+    ufo::Stats::uset ("HornClauseDB.slice.rels.pre", db.getRelations ().size ());
+    ufo::Stats::uset ("HornClauseDB.slice.rels.post", reach.size ());
+    ufo::Stats::uset ("HornClauseDB.slice.rules.pre", db.getRules ().size ());
+    ufo::Stats::uset ("HornClauseDB.slice.rules.post", rules.size ());
+    ufo::Stats::uset ("HornClauseDB.slice.args.pre", args);
+    ufo::Stats::uset ("HornClauseDB.slice.args.post", keptArgs);
+  }
+
+  bool InlineHornModelConverter::convert (HornDbModel &in, HornDbModel &out)
+  {
+    ExprSet inlined;
+    for (const HornRule &r : m_inlined) inlined.insert (bind::fname (r.head ()));
+
+    ExprSet rels (m_rels.begin (), m_rels.end ());
+    for (Expr rel : m_rels)
+    {
+      if (inlined.count (rel)) continue;
+      Expr app = bind::fapp (rel, modelArgs (rel));
+      out.addDef (app, in.getDef (app));
+    }
+
+    // -- the body of a rule refers to relations that were never inlined
+    // -- or that were inlined later. Their definitions are already in out
+    for (auto it = m_inlined.rbegin (), end = m_inlined.rend (); it != end; ++it)
+    {
+      const HornRule &r = *it;
+      Expr h = r.head ();
+      Expr rel = bind::fname (h);
+      ExprVector args = modelArgs (rel);
+      ExprFactory &efac = rel->efac ();
+
+      ExprVector apps;
+      filter (r.body (), [&rels] (Expr e)
+              {return bind::isFapp (e) && rels.count (bind::fname (e));},
+              std::back_inserter (apps));
+      ExprMap sub;
+      for (Expr a : apps) sub [a] = out.getDef (a);
+
+      ExprVector conj;
+      conj.push_back (replace (r.body (), sub));
+      for (unsigned i = 0; i < args.size (); ++i)
+        conj.push_back (mk<EQ> (args [i], h->arg (i + 1)));
+      Expr def = mknary<AND> (mk<TRUE> (efac), conj);
+
+      // -- exists vars . def == !(forall vars . !def)
+      ExprSet vars (r.vars ().begin (), r.vars ().end ());
+      if (!vars.empty ())
+        def = boolop::lneg (z3_forall_elim (m_zctx, boolop::lneg (def), vars));
+      out.addDef (bind::fapp (rel, args), def);
+    }
+    return true;
+  }
+
+  unsigned inlineHornClauseDB (HornClauseDB &db,
+                               InlineHornModelConverter &converter,
+                               unsigned budget)
+  {
+    ufo::ScopedStats _st_ ("HornClauseDB.inline");
+    IsPredApp isApp (db);
+    ExprFactory &efac = db.getExprFactory ();
+
+    ExprSet queried;
+    for (Expr q : db.getQueries ())
+    {
+      ExprVector apps;
+      get_all_pred_apps (q, db, std::back_inserter (apps));
+      for (Expr a : apps) queried.insert (bind::fname (a));
+    }
+
+    // -- a copy, since inlined relations are unregistered
+    ExprVector rels (db.getRelations ().begin (), db.getRelations ().end ());
+    unsigned rules = db.getRules ().size ();
+    unsigned fresh = 0, count = 0;
+    for (Expr p : rels)
+    {
+      converter.addRelation (p);
+      if (queried.count (p) || db.hasConstraints (p)) continue;
+      if (db.def (p).size () != 1 || db.use (p).size () != 1) continue;
+      HornRule def = **db.def (p).begin ();
+      HornRule use = **db.use (p).begin ();
+      if (def == use) continue;
+
+      // -- p must occur once in use, as a conjunct of its body
+      ExprVector body, apps;
+      conjuncts (use.body (), body);
+      unsigned at = body.size (), occurrences = 0;
+      for (unsigned i = 0; i < body.size (); ++i)
+      {
+        if (!isApp (body [i]) || bind::fname (body [i]) != p) continue;
+        at = i;
+        ++occurrences;
+      }
+      get_all_pred_apps (use.body (), db, std::back_inserter (apps));
+      if (occurrences != 1 ||
+          std::count_if (apps.begin (), apps.end (), [p] (Expr a)
+                         {return bind::fname (a) == p;}) != 1) continue;
+      Expr app = body [at];
+
+      // -- variables of def in the head are bound to the arguments of
+      // -- app. The other ones are renamed apart from the variables of use
+      ExprSet defVars (def.vars ().begin (), def.vars ().end ());
+      ExprSet useVars (use.vars ().begin (), use.vars ().end ());
+      Expr h = def.head ();
+      ExprMap sub;
+      std::vector<unsigned> unbound;
+      for (unsigned i = 0; i + 1 < h->arity (); ++i)
+      {
+        Expr t = h->arg (i + 1);
+        if (defVars.count (t) && !sub.count (t)) sub [t] = app->arg (i + 1);
+        else unbound.push_back (i);
+      }
+      ExprVector vars (use.vars ());
+      for (Expr v : def.vars ())
+      {
+        if (sub.count (v)) continue;
+        Expr nv = v;
+        if (useVars.count (v))
+        {
+          Expr name = variant::tag (bind::fname (bind::fname (v)), "inline");
+          nv = bind::mkConst (variant::variant (fresh++, name), bind::typeOf (v));
+        }
+        sub [v] = nv;
+        vars.push_back (nv);
+      }
+
+      ExprVector nbody;
+      for (unsigned i = 0; i < body.size (); ++i)
+        if (i != at) nbody.push_back (body [i]);
+      conjuncts (replace (def.body (), sub), nbody);
+      for (unsigned i : unbound)
+        nbody.push_back (mk<EQ> (app->arg (i + 1),
+                                 replace (h->arg (i + 1), sub)));
+      Expr b = mknary<AND> (mk<TRUE> (efac), nbody);
+      if (dagSize (b) > budget) continue;
+
+      converter.addInlined (def);
+      db.removeRule (def);
+      db.removeRule (use);
+      db.addRule (HornRule (vars, use.head (), b));
+      db.unregisterRelation (p);
+      ++count;
+    }
+
+    ufo::Stats::uset ("HornClauseDB.inline.rels", count);
+    ufo::Stats::uset ("HornClauseDB.inline.rules.pre", rules);
+    ufo::Stats::uset ("HornClauseDB.inline.rules.post", db.getRules ().size ());
+    return count;
+  }
 }
@@ -43,6 +43,24 @@ FlexTrace ("horn-flex-trace", cl::Hidden, cl::init (false));
 static llvm::cl::opt<bool>
 HornChildren ("horn-child-order", cl::Hidden, cl::init(true));
 
+static llvm::cl::opt<bool>
+HornSlice ("horn-slice",
+           cl::desc ("Solve only the relations and arguments that may "
+                     "influence a query. Ignored with --horn-cex-pass"),
+           cl::init (false));
+
+static llvm::cl::opt<bool>
+HornInline ("horn-inline",
+            cl::desc ("Inline relations that are defined and used by a "
+                      "single rule. Ignored with --horn-cex-pass"),
+            cl::init (false));
+
+static llvm::cl::opt<unsigned>
+HornInlineBudget ("horn-inline-budget",
+                  cl::desc ("Maximal size of the body of a rule produced "
+                            "by --horn-inline"),
+                  cl::init (5000));
+
 static llvm::cl::opt<unsigned>
 PdrContexts ("horn-pdr-contexts", cl::Hidden, cl::init (500));
 
@@ -88,7 +106,43 @@ namespace seahorn
     params.set (":pdr.max_level", HornMaxDepth);
     fp.set (params);
 
-    db.loadZFixedPoint (fp, SkipConstraints);
+    // -- HornCex needs the answer for the database of HornifyModule
+    bool slice = HornSlice;
+    if (m_cex && slice)
+    {
+      errs () << "WARNING: --horn-slice is ignored with --horn-cex-pass\n";
+      slice = false;
+    }
+    bool inlineRels = HornInline;
+    if (m_cex && inlineRels)
+    {
+      errs () << "WARNING: --horn-inline is ignored with --horn-cex-pass\n";
+      inlineRels = false;
+    }
+
+    // -- slice the database to the cone of influence of the queries
+    HornClauseDB *solveDb = &db;
+    std::unique_ptr<HornClauseDB> sliced;
+    SliceHornModelConverter converter;
+    if (slice)
+    {
+      db.buildIndexes ();
+      sliced.reset (new HornClauseDB (db.getExprFactory ()));
+      sliceHornClauseDB (db, *sliced, converter);
+      solveDb = sliced.get ();
+    }
+    // -- inline single-use relations. The database of HornifyModule is
+    // -- used by other passes, so inline a copy of it
+    std::unique_ptr<HornClauseDB> inlined;
+    InlineHornModelConverter inlineConverter (hm.getZContext ());
+    if (inlineRels)
+    {
+      inlined.reset (new HornClauseDB (*solveDb));
+      inlined->buildIndexes ();
+      inlineHornClauseDB (*inlined, inlineConverter, HornInlineBudget);
+      solveDb = inlined.get ();
+    }
+    solveDb->loadZFixedPoint (fp, SkipConstraints);
 
     Stats::resume ("Horn");
     m_result = fp.query ();
@@ -106,17 +160,27 @@ namespace seahorn
          if (m_result || !m_result) errs () << fp.getAnswer () << "\n";);
 
 
-    if (PrintAnswer && !m_result)
+    HornDbModel dbModel;
+    if ((PrintAnswer && !m_result) || EstimateSizeInvars)
     {
-      HornDbModel dbModel;
-      initDBModelFromFP(dbModel, db, fp);
-      printInvars(M, dbModel);
+      HornDbModel solveModel, inlinedModel;
+      initDBModelFromFP (solveModel, *solveDb, fp);
+      if (inlined)
+      {
+        inlineConverter.convert (solveModel, inlinedModel);
+        std::swap (solveModel, inlinedModel);
+      }
+      if (sliced) converter.convert (solveModel, dbModel);
+      else std::swap (dbModel, solveModel);
     }
+
+    if (PrintAnswer && !m_result)
+      printInvars(M, dbModel);
     else if (PrintAnswer && m_result)
       printCex ();
 
     if (EstimateSizeInvars)
-      estimateSizeInvars(M);
+      estimateSizeInvars(M, dbModel);
 
     return false;
   }
@@ -164,10 +228,9 @@ namespace seahorn
 
   }
 
-  void HornSolver::estimateSizeInvars (Module &M)
+  void HornSolver::estimateSizeInvars (Module &M, HornDbModel &model)
   {
     HornifyModule &hm = getAnalysis<HornifyModule> ();
-    ZFixedPoint<EZ3> fp = *m_fp;
 
     Expr allInvars;
     bool first = true;
@@ -180,7 +243,7 @@ namespace seahorn
         if (!hm.hasBbPredicate (BB)) continue;
         Expr bbPred = hm.bbPredicate (BB);
         const ExprVector &live = hm.live (BB);
-        Expr invars = fp.getCoverDelta (bind::fapp (bbPred, live));
+        Expr invars = model.getDef (bind::fapp (bbPred, live));
         numBlocks++;
         if (first) {
           allInvars = invars;
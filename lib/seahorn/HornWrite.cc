@@ -3,6 +3,7 @@
 #include "seahorn/HornClauseDBTransf.hh"
 #include "seahorn/ClpWrite.hh"
 #include "seahorn/McMtWriter.hh"
+#include "seahorn/Smt2Writer.hh"
 
 #include "seahorn/config.h"
 
@@ -13,6 +14,12 @@ InternalWriter("horn-fp-internal-writer",
                llvm::cl::desc("Use internal writer for Horn SMT2 format. (Default)"),
                llvm::cl::init(true),llvm::cl::Hidden);
 
+static llvm::cl::opt<bool>
+StreamWriter ("horn-stream-writer",
+              llvm::cl::desc ("Write SMT2 Horn clauses directly from the "
+                              "database instead of through Z3"),
+              llvm::cl::init (true), llvm::cl::Hidden);
+
 enum HCFormat { SMT2, CLP, PURESMT2, MCMT};
 static llvm::cl::opt<HCFormat>
 HornClauseFormat("horn-format",
@@ -65,6 +72,18 @@ namespace seahorn
       McMtWriter<llvm::raw_fd_ostream> writer (db, hm.getZContext ());
       writer.write (m_out);
     }
+    else if (StreamWriter)
+    {
+      // -- write header
+      setInfo (m_out, "original", M.getModuleIdentifier ());
+      std::string version ("SeaHorn v.");
+      version += SEAHORN_VERSION_INFO;
+      setInfo (m_out, "authors", version);
+
+      // -- constraints are not written, as with ZFixedPoint
+      Smt2Writer writer (db, HornClauseFormat == PURESMT2);
+      writer.write (m_out);
+    }
     else 
     {
       // Use local ZFixedPoint object to translate to SMT2. 
@@ -0,0 +1,442 @@
+/**
+ * The Horn cache of HornifyModule.
+ *
+ * A cache file holds the Horn clause database of a module together
+ * with what later passes need from HornifyModule: the predicate and
+ * the live symbols of every basic block and the FunctionInfo of every
+ * function. It is an Expr DAG written by ExprIO whose roots are a
+ * flat sequence of records. Lists are preceded by their length.
+ *
+ * Terminals that point to LLVM values are encoded by the position of
+ * the value in the module (see ValueIds). The file name is a hash of
+ * the module, of the options that may change the encoding, and of the
+ * build, so the positions are valid whenever the file is found.
+ */
+#include "seahorn/HornifyModule.hh"
+#include "seahorn/config.h"
+
+#include "ufo/ExprIO.hpp"
+#include "ufo/ExprLlvm.hpp"
+#include "ufo/Stats.hh"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "avy/AvyDebug.h"
+
+#include <memory>
+
+namespace seahorn
+{
+  namespace
+  {
+    /// version of the layout of the roots of a cache file
+    const char *CACHE_FORMAT = "seahorn.horn-cache.1";
+
+    /// Numbers the globals, functions, arguments, basic blocks and
+    /// instructions of a module in a fixed order
+    struct ValueIds
+    {
+      std::vector<const Value*> m_values;
+      DenseMap<const Value*, uint32_t> m_ids;
+      /// true if a value without a number was encoded
+      bool m_missing;
+
+      void add (const Value *v)
+      {
+        m_ids [v] = m_values.size ();
+        m_values.push_back (v);
+      }
+
+      ValueIds (const Module &M) : m_missing (false)
+      {
+        for (const GlobalVariable &gv : M.globals ()) add (&gv);
+        for (const GlobalAlias &ga : M.aliases ()) add (&ga);
+        for (const Function &F : M)
+        {
+          add (&F);
+          for (const Argument &a : F.args ()) add (&a);
+          for (const BasicBlock &bb : F)
+          {
+            add (&bb);
+            for (const Instruction &I : bb) add (&I);
+          }
+        }
+      }
+    };
+
+    /// registers ExprIO codecs for terminals of type T that encode a
+    /// value by its number in ids
+    template <typename T>
+    void addCodec (std::shared_ptr<ValueIds> ids)
+    {
+      io::TerminalCodec c;
+      c.encode = [ids] (const Operator &op, std::string &out)
+        {
+          const Value *v = static_cast<const Terminal<const T*>&> (op).get ();
+          auto it = ids->m_ids.find (v);
+          if (it == ids->m_ids.end ())
+          {
+            ids->m_missing = true;
+            return;
+          }
+          out.append (reinterpret_cast<const char*> (&it->second),
+                      sizeof (uint32_t));
+        };
+      c.decode = [ids] (const char *data, size_t len, ExprFactory &efac)
+        {
+          uint32_t id;
+          if (len != sizeof (id)) return Expr ();
+          std::memcpy (&id, data, sizeof (id));
+          if (id >= ids->m_values.size ()) return Expr ();
+          const T *v = dyn_cast<T> (ids->m_values [id]);
+          return v ? mkTerm<const T*> (v, efac) : Expr ();
+        };
+      io::TerminalCodecs::get ().add (typeid (Terminal<const T*>).name (), c);
+    }
+
+    template <typename T>
+    void removeCodec ()
+    { io::TerminalCodecs::get ().remove (typeid (Terminal<const T*>).name ()); }
+
+    /// registers the codecs of the values of a module for as long as
+    /// it is in scope. The codecs refer to the values of the module,
+    /// so they must not outlive it
+    class ScopedCodecs
+    {
+      std::shared_ptr<ValueIds> m_ids;
+
+    public:
+      ScopedCodecs (const Module &M) : m_ids (new ValueIds (M))
+      {
+        addCodec<Value> (m_ids);
+        addCodec<BasicBlock> (m_ids);
+        addCodec<Function> (m_ids);
+      }
+
+      ~ScopedCodecs ()
+      {
+        removeCodec<Value> ();
+        removeCodec<BasicBlock> ();
+        removeCodec<Function> ();
+      }
+
+      /// true if a value without a number was encoded
+      bool missing () const { return m_ids->m_missing; }
+    };
+
+    /// appends the records of a cache file to a list of roots
+    struct Writer
+    {
+      ExprFactory &m_efac;
+      ExprVector m_roots;
+
+      Writer (ExprFactory &efac) : m_efac (efac) {}
+
+      void add (Expr e) { m_roots.push_back (e); }
+      void count (size_t n) { add (mkTerm<unsigned> (n, m_efac)); }
+      /// a value that may be NULL
+      void value (const Value *v)
+      { add (v ? mkTerm<const Value*> (v, m_efac) : mk<TRUE> (m_efac)); }
+
+      template <typename Range>
+      void list (const Range &r)
+      {
+        count (boost::size (r));
+        for (Expr e : r) add (e);
+      }
+
+      template <typename Range>
+      void values (const Range &r)
+      {
+        count (boost::size (r));
+        for (const Value *v : r) value (v);
+      }
+    };
+
+    /// reads the records of a cache file. Every read fails once a
+    /// record is missing or has the wrong kind
+    struct Reader
+    {
+      const ExprVector &m_roots;
+      ExprFactory &m_efac;
+      unsigned m_pos;
+      bool m_ok;
+
+      Reader (const ExprVector &roots, ExprFactory &efac) :
+        m_roots (roots), m_efac (efac), m_pos (0), m_ok (true) {}
+
+      Expr next ()
+      {
+        if (m_ok && m_pos < m_roots.size ()) return m_roots [m_pos++];
+        m_ok = false;
+        return mk<TRUE> (m_efac);
+      }
+
+      unsigned count ()
+      {
+        Expr e = next ();
+        if (isOpX<UINT> (e)) return getTerm<unsigned> (e);
+        m_ok = false;
+        return 0;
+      }
+
+      template <typename T>
+      const T *value ()
+      {
+        Expr e = next ();
+        if (isOpX<TRUE> (e)) return nullptr;
+        const Value *v = nullptr;
+        if (isOpX<VALUE> (e)) v = getTerm<const Value*> (e);
+        else m_ok = false;
+        const T *res = v ? dyn_cast<T> (v) : nullptr;
+        if (v && !res) m_ok = false;
+        return res;
+      }
+
+      void list (ExprVector &out)
+      {
+        for (unsigned n = count (); m_ok && n > 0; --n) out.push_back (next ());
+      }
+
+      template <typename T, typename Vector>
+      void values (Vector &out)
+      {
+        for (unsigned n = count (); m_ok && n > 0; --n)
+          out.push_back (value<T> ());
+      }
+
+      bool done () const { return m_ok && m_pos == m_roots.size (); }
+    };
+  }
+
+  std::string HornifyModule::cachePath (Module &M, const std::string &dir)
+  {
+    std::string ir;
+    raw_string_ostream os (ir);
+    M.print (os, nullptr);
+    os.flush ();
+
+    MD5 md5;
+    md5.update (CACHE_FORMAT);
+    // -- a different build of seahorn may encode differently
+    md5.update (SEAHORN_VERSION_INFO);
+    md5.update (SEAHORN_GIT_REVISION);
+    md5.update (optionsKey ());
+    md5.update (ir);
+    MD5::MD5Result digest;
+    md5.final (digest);
+    SmallString<32> hex;
+    MD5::stringifyResult (digest, hex);
+
+    return dir + "/" + hex.str ().str () + ".horn";
+  }
+
+  bool HornifyModule::loadCache (Module &M, const std::string &path)
+  {
+    ScopedStats _st ("HornCache.load");
+    if (!sys::fs::exists (path)) return false;
+
+    ScopedCodecs codecs (M);
+    ExprVector roots;
+    std::string why;
+    if (!io::readFile (path, m_efac, roots, &why))
+    {
+      LOG ("horn-cache", errs () << "Horn cache: cannot read " << path
+           << ": " << why << "\n";);
+      return false;
+    }
+
+    Reader r (roots, m_efac);
+    Expr format = r.next ();
+    if (!isOpX<STRING> (format) || getTerm<std::string> (format) != CACHE_FORMAT)
+      return false;
+
+    // -- parse everything before changing the state of this pass
+    ExprVector rels, queries;
+    r.list (rels);
+
+    std::vector<HornRule> rules;
+    for (unsigned n = r.count (); r.m_ok && n > 0; --n)
+    {
+      ExprVector vars;
+      r.list (vars);
+      Expr head = r.next ();
+      Expr body = r.next ();
+      rules.push_back (HornRule (vars, head, body));
+    }
+    r.list (queries);
+
+    ExprVector constraints;
+    r.list (constraints);
+
+    std::vector<std::pair<const BasicBlock*, Expr> > preds;
+    for (unsigned n = r.count (); r.m_ok && n > 0; --n)
+    {
+      const BasicBlock *bb = r.value<BasicBlock> ();
+      preds.push_back (std::make_pair (bb, r.next ()));
+    }
+
+    typedef std::vector<std::pair<const BasicBlock*, ExprVector> > BbLive;
+    std::vector<std::pair<const Function*, BbLive> > live;
+    for (unsigned n = r.count (); r.m_ok && n > 0; --n)
+    {
+      live.push_back (std::make_pair (r.value<Function> (), BbLive ()));
+      for (unsigned k = r.count (); r.m_ok && k > 0; --k)
+      {
+        const BasicBlock *bb = r.value<BasicBlock> ();
+        live.back ().second.push_back (std::make_pair (bb, ExprVector ()));
+        r.list (live.back ().second.back ().second);
+      }
+    }
+
+    std::vector<std::pair<const Function*, FunctionInfo> > infos;
+    for (unsigned n = r.count (); r.m_ok && n > 0; --n)
+    {
+      const Function *F = r.value<Function> ();
+      FunctionInfo fi;
+      fi.sumPred = r.next ();
+      if (isOpX<TRUE> (fi.sumPred)) fi.sumPred = Expr ();
+      r.values<Value> (fi.regions);
+      r.values<Argument> (fi.args);
+      r.values<GlobalVariable> (fi.globals);
+      fi.ret = r.value<Value> ();
+      infos.push_back (std::make_pair (F, fi));
+    }
+
+    if (!r.done ())
+    {
+      LOG ("horn-cache", errs () << "Horn cache: bad file " << path << "\n";);
+      return false;
+    }
+    for (auto &kv : preds) if (!kv.first) return false;
+    for (auto &kv : live)
+    {
+      if (!kv.first) return false;
+      for (auto &bl : kv.second) if (!bl.first) return false;
+    }
+    for (auto &kv : infos) if (!kv.first) return false;
+
+    for (Expr rel : rels) m_db.registerRelation (rel);
+    for (const HornRule &rule : rules) m_db.addRule (rule);
+    for (Expr q : queries) m_db.addQuery (q);
+    for (unsigned i = 0; i + 1 < constraints.size (); i += 2)
+      m_db.addConstraint (constraints [i], constraints [i + 1]);
+    for (auto &kv : preds) m_bbPreds [kv.first] = kv.second;
+    for (auto &kv : live)
+    {
+      auto res = m_ls.insert (std::make_pair (kv.first,
+                                              LiveSymbols (*kv.first, m_efac, *m_sem)));
+      for (auto &bl : kv.second) res.first->second.restoreLive (bl.first, bl.second);
+    }
+    for (auto &kv : infos) m_sem->getFunctionInfo (*kv.first) = kv.second;
+
+    LOG ("horn-cache", errs () << "Horn cache: restored " << path << "\n";);
+    return true;
+  }
+
+  void HornifyModule::storeCache (Module &M, const std::string &path)
+  {
+    ScopedStats _st ("HornCache.store");
+
+    Writer w (m_efac);
+    w.add (mkTerm<std::string> (CACHE_FORMAT, m_efac));
+
+    w.list (m_db.getRelations ());
+    w.count (m_db.getRules ().size ());
+    for (const HornRule &rule : m_db.getRules ())
+    {
+      w.list (rule.vars ());
+      w.add (rule.head ());
+      w.add (rule.body ());
+    }
+    w.list (m_db.getQueries ());
+
+    // -- constraints over bound variables, as they are kept in the database
+    ExprVector constraints;
+    for (Expr rel : m_db.getRelations ())
+    {
+      if (!m_db.hasConstraints (rel)) continue;
+      ExprVector args;
+      for (unsigned i = 0, sz = bind::domainSz (rel); i < sz; ++i)
+        args.push_back (bind::bvar (i, bind::domainTy (rel, i)));
+      Expr app = bind::fapp (rel, args);
+      constraints.push_back (app);
+      constraints.push_back (m_db.getConstraints (app));
+    }
+    w.list (constraints);
+
+    unsigned numPreds = 0;
+    for (auto &kv : m_bbPreds) if (kv.second) ++numPreds;
+    w.count (numPreds);
+    for (auto &kv : m_bbPreds)
+    {
+      if (!kv.second) continue;
+      w.value (kv.first);
+      w.add (kv.second);
+    }
+
+    w.count (m_ls.size ());
+    for (auto &kv : m_ls)
+    {
+      const Function &F = *kv.first;
+      std::vector<const BasicBlock*> bbs;
+      for (const BasicBlock &bb : F)
+        if (kv.second.hasLive (&bb)) bbs.push_back (&bb);
+      w.value (&F);
+      w.count (bbs.size ());
+      for (const BasicBlock *bb : bbs)
+      {
+        w.value (bb);
+        w.list (kv.second.live (bb));
+      }
+    }
+
+    std::vector<const Function*> fns;
+    for (const Function &F : M)
+      if (m_sem->hasFunctionInfo (F)) fns.push_back (&F);
+    w.count (fns.size ());
+    for (const Function *F : fns)
+    {
+      const FunctionInfo &fi = m_sem->getFunctionInfo (*F);
+      w.value (F);
+      w.add (fi.sumPred ? fi.sumPred : mk<TRUE> (m_efac));
+      w.values (fi.regions);
+      w.values (fi.args);
+      w.values (fi.globals);
+      w.value (fi.ret);
+    }
+
+    ScopedCodecs codecs (M);
+
+    // -- write a unique file and rename it, so that concurrent runs
+    // -- never read a partial file
+    std::string dir = sys::path::parent_path (path).str ();
+    SmallString<128> tmp;
+    std::string why;
+    if (sys::fs::create_directories (dir) ||
+        sys::fs::createUniqueFile (path + "-%%%%%%.tmp", tmp))
+      why = "cannot create a file in " + dir;
+    else if (!io::writeFile (tmp.str ().str (), w.m_roots, &why))
+      sys::fs::remove (tmp.str ());
+    else if (codecs.missing ())
+    {
+      // -- e.g., a constant expression in a name
+      why = "a term refers to a value outside of the module";
+      sys::fs::remove (tmp.str ());
+    }
+    else if (sys::fs::rename (tmp.str (), path))
+    {
+      why = "cannot rename " + tmp.str ().str ();
+      sys::fs::remove (tmp.str ());
+    }
+
+    if (!why.empty ())
+      errs () << "WARNING: Horn cache: cannot store " << path << ": " << why << "\n";
+    else
+      LOG ("horn-cache", errs () << "Horn cache: stored " << path << "\n";);
+  }
+}
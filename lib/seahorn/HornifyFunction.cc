@@ -27,6 +27,14 @@ ReduceWeak ("horn-reduce-weakly",
 #include "ufo/Stats.hh"
 namespace seahorn
 {
+  std::string HornifyFunction::optionsKey ()
+  {
+    std::string res;
+    raw_string_ostream os (res);
+    for (const cl::opt<bool> *o : {&ReduceFalse, &FlattenBody, &ReduceWeak})
+      os << o->ArgStr << "=" << o->getValue () << "\n";
+    return os.str ();
+  }
 
   void HornifyFunction::extractFunctionInfo (const BasicBlock &BB)
   {
@@ -29,6 +29,7 @@
 #include "seahorn/Analysis/CanFail.hh"
 #include "ufo/Smt/EZ3.hh"
 #include "ufo/Stats.hh"
+#include "seahorn/ZOption.hh"
 
 #include "seahorn/HornifyFunction.hh"
 #include "seahorn/FlatHornifyFunction.hh"
@@ -85,6 +86,13 @@ AbstractFunctions("horn-abstract",
 		  llvm::cl::desc("Abstract all calls to these functions"),
 		  llvm::cl::ZeroOrMore);
 
+static llvm::cl::opt<std::string>
+HornCache("horn-cache",
+          llvm::cl::desc ("Directory of the Horn cache. Stores the Horn clauses "
+                          "of a module and restores them when seahorn runs again "
+                          "on the same module with the same options"),
+          llvm::cl::init (""), llvm::cl::value_desc ("dir"));
+
 namespace seahorn
 {
   char HornifyModule::ID = 0;
@@ -118,9 +126,27 @@ namespace seahorn
   }
 
   HornifyModule::HornifyModule () :
-    ModulePass (ID), m_zctx (m_efac),  m_db (m_efac),
+    ModulePass (ID), m_teardown (m_efac), m_zctx (m_efac),  m_db (m_efac),
     m_td(0), m_canFail(0)
   {
+    m_zctx.setCacheBudget (zctxCacheBudget ());
+  }
+
+  std::string HornifyModule::optionsKey ()
+  {
+    std::string res;
+    raw_string_ostream os (res);
+    os << TL.ArgStr << "=" << TL.getValue () << "\n";
+    os << Step.ArgStr << "=" << Step.getValue () << "\n";
+    os << InterProc.ArgStr << "=" << InterProc.getValue () << "\n";
+    os << NoVerification.ArgStr << "=" << NoVerification.getValue () << "\n";
+    os << AbstractFunctions.ArgStr << "=";
+    for (const std::string &fn : AbstractFunctions) os << fn << ",";
+    os << "\n";
+    os << UfoSmallSymExec::optionsKey ()
+       << HornifyFunction::optionsKey ()
+       << IncHornifyFunction::optionsKey ();
+    return os.str ();
   }
 
   bool HornifyModule::runOnModule (Module &M)
@@ -211,6 +237,23 @@ namespace seahorn
 	}
     }
     
+    std::string cache;
+    if (!HornCache.empty ())
+    {
+      cache = cachePath (M, HornCache);
+      // -- the cut-point graph may change the CFG (see
+      // -- runOnFunction). Build it before the cache numbers the
+      // -- values, as the run that stored the cache did
+      for (Function &F : M)
+        if (!F.isDeclaration () && !F.empty ()) getAnalysis<CutPointGraph> (F);
+      if (loadCache (M, cache))
+      {
+        Stats::sset ("HornCache", "hit");
+        return Changed;
+      }
+      Stats::sset ("HornCache", "miss");
+    }
+
     // create FunctionInfo for verifier.error() function
     if (Function* errorFn = M.getFunction ("verifier.error"))
     {
@@ -288,6 +331,8 @@ namespace seahorn
       m_db.addQuery (mk<TRUE> (m_efac));
     }
 
+    if (!cache.empty ()) storeCache (M, cache);
+
     /**
        TODO:
          - name basic blocks so that there are no name clashes between functions (DONE)
@@ -121,7 +121,7 @@ namespace seahorn
 		  {
 			  cand = mknary<AND>(lemmas.begin(), lemmas.end());
 		  }
-		  Expr cand_app = replace(cand, bvarToArgMap);
+		  Expr cand_app = m_memo.replace("houdini.inst", fapp, cand, bvarToArgMap);
 
 		  m_candidate_model.addDef(fapp, cand_app);
 	  }
@@ -201,19 +201,21 @@ namespace seahorn
 	  auto &m_hm = m_houdini.getHornifyModule();
 	  auto &db = m_hm.getHornClauseDB();
 
+	  ExprVector side;
 	  Expr ruleHead_cand_app = m_houdini.getCandidateModel().getDef(r.head());
 	  Expr neg_ruleHead_cand_app = mk<NEG>(ruleHead_cand_app);
-	  solver.assertExpr(neg_ruleHead_cand_app);
+	  side.push_back(neg_ruleHead_cand_app);
 
 	  Expr ruleBody = r.body();
 	  ExprVector body_pred_apps;
 	  get_all_pred_apps(ruleBody, db, std::back_inserter(body_pred_apps));
 	  for(Expr body_app : body_pred_apps)
 	  {
-		  solver.assertExpr(m_houdini.getCandidateModel().getDef(body_app)); //add each body predicate app
+		  side.push_back(m_houdini.getCandidateModel().getDef(body_app)); //add each body predicate app
 	  }
 
-	  solver.assertExpr(extractTransitionRelation(r, db));
+	  side.push_back(extractTransitionRelation(r, db));
+	  solver.assertExprs(side);
 
 	  //solver.toSmtLib(errs());
 	  boost::tribool isSat = solver.solve();
@@ -279,17 +281,19 @@ namespace seahorn
 	  auto &m_hm = m_houdini.getHornifyModule();
 	  auto &db = m_hm.getHornClauseDB();
 
+	  ExprVector side;
 	  Expr ruleHead_cand_app = m_houdini.getCandidateModel().getDef(r.head());
   	  Expr neg_ruleHead_cand_app = mk<NEG>(ruleHead_cand_app);
-  	  solver.assertExpr(neg_ruleHead_cand_app);
+  	  side.push_back(neg_ruleHead_cand_app);
 
   	  Expr ruleBody = r.body();
   	  ExprVector body_pred_apps;
   	  get_all_pred_apps(ruleBody, db, std::back_inserter(body_pred_apps));
   	  for(Expr body_app : body_pred_apps)
 	  {
-		  solver.assertExpr(m_houdini.getCandidateModel().getDef(body_app)); //add each body predicate app
+		  side.push_back(m_houdini.getCandidateModel().getDef(body_app)); //add each body predicate app
 	  }
+  	  solver.assertExprs(side);
 
   	  //LOG("houdini", errs() << "AFTER PUSH: \n";);
   	  //solver.toSmtLib(errs());
@@ -376,17 +380,19 @@ namespace seahorn
 		  }
 	  }
 
+	  ExprVector side;
 	  Expr ruleHead_cand_app = m_houdini.getCandidateModel().getDef(r.head());
   	  Expr neg_ruleHead_cand_app = mk<NEG>(ruleHead_cand_app);
-  	  solver.assertExpr(neg_ruleHead_cand_app);
+  	  side.push_back(neg_ruleHead_cand_app);
 
   	  Expr ruleBody = r.body();
   	  ExprVector body_pred_apps;
   	  get_all_pred_apps(ruleBody, db, std::back_inserter(body_pred_apps));
   	  for(Expr body_app : body_pred_apps)
 	  {
-		  solver.assertExpr(m_houdini.getCandidateModel().getDef(body_app)); //add each body predicate app
+		  side.push_back(m_houdini.getCandidateModel().getDef(body_app)); //add each body predicate app
 	  }
+  	  solver.assertExprs(side);
 
   	  //LOG("houdini", errs() << "AFTER PUSH: \n";);
   	  //solver.toSmtLib(errs());
@@ -490,13 +496,13 @@ namespace seahorn
 			if(head_cand_args.size() > 1)
 			{
 				Expr weaken_cand = mknary<AND>(head_cand_args.begin(), head_cand_args.end());
-				Expr weaken_cand_app = replace(weaken_cand, bvarToArgMap);
+				Expr weaken_cand_app = m_houdini.getRewriteMemo().replace("houdini.weaken", ruleHead_app, weaken_cand, bvarToArgMap);
 				m_houdini.getCandidateModel().addDef(ruleHead_app, weaken_cand_app);
 			}
 			else
 			{
 				Expr weaken_cand = head_cand_args[0];
-				Expr weaken_cand_app = replace(weaken_cand, bvarToArgMap);
+				Expr weaken_cand_app = m_houdini.getRewriteMemo().replace("houdini.weaken", ruleHead_app, weaken_cand, bvarToArgMap);
 				m_houdini.getCandidateModel().addDef(ruleHead_app, weaken_cand_app);
 			}
 	  }
@@ -588,8 +594,10 @@ namespace seahorn
 		LOG("houdini", errs() << "RULE BODY: " << *(r.body()) << "\n";);
 		auto &db = m_hm.getHornClauseDB();
 		ZSolver<EZ3> solver(m_hm.getZContext());
-		solver.assertExpr(from_pred_state);
-		solver.assertExpr(extractTransitionRelation(r, db));
+		ExprVector side;
+		side.push_back(from_pred_state);
+		side.push_back(extractTransitionRelation(r, db));
+		solver.assertExprs(side);
 		solver.toSmtLib(outs());
 		boost::tribool isSat = solver.solve();
 		if(isSat)
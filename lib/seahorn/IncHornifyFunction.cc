@@ -19,6 +19,9 @@
 
 namespace seahorn {
 
+std::string IncHornifyFunction::optionsKey() {
+  return std::string(DebugInfo.ArgStr) + "=" + DebugInfo.getValue() + "\n";
+}
 
 /// Extract info
 std::string IncHornifyFunction::extractInfo(const BasicBlock &BB, unsigned crumb) {
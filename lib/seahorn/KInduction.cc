@@ -0,0 +1,128 @@
+#include "seahorn/KInduction.hh"
+
+#include "ufo/Stats.hh"
+#include "avy/AvyDebug.h"
+
+namespace seahorn
+{
+  KInduction::KInduction (SmallStepSymExec &sem, ufo::EZ3 &zctx,
+                          const CutPointGraph &cpg, const CutPoint &entry) :
+    m_cpg (cpg), m_entry (entry), m_base (sem, zctx), m_step (sem, zctx),
+    m_depth (0), m_baseCalls (0), m_stepCalls (0)
+  {
+    m_base.setIncremental (true);
+    m_step.setIncremental (true);
+  }
+
+  void KInduction::moveTo (BmcEngine &bmc, CpPath &cur, const CpPath &path)
+  {
+    // -- keep the common prefix of cur and path
+    unsigned common = 0;
+    while (common < cur.size () && common < path.size () &&
+           cur [common] == path [common]) ++common;
+
+    while (cur.size () > common)
+    {
+      bmc.popCutPoint ();
+      cur.pop_back ();
+    }
+    for (unsigned i = common; i < path.size (); ++i)
+    {
+      bmc.addCutPoint (*path [i]);
+      cur.push_back (path [i]);
+    }
+  }
+
+  boost::tribool KInduction::extend (BmcEngine &bmc, CpPath &cur,
+                                     unsigned &calls,
+                                     const std::vector<CpPath> &frontier,
+                                     std::vector<CpPath> &next,
+                                     bool stopAtSat)
+  {
+    bool sat = false;
+    bool unknown = false;
+
+    for (const CpPath &path : frontier)
+    {
+      const CutPoint &last = *path.back ();
+      for (auto it = last.succ_begin (), end = last.succ_end (); it != end; ++it)
+      {
+        const CpEdge *edg = *it;
+        const CutPoint &dst = edg->target ();
+
+        CpPath ext (path);
+        ext.push_back (&dst);
+        moveTo (bmc, cur, ext);
+
+        boost::tribool res = bmc.solve ();
+        ++calls;
+
+        if (!isReturnCp (dst))
+        {
+          // -- an unsat path has no feasible extension
+          if (!res) continue;
+          next.push_back (std::move (ext));
+        }
+        else if (res)
+        {
+          sat = true;
+          if (stopAtSat) return true;
+        }
+        else if (boost::logic::indeterminate (res)) unknown = true;
+      }
+    }
+
+    if (sat) return true;
+    if (unknown) return boost::indeterminate;
+    return false;
+  }
+
+  boost::tribool KInduction::run (unsigned maxK)
+  {
+    ufo::ScopedStats _st_("KInduction.run");
+
+    std::vector<CpPath> base (1, CpPath (1, &m_entry));
+    std::vector<CpPath> step;
+    for (const CutPoint &cp : m_cpg)
+      if (!isReturnCp (cp)) step.push_back (CpPath (1, &cp));
+
+    // -- true if some path of the base case is neither sat nor unsat
+    bool unknown = false;
+    boost::tribool res = boost::indeterminate;
+    for (m_depth = 1; m_depth <= maxK; ++m_depth)
+    {
+      std::vector<CpPath> next;
+
+      ufo::Stats::resume ("KInduction.base");
+      boost::tribool b = extend (m_base, m_baseTrace, m_baseCalls,
+                                 base, next, true);
+      ufo::Stats::stop ("KInduction.base");
+      if (b) { res = true; break; }
+      if (boost::logic::indeterminate (b)) unknown = true;
+      base.swap (next);
+
+      // -- every path from the entry is explored
+      if (base.empty () && !unknown) { res = false; break; }
+
+      next.clear ();
+      ufo::Stats::resume ("KInduction.step");
+      boost::tribool s = extend (m_step, m_stepTrace, m_stepCalls,
+                                 step, next, false);
+      ufo::Stats::stop ("KInduction.step");
+      step.swap (next);
+
+      LOG ("kind", errs () << "k-induction: k = " << m_depth
+           << " base: " << base.size () << " paths"
+           << " step: " << (s ? "sat" : !s ? "unsat" : "unknown")
+           << ", " << step.size () << " paths\n";);
+
+      if (!s && !unknown) { res = false; break; }
+    }
+
+    if (m_depth > maxK) m_depth = maxK;
+    ufo::Stats::uset ("KInduction.depth", m_depth);
+    ufo::Stats::uset ("KInduction.base.calls", m_baseCalls);
+    ufo::Stats::uset ("KInduction.step.calls", m_stepCalls);
+    return res;
+  }
+}
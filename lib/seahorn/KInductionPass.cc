@@ -0,0 +1,148 @@
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include "ufo/Smt/EZ3.hh"
+#include "ufo/Stats.hh"
+#include "ufo/Passes/NameValues.hpp"
+
+#include "seahorn/KInduction.hh"
+#include "seahorn/HornifyModule.hh"
+#include "seahorn/UfoSymExec.hh"
+#include "seahorn/BvSymExec.hh"
+#include "seahorn/ZOption.hh"
+
+#include "seahorn/Analysis/CanFail.hh"
+
+#include "llvm/Support/CommandLine.h"
+
+#include "avy/AvyDebug.h"
+
+static llvm::cl::opt<std::string>
+KIndEntry ("kind-entry",
+           llvm::cl::desc ("Function to analyze with k-induction"),
+           llvm::cl::init ("main"));
+
+static llvm::cl::opt<unsigned>
+KIndBound ("kind-bound",
+           llvm::cl::desc ("Maximal value of k for k-induction"),
+           llvm::cl::init (8));
+
+static llvm::cl::opt<bool>
+KIndInvariants ("kind-invariants",
+                llvm::cl::desc ("Strengthen the inductive step with the "
+                                "invariants of the Horn clause database "
+                                "(e.g., from Crab or Houdini)"),
+                llvm::cl::init (true));
+
+namespace
+{
+  using namespace llvm;
+  using namespace seahorn;
+  using namespace ufo;
+
+  class KInductionPass : public llvm::ModulePass
+  {
+  public:
+    static char ID;
+
+    KInductionPass () : llvm::ModulePass (ID) {}
+
+    virtual bool runOnModule (Module &M)
+    {
+      for (Function &F : M)
+        if (F.getName ().equals (KIndEntry)) return runOnFunction (F);
+      return false;
+    }
+
+    bool runOnFunction (Function &F)
+    {
+      const CutPointGraph &cpg = getAnalysis<CutPointGraph> (F);
+      const CutPoint &src = cpg.getCp (F.getEntryBlock ());
+
+      // -- invariants are over the symbols of HornifyModule. Use its
+      // -- semantics when they are available
+      HornifyModule *hm =
+        KIndInvariants ? getAnalysisIfAvailable<HornifyModule> () : nullptr;
+
+      std::unique_ptr<ExprFactory> efacPtr;
+      std::unique_ptr<ExprFactoryTeardown> teardown;
+      std::unique_ptr<EZ3> zctxPtr;
+      std::unique_ptr<SmallStepSymExec> semPtr;
+      if (!hm)
+      {
+        efacPtr.reset (new ExprFactory ());
+        teardown.reset (new ExprFactoryTeardown (*efacPtr));
+        semPtr.reset (new BvSmallSymExec (*efacPtr, *this,
+                                          F.getParent ()->getDataLayout (),
+                                          MEM));
+        zctxPtr.reset (new EZ3 (*efacPtr));
+        zctxPtr->setCacheBudget (zctxCacheBudget ());
+      }
+      SmallStepSymExec &sem = hm ? hm->symExec () : *semPtr;
+      EZ3 &zctx = hm ? hm->getZContext () : *zctxPtr;
+
+      KInduction kind (sem, zctx, cpg, src);
+      if (hm)
+      {
+        HornClauseDB &db = hm->getHornClauseDB ();
+        kind.setInvariants ([hm, &db] (const CutPoint &cp, SymStore &s)
+          {
+            const BasicBlock &bb = cp.bb ();
+            Expr pred = hm->bbPredicate (bb);
+            if (!db.hasRelation (pred)) return mk<TRUE> (pred->efac ());
+
+            const ExprVector &live = hm->live (bb);
+            for (const Expr &v : live) s.read (v);
+            return db.getConstraints (s.eval (bind::fapp (pred, live)));
+          });
+      }
+
+      Stats::resume ("KInduction");
+      auto res = kind.run (KIndBound);
+      Stats::stop ("KInduction");
+
+      if (res) outs () << "sat";
+      else if (!res) outs () << "unsat";
+      else outs () << "unknown";
+      outs () << "\n";
+
+      if (res) Stats::sset ("Result", "FALSE");
+      else if (!res) Stats::sset ("Result", "TRUE");
+
+      LOG ("cex",
+           if (res)
+           {
+             errs () << "Analyzed Function:\n" << F << "\n";
+             BmcTrace trace (kind.base ().getTrace ());
+             trace.print (errs ());
+           });
+
+      if (teardown) teardown->begin ();
+      return false;
+    }
+
+    void getAnalysisUsage (AnalysisUsage &AU) const
+    {
+      AU.setPreservesAll ();
+
+      AU.addRequired<seahorn::CanFail> ();
+      AU.addRequired<ufo::NameValues>();
+      AU.addRequired<seahorn::TopologicalOrder>();
+      AU.addRequired<CutPointGraph> ();
+    }
+
+    virtual const char *getPassName () const {return "KInductionPass";}
+  };
+
+  char KInductionPass::ID = 0;
+}
+namespace seahorn
+{
+  Pass *createKInductionPass () {return new KInductionPass ();}
+}
+
+static llvm::RegisterPass<KInductionPass>
+X("kind-pass", "Run k-induction engine");
@@ -392,7 +392,9 @@ namespace seahorn
   Expr PredicateAbstractionAnalysis::applyArgsToBvars(Expr cand, Expr fapp, std::map<Expr, ExprVector> currentCandidates)
   {
     ExprMap bvar_map = getBvarsToArgsMap(fapp, currentCandidates);
-    return replace(cand, bvar_map);
+    // -- the substitution only depends on fapp: bvar i is mapped to
+    // -- argument i
+    return m_memo.replace("pabs.inst", fapp, cand, bvar_map);
   }
 
   ExprMap PredicateAbstractionAnalysis::getBvarsToArgsMap(Expr fapp, std::map<Expr, ExprVector> currentCandidates)
@@ -0,0 +1,562 @@
+#include "seahorn/Smt2Writer.hh"
+
+#include "ufo/ExprLlvm.hpp"
+#include "ufo/Stats.hh"
+
+#include "boost/lexical_cast.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace seahorn
+{
+  using namespace expr;
+
+  namespace
+  {
+    /// -- the SMT-LIB2 name of an operator that is written as is
+    const char *opName (Expr e)
+    {
+      if (isOpX<NEG> (e)) return "not";
+      if (isOpX<AND> (e)) return "and";
+      if (isOpX<OR> (e)) return "or";
+      if (isOpX<IMPL> (e)) return "=>";
+      if (isOpX<IFF> (e)) return "=";
+      if (isOpX<XOR> (e)) return "xor";
+      if (isOpX<ITE> (e)) return "ite";
+
+      if (isOpX<EQ> (e)) return "=";
+      if (isOpX<NEQ> (e)) return "distinct";
+      if (isOpX<LT> (e)) return "<";
+      if (isOpX<LEQ> (e)) return "<=";
+      if (isOpX<GT> (e)) return ">";
+      if (isOpX<GEQ> (e)) return ">=";
+
+      if (isOpX<PLUS> (e)) return "+";
+      if (isOpX<MINUS> (e) || isOpX<UN_MINUS> (e)) return "-";
+      if (isOpX<MULT> (e)) return "*";
+      if (isOpX<IDIV> (e)) return "div";
+      if (isOpX<MOD> (e)) return "mod";
+      if (isOpX<REM> (e)) return "rem";
+
+      if (isOpX<SELECT> (e)) return "select";
+      if (isOpX<STORE> (e)) return "store";
+
+      if (isOpX<BNOT> (e)) return "bvnot";
+      if (isOpX<BNEG> (e)) return "bvneg";
+      if (isOpX<BREDAND> (e)) return "bvredand";
+      if (isOpX<BREDOR> (e)) return "bvredor";
+      if (isOpX<BAND> (e)) return "bvand";
+      if (isOpX<BOR> (e)) return "bvor";
+      if (isOpX<BXOR> (e)) return "bvxor";
+      if (isOpX<BNAND> (e)) return "bvnand";
+      if (isOpX<BNOR> (e)) return "bvnor";
+      if (isOpX<BXNOR> (e)) return "bvxnor";
+      if (isOpX<BADD> (e)) return "bvadd";
+      if (isOpX<BSUB> (e)) return "bvsub";
+      if (isOpX<BMUL> (e)) return "bvmul";
+      if (isOpX<BSDIV> (e)) return "bvsdiv";
+      if (isOpX<BUDIV> (e)) return "bvudiv";
+      if (isOpX<BSREM> (e)) return "bvsrem";
+      if (isOpX<BUREM> (e)) return "bvurem";
+      if (isOpX<BSMOD> (e)) return "bvsmod";
+      if (isOpX<BULE> (e)) return "bvule";
+      if (isOpX<BSLE> (e)) return "bvsle";
+      if (isOpX<BUGE> (e)) return "bvuge";
+      if (isOpX<BSGE> (e)) return "bvsge";
+      if (isOpX<BULT> (e)) return "bvult";
+      if (isOpX<BSLT> (e)) return "bvslt";
+      if (isOpX<BUGT> (e)) return "bvugt";
+      if (isOpX<BSGT> (e)) return "bvsgt";
+      if (isOpX<BCONCAT> (e)) return "concat";
+      if (isOpX<BSHL> (e)) return "bvshl";
+      if (isOpX<BLSHR> (e)) return "bvlshr";
+      if (isOpX<BASHR> (e)) return "bvashr";
+      return nullptr;
+    }
+
+    /// -- true if the sort of e is the sort of its first argument
+    bool sameSortAsArg (Expr e)
+    {
+      return isOpX<PLUS> (e) || isOpX<MINUS> (e) || isOpX<MULT> (e) ||
+        isOpX<UN_MINUS> (e) || isOpX<DIV> (e) || isOpX<IDIV> (e) ||
+        isOpX<MOD> (e) || isOpX<REM> (e) || isOpX<STORE> (e) ||
+        isOpX<BNOT> (e) || isOpX<BNEG> (e) || isOpX<BAND> (e) ||
+        isOpX<BOR> (e) || isOpX<BXOR> (e) || isOpX<BNAND> (e) ||
+        isOpX<BNOR> (e) || isOpX<BXNOR> (e) || isOpX<BADD> (e) ||
+        isOpX<BSUB> (e) || isOpX<BMUL> (e) || isOpX<BSDIV> (e) ||
+        isOpX<BUDIV> (e) || isOpX<BSREM> (e) || isOpX<BUREM> (e) ||
+        isOpX<BSMOD> (e) || isOpX<BSHL> (e) || isOpX<BLSHR> (e) ||
+        isOpX<BASHR> (e);
+    }
+
+    /// -- the sort of e, or null if it is not known without Z3
+    Expr sortOf (Expr e)
+    {
+      while (isOpX<ITE> (e) || (e->arity () > 0 && sameSortAsArg (e)))
+        e = isOpX<ITE> (e) ? e->arg (1) : e->arg (0);
+
+      ExprFactory &efac = e->efac ();
+      if (bind::isFapp (e)) return bind::rangeTy (bind::fname (e));
+      if (isOpX<MPZ> (e) || isOpX<INT64> (e)) return mk<INT_TY> (efac);
+      if (isOpX<MPQ> (e)) return mk<REAL_TY> (efac);
+      if (bv::is_bvnum (e)) return e->arg (1);
+      if (isOpX<BSEXT> (e) || isOpX<BZEXT> (e)) return e->arg (1);
+      if (isOpX<BEXTRACT> (e))
+        return bv::bvsort (bv::high (e) - bv::low (e) + 1, efac);
+      if (isOpX<BCONCAT> (e))
+      {
+        Expr l = sortOf (e->left ());
+        Expr r = sortOf (e->right ());
+        if (l && r) return bv::bvsort (bv::width (l) + bv::width (r), efac);
+      }
+      else if (isOpX<SELECT> (e))
+      {
+        Expr a = sortOf (e->left ());
+        if (a && isOpX<ARRAY_TY> (a)) return sort::arrayValTy (a);
+      }
+      else if (isOpX<CONST_ARRAY> (e))
+      {
+        Expr v = sortOf (e->right ());
+        if (v) return sort::arrayTy (e->left (), v);
+      }
+      else if (isOpX<TRUE> (e) || isOpX<FALSE> (e) || isOpX<NEG> (e) ||
+               isOpX<AND> (e) || isOpX<OR> (e) || isOpX<IMPL> (e) ||
+               isOpX<IFF> (e) || isOpX<XOR> (e) || isOpX<EQ> (e) ||
+               isOpX<NEQ> (e) || isOpX<LT> (e) || isOpX<LEQ> (e) ||
+               isOpX<GT> (e) || isOpX<GEQ> (e))
+        return mk<BOOL_TY> (efac);
+      return Expr ();
+    }
+
+    /// -- s as an SMT-LIB2 symbol. Quoted unless it is a simple symbol
+    std::string symbol (const std::string &s)
+    {
+      bool simple = !s.empty () && !std::isdigit ((unsigned char)s [0]);
+      for (char c : s)
+        if (!std::isalnum ((unsigned char)c) &&
+            !std::strchr ("~!@$%^&*_-+=<>.?/", c))
+        {
+          simple = false;
+          break;
+        }
+      if (simple) return s;
+
+      // -- '|' and '\' cannot be quoted. Escape them as Z3 does
+      std::string res ("|");
+      for (char c : s)
+      {
+        if (c == '|' || c == '\\') res += '\\';
+        res += c;
+      }
+      res += '|';
+      return res;
+    }
+
+    void writeNum (raw_ostream &out, const mpz_class &n, bool real)
+    {
+      if (sgn (n) < 0) out << "(- " << mpz_class (-n).get_str ();
+      else out << n.get_str ();
+      if (real) out << ".0";
+      if (sgn (n) < 0) out << ")";
+    }
+  }
+
+  std::string Smt2Writer::toSmtLib (Expr e)
+  {
+    if (!m_zctx) m_zctx.reset (new ufo::EZ3 (m_db.getExprFactory ()));
+    return m_zctx->toSmtLib (e);
+  }
+
+  Smt2Writer::Kind Smt2Writer::kind (Expr e, ExprVector &kids)
+  {
+    kids.clear ();
+    if (isOpX<TRUE> (e) || isOpX<FALSE> (e) || isOpX<MPZ> (e) ||
+        isOpX<INT64> (e) || isOpX<MPQ> (e) || bv::is_bvnum (e))
+      return ATOM;
+
+    if (bind::isFapp (e))
+    {
+      // -- a constant
+      if (e->arity () == 1) return ATOM;
+      kids.insert (kids.end (), std::next (e->args_begin ()), e->args_end ());
+      return APP;
+    }
+
+    if (isOpX<BEXTRACT> (e))
+    {
+      kids.push_back (bv::earg (e));
+      return APP;
+    }
+    if (isOpX<BSEXT> (e) || isOpX<BZEXT> (e))
+    {
+      if (!sortOf (e->left ())) return OTHER;
+      kids.push_back (e->left ());
+      return APP;
+    }
+    if (isOpX<CONST_ARRAY> (e))
+    {
+      if (!sortOf (e->right ())) return OTHER;
+      kids.push_back (e->right ());
+      return APP;
+    }
+    if (isOpX<DIV> (e))
+    {
+      Expr ty = sortOf (e->left ());
+      if (!ty || !(isOpX<INT_TY> (ty) || isOpX<REAL_TY> (ty))) return OTHER;
+    }
+    else if (!opName (e)) return OTHER;
+
+    if (e->arity () == 0) return OTHER;
+    kids.insert (kids.end (), e->args_begin (), e->args_end ());
+    return APP;
+  }
+
+  void Smt2Writer::writeName (raw_ostream &out, Expr fdecl)
+  {
+    auto it = m_names.find (fdecl);
+    if (it == m_names.end ())
+    {
+      // -- same names as the Z3 marshaler
+      Expr fname = bind::fname (fdecl);
+      std::string name;
+      if (isOpX<STRING> (fname))
+        name = getTerm<std::string> (fname);
+      else
+        name = boost::lexical_cast<std::string> (*fname);
+      it = m_names.insert (std::make_pair (fdecl, symbol (name))).first;
+    }
+    out << it->second;
+  }
+
+  void Smt2Writer::writeSort (raw_ostream &out, Expr ty)
+  {
+    if (isOpX<INT_TY> (ty)) out << "Int";
+    else if (isOpX<REAL_TY> (ty)) out << "Real";
+    else if (isOpX<BOOL_TY> (ty)) out << "Bool";
+    else if (isOpX<BVSORT> (ty)) out << "(_ BitVec " << bv::width (ty) << ")";
+    else if (isOpX<ARRAY_TY> (ty))
+    {
+      out << "(Array ";
+      writeSort (out, sort::arrayIndexTy (ty));
+      out << " ";
+      writeSort (out, sort::arrayValTy (ty));
+      out << ")";
+    }
+    else out << toSmtLib (ty);
+  }
+
+  void Smt2Writer::writeAtom (raw_ostream &out, Expr e)
+  {
+    if (isOpX<TRUE> (e)) out << "true";
+    else if (isOpX<FALSE> (e)) out << "false";
+    else if (isOpX<MPZ> (e)) writeNum (out, getTerm<mpz_class> (e), false);
+    else if (isOpX<INT64> (e))
+      writeNum (out, mpz_class (boost::lexical_cast<std::string>
+                                (getTerm<int64_t> (e))), false);
+    else if (isOpX<MPQ> (e))
+    {
+      const mpq_class &q = getTerm<mpq_class> (e);
+      if (q.get_den () == 1) writeNum (out, q.get_num (), true);
+      else
+      {
+        out << "(/ ";
+        writeNum (out, q.get_num (), true);
+        out << " ";
+        writeNum (out, q.get_den (), true);
+        out << ")";
+      }
+    }
+    else if (bv::is_bvnum (e))
+    {
+      unsigned width = bv::width (e->arg (1));
+      mpz_class n = bv::toMpz (e);
+      if (sgn (n) < 0) n += mpz_class (1) << width;
+      out << "(_ bv" << n.get_str () << " " << width << ")";
+    }
+    else
+    {
+      assert (bind::isFapp (e) && e->arity () == 1);
+      writeName (out, bind::fname (e));
+    }
+  }
+
+  void Smt2Writer::writeOp (raw_ostream &out, Expr e)
+  {
+    if (bind::isFapp (e)) writeName (out, bind::fname (e));
+    else if (isOpX<BEXTRACT> (e))
+      out << "(_ extract " << bv::high (e) << " " << bv::low (e) << ")";
+    else if (isOpX<BSEXT> (e) || isOpX<BZEXT> (e))
+      out << (isOpX<BSEXT> (e) ? "(_ sign_extend " : "(_ zero_extend ")
+          << bv::width (e->right ()) - bv::width (sortOf (e->left ())) << ")";
+    else if (isOpX<CONST_ARRAY> (e))
+    {
+      out << "(as const ";
+      writeSort (out, sort::arrayTy (e->left (), sortOf (e->right ())));
+      out << ")";
+    }
+    else if (isOpX<DIV> (e))
+      out << (isOpX<INT_TY> (sortOf (e->left ())) ? "div" : "/");
+    else out << opName (e);
+  }
+
+  void Smt2Writer::share (Expr e)
+  {
+    m_info.clear ();
+    m_lets.clear ();
+
+    // -- count the parents of every sub-expression and list the
+    // -- compound ones in post-order
+    ExprVector order;
+    ExprVector kids;
+    std::vector<std::pair<Expr,bool> > stack;
+    stack.push_back (std::make_pair (e, false));
+    while (!stack.empty ())
+    {
+      Expr t = stack.back ().first;
+      bool post = stack.back ().second;
+      stack.pop_back ();
+      if (post)
+      {
+        order.push_back (t);
+        continue;
+      }
+
+      if (m_info [t].refs++ > 0) continue;
+      Kind k = kind (t, kids);
+      if (k == OTHER) order.push_back (t);
+      if (k != APP) continue;
+
+      stack.push_back (std::make_pair (t, true));
+      for (ExprVector::reverse_iterator it = kids.rbegin (),
+             end = kids.rend (); it != end; ++it)
+        stack.push_back (std::make_pair (*it, false));
+    }
+
+    // -- bind the shared ones. A binding is placed in the first let
+    // -- that follows the bindings of its sub-expressions
+    int id = 0;
+    for (Expr t : order)
+    {
+      Info &info = m_info [t];
+      kind (t, kids);
+      for (Expr k : kids)
+      {
+        const Info &ki = m_info [k];
+        info.height = std::max (info.height,
+                                ki.id >= 0 ? ki.height + 1 : ki.height);
+      }
+
+      if (info.refs < 2 || t == e) continue;
+      info.id = id++;
+      if (m_lets.size () <= info.height) m_lets.resize (info.height + 1);
+      m_lets [info.height].push_back (t);
+    }
+  }
+
+  void Smt2Writer::writeTerm (raw_ostream &out, Expr e, bool expand)
+  {
+    // -- arguments of the open applications and the next one to write
+    std::vector<std::pair<ExprVector,unsigned> > stack;
+
+    // -- writes t, or opens it and pushes its arguments
+    auto open = [&] (Expr t, bool full)
+      {
+        if (!full)
+        {
+          auto it = m_info.find (t);
+          if (it != m_info.end () && it->second.id >= 0)
+          {
+            out << "t!" << it->second.id;
+            return;
+          }
+        }
+
+        ExprVector kids;
+        switch (kind (t, kids))
+        {
+        case ATOM:
+          writeAtom (out, t);
+          return;
+        case OTHER:
+          out << toSmtLib (t);
+          return;
+        case APP:
+          out << "(";
+          writeOp (out, t);
+          stack.push_back (std::make_pair (std::move (kids), 0u));
+          return;
+        }
+      };
+
+    open (e, expand);
+    while (!stack.empty ())
+    {
+      std::pair<ExprVector,unsigned> &top = stack.back ();
+      if (top.second == top.first.size ())
+      {
+        out << ")";
+        stack.pop_back ();
+        continue;
+      }
+
+      Expr k = top.first [top.second++];
+      out << " ";
+      open (k, false);
+    }
+  }
+
+  void Smt2Writer::writeExpr (raw_ostream &out, Expr e)
+  {
+    share (e);
+
+    unsigned depth = 0;
+    for (const ExprVector &lets : m_lets)
+    {
+      if (lets.empty ()) continue;
+      out << "(let (";
+      for (unsigned i = 0, sz = lets.size (); i < sz; ++i)
+      {
+        if (i > 0) out << " ";
+        out << "(t!" << m_info [lets [i]].id << " ";
+        writeTerm (out, lets [i], true);
+        out << ")";
+      }
+      out << ")\n  ";
+      m_numLets += lets.size ();
+      ++depth;
+    }
+
+    writeTerm (out, e);
+    for (unsigned i = 0; i < depth; ++i) out << ")";
+  }
+
+  void Smt2Writer::writeVarDecl (raw_ostream &out, Expr v)
+  {
+    out << "(";
+    writeName (out, bind::fname (v));
+    out << " ";
+    writeSort (out, bind::typeOf (v));
+    out << ")";
+  }
+
+  void Smt2Writer::writeRule (raw_ostream &out, const HornRule &r)
+  {
+    Expr rule = r.get ();
+    if (isOpX<TRUE> (rule)) return;
+
+    if (!m_pure)
+    {
+      out << "(rule ";
+      writeExpr (out, rule);
+      out << ")\n";
+      return;
+    }
+
+    // -- a rule may list a variable more than once
+    ExprVector vars;
+    ExprSet seen;
+    for (const Expr &v : r.vars ())
+      if (seen.insert (v).second) vars.push_back (v);
+
+    out << "(assert ";
+    if (!vars.empty ())
+    {
+      out << "(forall (";
+      for (unsigned i = 0, sz = vars.size (); i < sz; ++i)
+      {
+        if (i > 0) out << " ";
+        writeVarDecl (out, vars [i]);
+      }
+      out << ")\n  ";
+    }
+    writeExpr (out, rule);
+    if (!vars.empty ()) out << ")";
+    out << ")\n";
+  }
+
+  void Smt2Writer::writeQuery (raw_ostream &out, Expr q)
+  {
+    if (!m_pure)
+    {
+      out << "(query ";
+      writeExpr (out, q);
+      out << ")\n";
+      return;
+    }
+
+    // -- a query holds if no instance of it is derivable
+    ExprVector vars;
+    filter (q, bind::IsConst (), std::back_inserter (vars));
+    out << "(assert ";
+    unsigned n = 0;
+    for (const Expr &v : vars)
+    {
+      // -- nullary predicates are constants too
+      if (m_db.hasRelation (bind::fname (v))) continue;
+      out << (n++ > 0 ? " " : "(forall (");
+      writeVarDecl (out, v);
+    }
+    if (n > 0) out << ")\n  ";
+    out << "(=> ";
+    writeExpr (out, q);
+    out << " false)";
+    if (n > 0) out << ")";
+    out << ")\n";
+  }
+
+  void Smt2Writer::write (raw_ostream &out)
+  {
+    ufo::ScopedStats _st_("Smt2Writer");
+
+    if (m_pure) out << "(set-logic HORN)\n";
+
+    for (const Expr &decl : m_db.getRelations ())
+    {
+      out << (m_pure ? "(declare-fun " : "(declare-rel ");
+      writeName (out, decl);
+      out << " (";
+      for (unsigned i = 0, sz = bind::domainSz (decl); i < sz; ++i)
+      {
+        if (i > 0) out << " ";
+        writeSort (out, bind::domainTy (decl, i));
+      }
+      out << (m_pure ? ") Bool)\n" : "))\n");
+    }
+
+    if (!m_pure)
+    {
+      // -- every variable is declared before the first rule
+      ExprSet seen;
+      for (const HornRule &r : m_db.getRules ())
+        for (const Expr &v : r.vars ())
+        {
+          if (!seen.insert (v).second) continue;
+          assert (bind::IsConst () (v));
+          out << "(declare-var ";
+          writeName (out, bind::fname (v));
+          out << " ";
+          writeSort (out, bind::typeOf (v));
+          out << ")\n";
+        }
+    }
+
+    // -- the cache of the scratch context grows with what it writes.
+    // -- Drop it after each rule
+    for (const HornRule &r : m_db.getRules ())
+    {
+      writeRule (out, r);
+      m_zctx.reset ();
+    }
+    for (const Expr &q : m_db.getQueries ())
+    {
+      writeQuery (out, q);
+      m_zctx.reset ();
+    }
+
+    if (m_pure) out << "(check-sat)\n";
+
+    ufo::Stats::uset ("Smt2Writer.lets", m_numLets);
+  }
+}
@@ -39,8 +39,8 @@ namespace seahorn
   { 
     assert (!isValue (key));
     
-    m_Store[key] = val; 
-    if (m_trackUse) m_defs.push_back (key);
+    m_Store.set (key, val); 
+    if (m_trackUse) mut (m_defs).push_back (key);
   }
     
   /// assign non-deterministic value to key. Returns the new value.
@@ -91,10 +91,10 @@ namespace seahorn
       val = bind::reapp (key, bind::rename (fdecl, fname));
     }      
       
-    if (m_trackUse) m_uses.push_back (key);
+    if (m_trackUse) mut (m_uses).push_back (key);
       
     LOG("live", 
-        llvm::errs () << "Store reading: " << *key << " uses " << m_uses.size () << "\n");
+        llvm::errs () << "Store reading: " << *key << " uses " << uses ().size () << "\n");
       
     {
       detail::scoped_track_use stu (*this, false);
@@ -107,15 +107,16 @@ namespace seahorn
   
   const ExprVector &SymStore::defs () 
   {
-    if (m_defs.size () > m_defs_sz)
+    if (get (m_defs).size () > m_defs_sz)
     {
-      std::sort (m_defs.begin (), m_defs.end ());
-      auto last = std::unique (m_defs.begin (), m_defs.end ());
-      m_defs.resize (std::distance (m_defs.begin (), last));
-      m_defs_sz = m_defs.size ();
+      ExprVector &defs = mut (m_defs);
+      std::sort (defs.begin (), defs.end ());
+      auto last = std::unique (defs.begin (), defs.end ());
+      defs.resize (std::distance (defs.begin (), last));
+      m_defs_sz = defs.size ();
     }
       
-    return m_defs;
+    return get (m_defs);
   }
 
   
@@ -123,8 +124,8 @@ namespace seahorn
   {
     VisitAction seahorn::detail::SymStoreEvalVisitor::operator() (Expr exp) const
     {
-      if (m_store.isDefined (exp))
-        return VisitAction::changeTo (m_store.at (exp));
+      Expr val = m_store.at (exp);
+      if (val) return VisitAction::changeTo (val);
       
       else if (expr::op::bind::isFdecl (exp) || isOpX<BIND> (exp))
         return VisitAction::skipKids ();
@@ -147,8 +147,8 @@ namespace
     {
       trueE = mk<TRUE> (m_efac);
       falseE = mk<FALSE> (m_efac);
-      zeroE = mkTerm<mpz_class> (0, m_efac);
-      oneE = mkTerm<mpz_class> (1, m_efac);
+      zeroE = mkTerm<int64_t> (0, m_efac);
+      oneE = mkTerm<int64_t> (1, m_efac);
       m_uniq = false;
       resetActiveLit ();
       // -- first two arguments are reserved for error flag
@@ -1075,6 +1075,18 @@ namespace
 
 namespace seahorn
 {
+  std::string UfoSmallSymExec::optionsKey ()
+  {
+    std::string res;
+    raw_string_ostream os (res);
+    for (const cl::opt<bool> *o : {&GlobalConstraints, &ArrayGlobalConstraints,
+          &StrictlyLinear, &EnableDiv, &RewriteDiv, &EnableUniqueScalars,
+          &InferMemSafety, &IgnoreCalloc, &IgnoreMemset,
+          &SplitCriticalEdgesOnly, &UseWrite, &LargeStepReduce})
+      os << o->ArgStr << "=" << o->getValue () << "\n";
+    return os.str ();
+  }
+  
   Expr UfoSmallSymExec::errorFlag (const BasicBlock &BB)
   {
     // -- if BB belongs to a function that cannot fail, errorFlag is always false
@@ -1,3 +1,4 @@
+#include "seahorn/ZOption.hh"
 #include "ufo/Smt/Z3n.hpp"
 #include "llvm/Support/CommandLine.h"
 
@@ -20,3 +21,14 @@ TraceOption ("ztrace",
              llvm::cl::value_desc ("string"),
              llvm::cl::ValueRequired, llvm::cl::ZeroOrMore,
              llvm::cl::Hidden);
+
+static llvm::cl::opt<unsigned>
+CacheBudget ("zctx-cache-budget",
+             llvm::cl::desc ("Memory budget in MB of the cache of Expr and "
+                             "Z3 terms of a Z3 context (0 is unbounded)"),
+             llvm::cl::init (512));
+
+namespace seahorn
+{
+  size_t zctxCacheBudget () { return static_cast<size_t> (CacheBudget) << 20; }
+}
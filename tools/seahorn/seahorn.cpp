@@ -19,6 +19,7 @@
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Program.h"
 #include "llvm/Transforms/IPO.h"
 
 #include "seahorn/config.h"
@@ -45,6 +46,9 @@
 #include "ufo/Passes/NameValues.hpp"
 #include "ufo/Stats.hh"
 
+#include <cerrno>
+#include <cstdio>
+
 void print_seahorn_version()
 {
   llvm::outs () << "SeaHorn (http://seahorn.github.io/):\n"
@@ -94,6 +98,17 @@ OutputFilename("o", llvm::cl::desc("Override output filename"),
                llvm::cl::init(""), llvm::cl::value_desc("filename"));
 
 
+enum OutputCompression { NO_COMPRESSION, GZIP, ZSTD };
+static llvm::cl::opt<OutputCompression>
+Compress ("compress",
+          llvm::cl::desc ("Compress the output file while it is written"),
+          llvm::cl::values
+          (clEnumValN (NO_COMPRESSION, "none", "No compression (default)"),
+           clEnumValN (GZIP, "gzip", "Pipe the output through gzip"),
+           clEnumValN (ZSTD, "zstd", "Pipe the output through zstd"),
+           clEnumValEnd),
+          llvm::cl::init (NO_COMPRESSION));
+
 static llvm::cl::opt<std::string>
 AsmOutputFilename("oll", llvm::cl::desc("Output analyzed bitcode"),
                llvm::cl::init(""), llvm::cl::value_desc("filename"));
@@ -130,6 +145,11 @@ Bmc ("horn-bmc",
      llvm::cl::desc ("Use BMC engine. Currently restricted to intra-procedural analysis"),
      llvm::cl::init (false));
 
+static llvm::cl::opt<bool>
+KInd ("horn-kind",
+      llvm::cl::desc ("Use k-induction engine. Currently restricted to intra-procedural analysis"),
+      llvm::cl::init (false));
+
 static llvm::cl::opt<bool>
 OneAssumePerBlock ("horn-one-assume-per-block", 
                    llvm::cl::desc ("Make sure there is at most one call to verifier.assume per block"), 
@@ -156,6 +176,19 @@ MemDot("mem-dot",
        llvm::cl::desc("Print SeaHorn Dsa memory graph of a function to dot format"),
        llvm::cl::init(false));
 
+// quotes str for the shell
+std::string shellQuote (const std::string &str)
+{
+  std::string res ("'");
+  for (char c : str)
+  {
+    if (c == '\'') res += "'\\''";
+    else res += c;
+  }
+  res += "'";
+  return res;
+}
+
 // removes extension from filename if there is one
 std::string getFileName(const std::string &str) {
   std::string filename = str;
@@ -182,6 +215,10 @@ int main(int argc, char **argv) {
   llvm::LLVMContext &context = llvm::getGlobalContext();
   std::unique_ptr<llvm::Module> module;
   std::unique_ptr<llvm::tool_output_file> output;
+  // -- a compressed output file is written through a pipe to the compressor
+  FILE *compressor = nullptr;
+  std::unique_ptr<llvm::raw_fd_ostream> compressedOutput;
+  llvm::raw_fd_ostream *outStream = nullptr;
   std::unique_ptr<llvm::tool_output_file> asmOutput;
 
 
@@ -207,9 +244,34 @@ int main(int argc, char **argv) {
     return 3;
   }
 
-  if (!OutputFilename.empty ())
+  if (!OutputFilename.empty () && Compress != NO_COMPRESSION)
+  {
+    llvm::ErrorOr<std::string> prog =
+      llvm::sys::findProgramByName (Compress == GZIP ? "gzip" : "zstd");
+    if (!prog)
+      error_code = prog.getError ();
+    else
+    {
+      std::string cmd (shellQuote (*prog));
+      cmd += Compress == GZIP ? " -c > " : " -q -c > ";
+      cmd += shellQuote (OutputFilename);
+      compressor = ::popen (cmd.c_str (), "w");
+      if (!compressor)
+        error_code = std::error_code (errno, std::generic_category ());
+      else
+      {
+        compressedOutput = llvm::make_unique<llvm::raw_fd_ostream>
+          (::fileno (compressor), false);
+        outStream = compressedOutput.get ();
+      }
+    }
+  }
+  else if (!OutputFilename.empty ())
+  {
     output = llvm::make_unique<llvm::tool_output_file>
       (OutputFilename.c_str(), error_code, llvm::sys::fs::F_None);
+    outStream = &output->os ();
+  }
 
   if (error_code) {
     if (llvm::errs().has_colors()) llvm::errs().changeColor(llvm::raw_ostream::RED);
@@ -335,17 +397,18 @@ int main(int argc, char **argv) {
   if (Bmc)
   {
     llvm::raw_ostream *out = nullptr;
-    if (!OutputFilename.empty ()) out = &output->os ();
+    if (!OutputFilename.empty ()) out = outStream;
     pass_manager.add (seahorn::createBmcPass (out, Solve));
   }
   else
   {
-    if (!OutputFilename.empty ()) pass_manager.add (new seahorn::HornWrite (output->os ()));
+    if (!OutputFilename.empty ()) pass_manager.add (new seahorn::HornWrite (*outStream));
     if (Crab) pass_manager.add (seahorn::createLoadCrabPass ());
     if (HoudiniInv) pass_manager.add (new seahorn::HoudiniPass ());
     if (PredAbs) pass_manager.add(new seahorn::PredicateAbstraction());
-    if (Solve)
-    { 	  pass_manager.add (new seahorn::HornSolver ());
+    if (KInd) pass_manager.add (seahorn::createKInductionPass ());
+    else if (Solve)
+    { 	  pass_manager.add (new seahorn::HornSolver (Cex));
           if (Cex) pass_manager.add (new seahorn::HornCex ());
     }
   }
@@ -354,7 +417,16 @@ int main(int argc, char **argv) {
   pass_manager.run(*module.get());
 
   if (!AsmOutputFilename.empty ()) asmOutput->keep ();
-  if (!OutputFilename.empty ()) output->keep();
+  if (output) output->keep();
+  if (compressor)
+  {
+    compressedOutput.reset ();
+    if (::pclose (compressor) != 0)
+    {
+      llvm::errs () << "error: Could not compress " << OutputFilename << "\n";
+      return 3;
+    }
+  }
   if (PrintStats) ufo::Stats::PrintBrunch (llvm::outs ());
   return 0;
 }
@@ -0,0 +1,319 @@
+/**
+ * Benchmark of the Expr core.
+ *
+ * Runs the operations that every engine relies on over a workload of
+ * terms and reports, for each phase, the number of operations, the
+ * time per operation, the number and size of the allocations made
+ * through operator new, and the peak resident set size. Phases:
+ *
+ *   mk               -- create the workload (unique table misses)
+ *   mk_hit           -- create it again while it is alive (hits)
+ *   mknary           -- n-ary conjunctions over existing terms
+ *   dag_visit        -- count the nodes with dagVisit
+ *   replace          -- rename every constant with replace
+ *   z3_marshal       -- ZContext::toAst into a fresh context
+ *   z3_marshal_all   -- the same, converting all terms in one pass
+ *   z3_unmarshal     -- ZContext::toExpr from a fresh context
+ *   z3_unmarshal_all -- the same, converting all terms in one pass
+ *   destroy          -- release the workload
+ *
+ * The synthetic workload is the constraints of a hornified program:
+ * predicate applications and transition relations over integer
+ * registers. A recorded workload is a DAG saved by ExprIO (see
+ * io::writeFile). For a recorded workload, mk reads the file and
+ * mk_hit reads it again.
+ *
+ * Output is CSV, one row per phase.
+ *
+ * Usage: expr_bench [-rules N] [-vars N] [-load dag] [-save dag] [-no-z3]
+ */
+#include "ufo/Smt/EZ3.hh"
+#include "ufo/ExprIO.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/resource.h>
+
+using namespace expr;
+using namespace expr::op;
+using namespace ufo;
+
+namespace
+{
+  size_t g_allocs = 0;
+  size_t g_allocBytes = 0;
+}
+
+void *operator new (size_t sz)
+{
+  ++g_allocs;
+  g_allocBytes += sz;
+  if (void *p = std::malloc (sz ? sz : 1)) return p;
+  throw std::bad_alloc ();
+}
+
+void operator delete (void *p) noexcept { std::free (p); }
+void operator delete (void *p, size_t) noexcept { std::free (p); }
+
+namespace
+{
+  struct BenchZ3 : public EZ3
+  {
+    BenchZ3 (ExprFactory &efac) : EZ3 (efac) {}
+    using EZ3::toAst;
+    using EZ3::toExpr;
+    using EZ3::get_ctx;
+  };
+
+  /** measures one phase */
+  class Phase
+  {
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_end;
+    size_t m_allocs;
+    size_t m_bytes;
+    bool m_stopped;
+
+  public:
+    Phase () :
+      m_start (std::chrono::steady_clock::now ()),
+      m_allocs (g_allocs), m_bytes (g_allocBytes), m_stopped (false) {}
+
+    /** ends the measurement before the phase is reported */
+    void stop ()
+    {
+      m_end = std::chrono::steady_clock::now ();
+      m_allocs = g_allocs - m_allocs;
+      m_bytes = g_allocBytes - m_bytes;
+      m_stopped = true;
+    }
+
+    void report (const std::string &workload, const char *name, size_t ops)
+    {
+      if (!m_stopped) stop ();
+      std::chrono::duration<double, std::nano> ns = m_end - m_start;
+
+      struct rusage ru;
+      getrusage (RUSAGE_SELF, &ru);
+
+      std::cout << workload << "," << name << "," << ops << ","
+                << (ops ? ns.count () / ops : 0.0) << ","
+                << m_allocs << "," << m_bytes << "," << ru.ru_maxrss << "\n";
+    }
+  };
+
+  void buildRules (ExprFactory &efac, unsigned numRules, unsigned numVars,
+                   ExprVector &out)
+  {
+    ExprVector vars, primed, sig;
+    for (unsigned i = 0; i < numVars; ++i)
+    {
+      Expr name = mkTerm<std::string> ("v" + std::to_string (i), efac);
+      vars.push_back (bind::intConst (name));
+      primed.push_back (bind::intConst (variant::prime (name)));
+      sig.push_back (mk<INT_TY> (efac));
+    }
+    sig.push_back (mk<BOOL_TY> (efac));
+
+    ExprVector preds;
+    for (unsigned i = 0; i < 64; ++i)
+      preds.push_back (bind::fdecl (mkTerm<std::string>
+                                    ("P" + std::to_string (i), efac), sig));
+
+    for (unsigned r = 0; r < numRules; ++r)
+    {
+      ExprVector body;
+      for (unsigned i = 0; i < numVars; ++i)
+      {
+        Expr c = mkTerm<int64_t> ((r * 7 + i) % 512, efac);
+        Expr upd = (i + r) % 3 == 0 ?
+          mk<PLUS> (vars [i], c) : vars [(i + r) % numVars];
+        body.push_back (mk<EQ> (primed [i], upd));
+      }
+      body.push_back (mk<LEQ> (vars [r % numVars],
+                               mkTerm<int64_t> (r % 1000, efac)));
+      body.push_back (bind::fapp (preds [r % preds.size ()], vars));
+      out.push_back (mk<IMPL> (mknary<AND> (body),
+                               bind::fapp (preds [(r + 1) % preds.size ()],
+                                           primed)));
+    }
+  }
+
+  struct CountVisitor : public std::unary_function<Expr,VisitAction>
+  {
+    size_t nodes;
+    ExprSet *consts;
+    CountVisitor (ExprSet *c = NULL) : nodes (0), consts (c) {}
+
+    VisitAction operator() (Expr e)
+    {
+      ++nodes;
+      if (consts && bind::isFapp (e) && e->arity () == 1)
+        consts->insert (e);
+      return VisitAction::doKids ();
+    }
+  };
+
+  size_t countNodes (const ExprVector &roots, ExprSet *consts = NULL)
+  {
+    CountVisitor cv (consts);
+    DagVisit<CountVisitor> dv (cv);
+    for (const Expr &r : roots) dv (r);
+    return cv.nodes;
+  }
+}
+
+int main (int argc, char **argv)
+{
+  unsigned numRules = 20000;
+  unsigned numVars = 16;
+  const char *load = NULL;
+  const char *save = NULL;
+  bool useZ3 = true;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!std::strcmp (argv [i], "-rules") && i + 1 < argc)
+      numRules = std::atoi (argv [++i]);
+    else if (!std::strcmp (argv [i], "-vars") && i + 1 < argc)
+      numVars = std::atoi (argv [++i]);
+    else if (!std::strcmp (argv [i], "-load") && i + 1 < argc)
+      load = argv [++i];
+    else if (!std::strcmp (argv [i], "-save") && i + 1 < argc)
+      save = argv [++i];
+    else if (!std::strcmp (argv [i], "-no-z3"))
+      useZ3 = false;
+    else
+    {
+      std::cerr << "Usage: " << argv [0] << " [-rules N] [-vars N] "
+                << "[-load dag] [-save dag] [-no-z3]\n";
+      return 1;
+    }
+  }
+
+  std::string workload = load ? load : "synthetic";
+  ExprFactory efac;
+  ExprVector roots;
+  std::string why;
+
+  std::cout << "workload,phase,ops,ns_per_op,allocs,alloc_bytes,peak_rss_kb\n";
+
+  {
+    Phase p;
+    if (load)
+    {
+      if (!io::readFile (load, efac, roots, &why))
+      {
+        std::cerr << "Cannot load " << load << ": " << why << "\n";
+        return 1;
+      }
+    }
+    else
+      buildRules (efac, numRules, numVars, roots);
+    p.stop ();
+    p.report (workload, "mk", countNodes (roots));
+  }
+
+  size_t nodes = countNodes (roots);
+  {
+    ExprVector again;
+    Phase p;
+    if (load) io::readFile (load, efac, again);
+    else buildRules (efac, numRules, numVars, again);
+    p.report (workload, "mk_hit", nodes);
+  }
+
+  {
+    Phase p;
+    ExprVector conj;
+    size_t ops = 0;
+    for (size_t i = 0; i + 16 <= roots.size (); i += 16, ++ops)
+      conj.push_back (mknary<AND> (roots.begin () + i, roots.begin () + i + 16));
+    p.report (workload, "mknary", ops);
+  }
+
+  {
+    Phase p;
+    size_t n = countNodes (roots);
+    p.report (workload, "dag_visit", n);
+  }
+
+  {
+    ExprSet consts;
+    countNodes (roots, &consts);
+    ExprMap renaming;
+    for (const Expr &c : consts)
+    {
+      Expr decl = bind::fname (c);
+      renaming [c] = bind::mkConst (variant::variant (2, bind::fname (decl)),
+                                    bind::rangeTy (decl));
+    }
+
+    Phase p;
+    ExprVector renamed;
+    for (const Expr &r : roots) renamed.push_back (replace (r, renaming));
+    p.report (workload, "replace", nodes);
+  }
+
+  if (useZ3)
+  {
+    BenchZ3 z3 (efac);
+    std::vector<z3::ast> asts;
+    {
+      Phase p;
+      for (const Expr &r : roots) asts.push_back (z3.toAst (r));
+      p.report (workload, "z3_marshal", nodes);
+    }
+
+    {
+      // -- the whole workload in one pass, into a cold context
+      BenchZ3 batch (efac);
+      std::vector<z3::ast> all;
+      all.reserve (roots.size ());
+      Phase p;
+      batch.toAst (roots, std::back_inserter (all));
+      p.report (workload, "z3_marshal_all", nodes);
+    }
+
+    // -- a fresh context so that the conversion cache is cold
+    BenchZ3 other (efac);
+    std::vector<z3::ast> translated;
+    for (const z3::ast &a : asts)
+      translated.push_back (z3::ast (other.get_ctx (),
+                                     Z3_translate (z3.get_ctx (), a,
+                                                   other.get_ctx ())));
+    {
+      Phase p;
+      ExprVector back;
+      for (const z3::ast &a : translated) back.push_back (other.toExpr (a));
+      p.report (workload, "z3_unmarshal", nodes);
+    }
+    {
+      BenchZ3 cold (efac);
+      std::vector<z3::ast> again;
+      for (const z3::ast &a : asts)
+        again.push_back (z3::ast (cold.get_ctx (),
+                                  Z3_translate (z3.get_ctx (), a,
+                                                cold.get_ctx ())));
+      Phase p;
+      ExprVector back;
+      cold.toExpr (again, std::back_inserter (back));
+      p.report (workload, "z3_unmarshal_all", nodes);
+    }
+  }
+
+  if (save && !io::writeFile (save, roots, &why))
+  {
+    std::cerr << "Cannot save " << save << ": " << why << "\n";
+    return 1;
+  }
+
+  {
+    Phase p;
+    roots.clear ();
+    p.report (workload, "destroy", nodes);
+  }
+  return 0;
+}
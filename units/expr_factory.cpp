@@ -0,0 +1,103 @@
+#include "ufo/Expr.hpp"
+
+#include "doctest.h"
+
+using namespace expr;
+
+TEST_CASE("expr.reclaim_batch") {
+  ExprFactory efac;
+  std::unordered_map<ENode*, Expr> cache;
+  efac.registerCache (cache);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr one = mkTerm<mpz_class> (mpz_class (1), efac);
+
+  Expr e = mk<PLUS> (x, one);
+  ENode *node = e.get ();
+  unsigned id = e->getId ();
+  cache [node] = x;
+
+  {
+    ScopedReclaimBatch batch (efac);
+    // -- e dies but is only reclaimed at the end of the batch
+    e.reset ();
+    CHECK(cache.count (node) == 1);
+
+    // -- re-creating it resurrects the same node
+    e = mk<PLUS> (x, one);
+    CHECK(e.get () == node);
+    CHECK(e->getId () == id);
+
+    // -- dies again and is queued twice
+    e.reset ();
+  }
+
+  CHECK(cache.empty ());
+  Expr f = mk<PLUS> (x, one);
+  CHECK(f->getId () != id);
+  efac.unregisterCache (cache);
+}
+
+TEST_CASE("expr.concurrent_cache_reentry") {
+  ExprFactory efac (true);
+  std::unordered_map<ENode*, Expr> cache;
+  efac.registerCache (cache);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr one = mkTerm<mpz_class> (mpz_class (1), efac);
+
+  {
+    // -- the cached value of e dies when e is erased from the cache,
+    // -- which clears the caches again while the first clear is running
+    Expr e = mk<PLUS> (x, one);
+    cache [e.get ()] = mk<MULT> (x, one);
+  }
+  CHECK(cache.empty ());
+  CHECK(efac.unregisterCache (cache));
+}
+
+TEST_CASE("expr.teardown") {
+  ExprFactory efac;
+  std::unordered_map<ENode*, Expr> cache;
+  efac.registerCache (cache);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr e = mk<PLUS> (x, mkTerm<mpz_class> (mpz_class (1), efac));
+  cache [e.get ()] = x;
+
+  // -- a mutable node with enough arguments to be stored on the heap
+  ExprVector args;
+  for (int i = 0; i < 64; ++i) 
+    args.push_back (bind::intConst (mkTerm<int64_t> (i, efac)));
+  Expr g = mknary<AND_G> (args.begin (), args.end ());
+  cache [g.get ()] = x;
+
+  efac.prepareTeardown ();
+  // -- e and g are not reclaimed, but they are dropped from the
+  // -- cache. The storage of g is released by ~ExprFactory ()
+  e.reset ();
+  g.reset ();
+  CHECK(cache.empty ());
+  efac.unregisterCache (cache);
+}
+
+TEST_CASE("expr.small_numerals") {
+  ExprFactory efac;
+
+  // -- numerals that fit in 64 bits are INT64 however they are built
+  Expr a = mkTerm<mpz_class> (mpz_class (-42), efac);
+  Expr b = mkTerm<int64_t> (-42, efac);
+  CHECK(a == b);
+  CHECK(isOpX<INT64> (a));
+  CHECK(isOpX<MPZ> (a));
+  CHECK(getTerm<mpz_class> (a) == -42);
+
+  mpz_class big (std::numeric_limits<int64_t>::max ());
+  big += 1;
+  Expr c = mkTerm<mpz_class> (big, efac);
+  CHECK(!isOpX<INT64> (c));
+  CHECK(isOpX<MPZ> (c));
+  CHECK(getTerm<mpz_class> (c) == big);
+  CHECK(mkTerm<mpz_class> (big - 1, efac) ==
+        mkTerm<int64_t> (std::numeric_limits<int64_t>::max (), efac));
+}
@@ -0,0 +1,50 @@
+#include "ufo/ExprIO.hpp"
+
+#include "doctest.h"
+
+#include <sstream>
+
+using namespace expr;
+using namespace expr::op;
+
+TEST_CASE("expr.io_roundtrip") {
+  ExprFactory efac;
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr bx = bv::bvConst (mkTerm<std::string> ("bx", efac), 32);
+  mpz_class big ("123456789012345678901234567890");
+
+  Expr e1 = mk<AND> (mk<LEQ> (x, mkTerm<mpz_class> (-big, efac)),
+                     mk<EQ> (bx, bv::bvnum (mpz_class (7), 32, efac)));
+  Expr e2 = mk<FORALL> (bind::intConstDecl (mkTerm<std::string> ("y", efac)),
+                        mk<GT> (bind::intBVar (0, efac),
+                                mkTerm<mpq_class> (mpq_class (1, 3), efac)));
+  ExprVector roots = {e1, e2, e1};
+
+  std::ostringstream out;
+  REQUIRE(io::write (out, roots));
+  std::string data = out.str ();
+
+  // -- same factory: the very same nodes
+  ExprVector back;
+  REQUIRE(io::read (data.data (), data.size (), efac, back));
+  REQUIRE(back.size () == 3);
+  CHECK(back [0] == e1);
+  CHECK(back [1] == e2);
+  CHECK(back [2] == e1);
+
+  // -- another factory: the same terms
+  ExprFactory other;
+  ExprVector copy;
+  REQUIRE(io::read (data.data (), data.size (), other, copy));
+  std::ostringstream a, b;
+  a << *e1 << *e2;
+  b << *copy [0] << *copy [1];
+  CHECK(a.str () == b.str ());
+  CHECK(copy [0] == copy [2]);
+
+  // -- truncated data is rejected
+  ExprVector bad;
+  std::string why;
+  CHECK(!io::read (data.data (), data.size () - 1, other, bad, &why));
+  CHECK(bad.empty ());
+}
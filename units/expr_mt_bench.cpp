@@ -0,0 +1,74 @@
+/**
+ * Scaling benchmark for a concurrent ExprFactory.
+ *
+ * Every thread builds the same family of terms over a shared set of
+ * constants so that the unique table sees both hits (terms built by
+ * another thread) and misses. Reports construction throughput for 1
+ * to N threads.
+ *
+ * Usage: expr_mt_bench [max_threads] [terms_per_thread]
+ */
+#include "ufo/Expr.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+using namespace expr;
+
+namespace
+{
+  void buildTerms (ExprFactory &efac, const ExprVector &vars,
+                   unsigned tid, unsigned n)
+  {
+    Expr acc = mk<TRUE> (efac);
+    for (unsigned i = 0; i < n; ++i)
+    {
+      Expr x = vars [i % vars.size ()];
+      Expr y = vars [(i + tid) % vars.size ()];
+      Expr c = mkTerm<mpz_class> (mpz_class (i % 1024), efac);
+      Expr e = mk<LEQ> (mk<PLUS> (x, c), y);
+
+      // -- keep a bounded conjunction alive so that some terms are
+      // -- reclaimed while others are still shared
+      acc = (i % 64 == 0) ? e : mk<AND> (acc, e);
+    }
+  }
+}
+
+int main (int argc, char **argv)
+{
+  unsigned maxThreads = argc > 1 ? std::atoi (argv [1]) :
+    std::max (1u, std::thread::hardware_concurrency ());
+  unsigned n = argc > 2 ? std::atoi (argv [2]) : 200000;
+
+  // -- powers of two up to maxThreads, and maxThreads itself
+  std::vector<unsigned> counts;
+  for (unsigned t = 1; t < maxThreads; t *= 2) counts.push_back (t);
+  counts.push_back (maxThreads);
+
+  std::cout << "threads,terms,seconds,terms_per_sec\n";
+  for (unsigned t : counts)
+  {
+    ExprFactory efac (true);
+    ExprVector vars;
+    for (unsigned i = 0; i < 64; ++i)
+      vars.push_back (bind::intConst
+                      (mkTerm<std::string> ("x" + std::to_string (i), efac)));
+
+    auto start = std::chrono::steady_clock::now ();
+    std::vector<std::thread> workers;
+    for (unsigned tid = 0; tid < t; ++tid)
+      workers.push_back (std::thread (buildTerms, std::ref (efac),
+                                      std::cref (vars), tid, n));
+    for (std::thread &w : workers) w.join ();
+    std::chrono::duration<double> secs =
+      std::chrono::steady_clock::now () - start;
+
+    // -- each iteration creates 4 terms (numeral, PLUS, LEQ, AND)
+    double terms = 4.0 * n * t;
+    std::cout << t << "," << terms << "," << secs.count () << ","
+              << terms / secs.count () << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include "ufo/ExprSimplifier.hh"
+
+#include "doctest.h"
+
+using namespace expr;
+using namespace expr::op;
+
+TEST_CASE("expr.simplify") {
+  ExprFactory efac;
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr y = bind::intConst (mkTerm<std::string> ("y", efac));
+  Expr b = bind::boolConst (mkTerm<std::string> ("b", efac));
+  Expr c = bind::boolConst (mkTerm<std::string> ("c", efac));
+  auto num = [&] (int v) { return mkTerm<mpz_class> (mpz_class (v), efac); };
+
+  // -- constant folding and linear normalization
+  CHECK(simp::simplify (mk<PLUS> (num (2), num (3))) == num (5));
+  CHECK(simp::simplify (mk<MINUS> (mk<PLUS> (x, y), y)) == x);
+  CHECK(simp::simplify (mk<LT> (mk<PLUS> (x, num (1)), mk<PLUS> (y, num (3)))) ==
+        mk<LEQ> (x, mk<PLUS> (y, num (1))));
+  CHECK(isOpX<FALSE> (simp::simplify (mk<EQ> (mk<MULT> (num (2), x), num (3)))));
+  CHECK(simp::simplify (mk<EQ> (num (3), x)) == mk<EQ> (x, num (3)));
+
+  // -- Boolean absorption
+  CHECK(simp::simplify (mk<AND> (b, mk<OR> (b, c))) == b);
+  CHECK(isOpX<FALSE> (simp::simplify (mk<AND> (b, mk<NEG> (b)))));
+  CHECK(simp::simplify (mk<ITE> (b, mk<TRUE> (efac), mk<FALSE> (efac))) == b);
+
+  // -- ite lifting
+  CHECK(simp::simplify (mk<EQ> (mk<ITE> (b, num (1), num (2)), num (1))) == b);
+  CHECK(simp::simplify (mk<PLUS> (mk<ITE> (b, num (1), num (2)), num (3))) ==
+        mk<ITE> (b, num (4), num (5)));
+
+  // -- bit-vectors
+  Expr bx = bv::bvConst (mkTerm<std::string> ("bx", efac), 8);
+  Expr k200 = bv::bvnum (mpz_class (200), 8, efac);
+  Expr k100 = bv::bvnum (mpz_class (100), 8, efac);
+  CHECK(simp::simplify (mk<BADD> (k200, k100)) == bv::bvnum (mpz_class (44), 8, efac));
+  CHECK(isOpX<TRUE> (simp::simplify (mk<BSLT> (k200, k100))));
+  CHECK(simp::simplify (mk<BADD> (bx, bv::bvnum (mpz_class (0), 8, efac))) == bx);
+
+  // -- terms that are not known to be integer keep their shape
+  Expr r = bind::realConst (mkTerm<std::string> ("r", efac));
+  CHECK(simp::simplify (mk<PLUS> (r, r)) == mk<PLUS> (r, r));
+}
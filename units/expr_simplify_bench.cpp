@@ -0,0 +1,122 @@
+/**
+ * Benchmark of the native Expr simplifier against a round trip
+ * through Z3_simplify.
+ *
+ * Simplifies every verification condition given on the command line
+ * (SMT-LIB2 files, e.g., dumped with --horn-smt2 or by the BMC
+ * engine). Without files, simplifies synthetic conditions that mimic
+ * symbolic execution: guarded updates of integer and bit-vector
+ * registers, some of which hold constants. Each row reports the DAG
+ * size of the input and of both results, and the time of both
+ * simplifiers.
+ *
+ * Usage: expr_simplify_bench [vc.smt2 ...]
+ *        expr_simplify_bench -n <num_vcs> <steps>
+ */
+#include "ufo/Smt/EZ3.hh"
+#include "ufo/ExprSimplifier.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace expr;
+using namespace expr::op;
+using namespace ufo;
+
+namespace
+{
+  /** a straight-line program of steps guarded updates */
+  Expr syntheticVc (ExprFactory &efac, unsigned seed, unsigned steps)
+  {
+    std::mt19937 rng (seed);
+    const unsigned numRegs = 8;
+    auto num = [&] (int v) { return mkTerm<mpz_class> (mpz_class (v), efac); };
+
+    ExprVector ints, bvs;
+    for (unsigned i = 0; i < numRegs; ++i)
+    {
+      std::string n = "r" + std::to_string (i);
+      // -- half of the registers start as constants
+      ints.push_back (i % 2 ? num (i) :
+                      bind::intConst (mkTerm<std::string> (n, efac)));
+      bvs.push_back (i % 2 ? bv::bvnum (mpz_class (i), 32, efac) :
+                     bv::bvConst (mkTerm<std::string> ("b" + n, efac), 32));
+    }
+
+    ExprVector side;
+    for (unsigned s = 0; s < steps; ++s)
+    {
+      unsigned d = rng () % numRegs;
+      unsigned a = rng () % numRegs;
+      unsigned b = rng () % numRegs;
+      Expr guard = rng () % 2 ?
+        mk<LT> (mk<PLUS> (ints [a], num (1)), ints [b]) :
+        mk<EQ> (mk<BAND> (bvs [a], bv::bvnum (mpz_class (255), 32, efac)),
+                bvs [b]);
+      guard = boolop::land (guard, mk<TRUE> (efac));
+
+      Expr upd = mk<MINUS> (mk<PLUS> (ints [a], num (rng () % 4)), ints [b]);
+      ints [d] = mk<ITE> (guard, upd, ints [d]);
+      bvs [d] = mk<ITE> (guard, mk<BADD> (bvs [a], bvs [b]), bvs [d]);
+
+      if (s % 8 == 0)
+      {
+        Expr v = bind::intConst (mkTerm<std::string>
+                                 ("v" + std::to_string (s), efac));
+        side.push_back (mk<EQ> (v, ints [d]));
+        ints [d] = v;
+      }
+    }
+    side.push_back (mk<GT> (ints [0], ints [1]));
+    return mknary<AND> (side);
+  }
+
+  double since (std::chrono::steady_clock::time_point start)
+  {
+    std::chrono::duration<double> d = std::chrono::steady_clock::now () - start;
+    return d.count ();
+  }
+}
+
+int main (int argc, char **argv)
+{
+  ExprFactory efac;
+  EZ3 z3 (efac);
+
+  std::vector<std::pair<std::string, Expr> > vcs;
+  if (argc > 1 && std::strcmp (argv [1], "-n") != 0)
+    for (int i = 1; i < argc; ++i)
+      vcs.push_back (std::make_pair (std::string (argv [i]),
+                                     z3_from_smtlib_file (z3, argv [i])));
+  else
+  {
+    unsigned num = argc > 2 ? std::atoi (argv [2]) : 20;
+    unsigned steps = argc > 3 ? std::atoi (argv [3]) : 2000;
+    for (unsigned i = 0; i < num; ++i)
+      vcs.push_back (std::make_pair ("synthetic" + std::to_string (i),
+                                     syntheticVc (efac, i, steps)));
+  }
+
+  std::cout << "vc,dag_in,native_dag,native_sec,z3_dag,z3_sec\n";
+  double tNative = 0, tZ3 = 0;
+  for (auto &vc : vcs)
+  {
+    auto start = std::chrono::steady_clock::now ();
+    Expr native = simp::simplify (vc.second);
+    double n = since (start);
+
+    start = std::chrono::steady_clock::now ();
+    Expr viaZ3 = z3_simplify (z3, vc.second);
+    double z = since (start);
+
+    tNative += n;
+    tZ3 += z;
+    std::cout << vc.first << "," << dagSize (vc.second) << ","
+              << dagSize (native) << "," << n << ","
+              << dagSize (viaZ3) << "," << z << "\n";
+  }
+  std::cout << "total,,," << tNative << ",," << tZ3 << "\n";
+  return 0;
+}
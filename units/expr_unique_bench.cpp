@@ -0,0 +1,146 @@
+/**
+ * Micro-benchmark of the ExprFactory unique table.
+ *
+ * Builds a hornification-like workload: predicate applications over
+ * primed and unprimed integer variables, and transition constraints
+ * made of equalities, linear updates and guards. Measures the rate of
+ * term creation (unique table misses), of re-creating the same terms
+ * while they are alive (hits), and of tearing them down: one node at a
+ * time, in a single reclamation batch, and as part of the teardown of
+ * the factory. A few caches are registered with the factory, as in a
+ * typical run. Each row also reports the size of a node and the peak
+ * resident set size of the process.
+ *
+ * The target is built twice: expr_unique_bench with the flat
+ * open-addressing table, and expr_unique_bench_legacy with the
+ * per-operator unordered_set table (NO_FLAT_UNIQUE_TABLE).
+ *
+ * Usage: expr_unique_bench [num_rules] [vars_per_pred]
+ */
+#include "ufo/Expr.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <sys/resource.h>
+
+using namespace expr;
+
+namespace
+{
+  /** builds the constraints of numRules rules. Returns the number
+      of mk calls */
+  size_t buildRules (ExprFactory &efac, const ExprVector &preds,
+                     const ExprVector &vars, const ExprVector &primed,
+                     unsigned numRules, ExprVector &out)
+  {
+    size_t mks = 0;
+    unsigned n = vars.size ();
+    for (unsigned r = 0; r < numRules; ++r)
+    {
+      ExprVector body;
+      for (unsigned i = 0; i < n; ++i)
+      {
+        Expr c = mkTerm<mpz_class> (mpz_class ((r * 7 + i) % 512), efac);
+        Expr upd = (i + r) % 3 == 0 ? mk<PLUS> (vars [i], c) : vars [(i + r) % n];
+        body.push_back (mk<EQ> (primed [i], upd));
+        mks += 3;
+      }
+      Expr guard = mk<LEQ> (vars [r % n], mkTerm<mpz_class> (mpz_class (r % 1000), efac));
+      body.push_back (guard);
+      mks += 2;
+
+      Expr src = bind::fapp (preds [r % preds.size ()], vars);
+      Expr dst = bind::fapp (preds [(r + 1) % preds.size ()], primed);
+      body.push_back (src);
+      out.push_back (mk<IMPL> (mknary<AND> (body), dst));
+      mks += 4;
+    }
+    return mks;
+  }
+
+  double since (std::chrono::steady_clock::time_point start)
+  {
+    std::chrono::duration<double> d = std::chrono::steady_clock::now () - start;
+    return d.count ();
+  }
+
+  long peakRssKb ()
+  {
+    struct rusage ru;
+    getrusage (RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+  }
+}
+
+int main (int argc, char **argv)
+{
+  unsigned numRules = argc > 1 ? std::atoi (argv [1]) : 100000;
+  unsigned numVars = argc > 2 ? std::atoi (argv [2]) : 16;
+
+  ExprFactory efac;
+  std::vector<std::unordered_map<ENode*,Expr> > caches (8);
+  for (auto &c : caches) efac.registerCache (c);
+
+  ExprVector vars, primed, sig;
+  for (unsigned i = 0; i < numVars; ++i)
+  {
+    Expr name = mkTerm<std::string> ("v" + std::to_string (i), efac);
+    vars.push_back (bind::intConst (name));
+    primed.push_back (bind::intConst (variant::prime (name)));
+    sig.push_back (mk<INT_TY> (efac));
+  }
+  sig.push_back (mk<BOOL_TY> (efac));
+
+  ExprVector preds;
+  for (unsigned i = 0; i < 256; ++i)
+    preds.push_back (bind::fdecl (mkTerm<std::string> ("P" + std::to_string (i), efac), sig));
+
+  auto start = std::chrono::steady_clock::now ();
+  ExprVector rules;
+  size_t mks = buildRules (efac, preds, vars, primed, numRules, rules);
+  double tMiss = since (start);
+
+  start = std::chrono::steady_clock::now ();
+  ExprVector again;
+  buildRules (efac, preds, vars, primed, numRules, again);
+  double tHit = since (start);
+  long rss = peakRssKb ();
+
+  start = std::chrono::steady_clock::now ();
+  again.clear ();
+  rules.clear ();
+  double tFree = since (start);
+
+  buildRules (efac, preds, vars, primed, numRules, rules);
+  start = std::chrono::steady_clock::now ();
+  efac.beginBatch ();
+  rules.clear ();
+  efac.endBatch ();
+  double tBatch = since (start);
+
+  buildRules (efac, preds, vars, primed, numRules, rules);
+  for (auto &c : caches) efac.unregisterCache (c);
+  start = std::chrono::steady_clock::now ();
+  efac.prepareTeardown ();
+  rules.clear ();
+  double tTeardown = since (start);
+
+#ifdef FLAT_UNIQUE_TABLE
+  const char *table = "flat";
+#else
+  const char *table = "unordered_set";
+#endif
+
+  std::cout << "table,phase,ops,seconds,ops_per_sec,node_bytes,peak_rss_kb\n";
+  auto row = [&] (const char *phase, double secs)
+  {
+    std::cout << table << "," << phase << "," << mks << "," << secs << ","
+              << mks / secs << "," << sizeof (ENode) << "," << rss << "\n";
+  };
+  row ("mk", tMiss);
+  row ("lookup", tHit);
+  row ("free", tFree);
+  row ("free_batch", tBatch);
+  row ("teardown", tTeardown);
+  return 0;
+}
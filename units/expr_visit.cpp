@@ -0,0 +1,96 @@
+#include "ufo/Expr.hpp"
+#include "ufo/ExprMemo.hh"
+
+#include "doctest.h"
+
+using namespace expr;
+
+TEST_CASE("expr.visit_shared") {
+  ExprFactory efac;
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr y = bind::intConst (mkTerm<std::string> ("y", efac));
+
+  // -- a chain of 20 diamonds over x. x itself is 4 nodes (fapp,
+  // -- fdecl, name and type)
+  Expr e = x;
+  for (unsigned i = 0; i < 20; ++i)
+    e = mk<PLUS> (mk<NEG> (e), mk<UN_MINUS> (e));
+
+  CHECK(dagSize (e) == 20 * 3 + 4);
+  Expr r = replaceAll (e, x, y);
+  CHECK(r != e);
+  CHECK(replaceAll (r, y, x) == e);
+
+  Expr small = mk<PLUS> (mk<NEG> (x), mk<NEG> (x));
+  CHECK(treeSize (small) == 11);
+  CHECK(dagSize (small) == 6);
+}
+
+TEST_CASE("expr.visit_deep") {
+  ExprFactory efac;
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr y = bind::intConst (mkTerm<std::string> ("y", efac));
+
+  // -- a term a million levels deep. Visiting it recursively would
+  // -- overflow the native stack
+  const unsigned depth = 1000000;
+  Expr e = x;
+  for (unsigned i = 0; i < depth; ++i) e = mk<UN_MINUS> (e);
+
+  CHECK(dagSize (e) == depth + 4);
+
+  Expr r = replaceAll (e, x, y);
+  Expr ry = r;
+  for (unsigned i = 0; i < depth; ++i) ry = ry->left ();
+  CHECK(ry == y);
+
+  ExprMap m;
+  m [y] = x;
+  CHECK(replace (r, m) == e);
+  
+  // -- releasing the terms frees the whole chain
+  e.reset ();
+  r.reset ();
+  ry.reset ();
+  CHECK(dagSize (mk<UN_MINUS> (x)) == 5);
+}
+
+TEST_CASE("expr.rewrite_memo") {
+  ExprFactory efac;
+
+  Expr iTy = mk<INT_TY> (efac);
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr y = bind::intConst (mkTerm<std::string> ("y", efac));
+  Expr b0 = bind::bvar (0, iTy);
+  Expr b1 = bind::bvar (1, iTy);
+
+  ExprMap m;
+  m [b0] = x;
+  m [b1] = y;
+
+  Expr shared = mk<PLUS> (b0, b1);
+  Expr c1 = mk<LEQ> (shared, b0);
+  Expr c2 = mk<GEQ> (shared, b1);
+
+  RewriteMemo memo (efac);
+  CHECK(memo.replace ("test", x, c1, m) == replace (c1, m));
+  unsigned misses = ufo::Stats::get ("memo.test.miss");
+
+  // -- only the new root is visited, the rest is shared with c1
+  CHECK(memo.replace ("test", x, c2, m) == replace (c2, m));
+  CHECK(ufo::Stats::get ("memo.test.hit") >= 1);
+  CHECK(ufo::Stats::get ("memo.test.miss") - misses == 1);
+
+  // -- a different key is a different rewriter
+  ExprMap m2;
+  m2 [b0] = y;
+  m2 [b1] = x;
+  CHECK(memo.replace ("test", y, c1, m2) == replace (c1, m2));
+
+  // -- entries of dead terms are dropped
+  size_t sz = memo.size ();
+  c2.reset ();
+  CHECK(memo.size () < sz);
+}
@@ -0,0 +1,126 @@
+/**
+ * Benchmark of HornClauseDB updates.
+ *
+ * Builds a database of N rules over R relations, and reports the time
+ * of each phase:
+ *
+ *   add        -- add the rules
+ *   index      -- build the use/def indexes
+ *   add_idx    -- add another N rules while the indexes are built
+ *   normalize  -- remove every rule and add it back, as done by
+ *                 normalizeHornClauseHeads, querying the indexes
+ *                 after each update
+ *   remove     -- remove every rule, one at a time
+ *
+ * Output is CSV, one row per phase.
+ *
+ * Usage: horn_db_bench [-rules N] [-rels R]
+ */
+#include "seahorn/HornClauseDB.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using namespace expr;
+using namespace expr::op;
+using namespace seahorn;
+
+namespace
+{
+  struct Phase
+  {
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+    size_t ops;
+
+    Phase (const char *n, size_t o) :
+      name (n), start (std::chrono::steady_clock::now ()), ops (o) {}
+
+    ~Phase ()
+    {
+      double secs = std::chrono::duration<double>
+        (std::chrono::steady_clock::now () - start).count ();
+      std::printf ("%s,%zu,%.3f,%.3f\n", name, ops, secs,
+                   ops ? secs * 1e6 / ops : 0.0);
+    }
+  };
+
+  /// rule i: rel [i % R] (x) /\ x' = x + i -> rel [(i + 1) % R] (x')
+  HornRule mkRule (const ExprVector &rels, Expr x, Expr xp, unsigned i)
+  {
+    ExprFactory &efac = x->efac ();
+    Expr src = bind::fapp (rels [i % rels.size ()], x);
+    Expr dst = bind::fapp (rels [(i + 1) % rels.size ()], xp);
+    Expr tr = mk<EQ> (xp, mk<PLUS> (x, mkTerm<mpz_class> (mpz_class (i), efac)));
+    ExprVector vars {x, xp};
+    return HornRule (vars, dst, boolop::land (src, tr));
+  }
+}
+
+int main (int argc, char **argv)
+{
+  unsigned nRules = 100000, nRels = 1000;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!std::strcmp (argv [i], "-rules")) nRules = std::atoi (argv [i + 1]);
+    else if (!std::strcmp (argv [i], "-rels")) nRels = std::atoi (argv [i + 1]);
+  }
+
+  ExprFactory efac;
+  HornClauseDB db (efac);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr xp = bind::intConst (mkTerm<std::string> ("x'", efac));
+  ExprVector rels;
+  for (unsigned i = 0; i < nRels; ++i)
+  {
+    Expr name = mkTerm<std::string> ("P" + std::to_string (i), efac);
+    rels.push_back (bind::fdecl (name, ExprVector {mk<INT_TY> (efac),
+                                                   mk<BOOL_TY> (efac)}));
+    db.registerRelation (rels.back ());
+  }
+
+  std::vector<HornRule> rules;
+  rules.reserve (2 * nRules);
+  for (unsigned i = 0; i < 2 * nRules; ++i)
+    rules.push_back (mkRule (rels, x, xp, i));
+
+  std::printf ("phase,ops,secs,usecs_per_op\n");
+  {
+    Phase p ("add", nRules);
+    for (unsigned i = 0; i < nRules; ++i) db.addRule (rules [i]);
+  }
+  {
+    Phase p ("index", nRules);
+    db.buildIndexes ();
+  }
+  {
+    Phase p ("add_idx", nRules);
+    for (unsigned i = nRules; i < 2 * nRules; ++i) db.addRule (rules [i]);
+  }
+
+  size_t uses = 0;
+  {
+    Phase p ("normalize", 2 * nRules);
+    std::vector<HornRule> worklist (db.getRules ().begin (),
+                                    db.getRules ().end ());
+    for (const HornRule &r : worklist)
+    {
+      db.removeRule (r);
+      db.addRule (r);
+      uses += db.use (bind::fname (r.head ())).size ();
+    }
+  }
+  {
+    Phase p ("remove", 2 * nRules);
+    for (const HornRule &r : rules) db.removeRule (r);
+  }
+
+  if (!db.getRules ().empty () || uses == 0)
+  {
+    std::fprintf (stderr, "unexpected database state\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,240 @@
+#include "seahorn/HornClauseDBTransf.hh"
+#include "seahorn/HornDbModel.hh"
+#include "ufo/Smt/EZ3.hh"
+
+#include "doctest.h"
+
+using namespace std;
+using namespace expr;
+using namespace ufo;
+using namespace seahorn;
+
+namespace
+{
+  Expr intConst (const string &name, ExprFactory &efac)
+  {return bind::intConst (mkTerm<string> (name, efac));}
+
+  Expr mkRel (const string &name, unsigned arity, ExprFactory &efac)
+  {
+    ExprVector ty (arity, mk<INT_TY> (efac));
+    ty.push_back (mk<BOOL_TY> (efac));
+    return bind::fdecl (mkTerm<string> (name, efac), ty);
+  }
+
+  Expr num (int n, ExprFactory &efac) {return mkTerm<mpz_class> (n, efac);}
+
+  /// -- loads db into a fresh Spacer instance of z3 and queries it. On
+  /// -- an unsat answer, the model is stored in model
+  tribool solve (HornClauseDB &db, EZ3 &z3, HornDbModel &model)
+  {
+    ZFixedPoint<EZ3> fp (z3);
+    ZParams<EZ3> params (z3);
+    params.set (":engine", "spacer");
+    params.set (":xform.slice", false);
+    params.set (":xform.inline_linear", false);
+    params.set (":xform.inline_eager", false);
+    fp.set (params);
+    db.loadZFixedPoint (fp);
+    tribool res = fp.query ();
+    if (!res) initDBModelFromFP (model, db, fp);
+    return res;
+  }
+
+  /// -- true if model satisfies every rule and query of db
+  bool checkModel (HornClauseDB &db, HornDbModel &model, EZ3 &z3)
+  {
+    auto interp = [&] (Expr e)
+    {
+      ExprVector apps;
+      get_all_pred_apps (e, db, back_inserter (apps));
+      ExprMap sub;
+      for (Expr a : apps) sub [a] = model.getDef (a);
+      return replace (e, sub);
+    };
+
+    for (const HornRule &r : db.getRules ())
+    {
+      ZSolver<EZ3> s (z3);
+      s.assertExpr (interp (r.body ()));
+      s.assertExpr (mk<NEG> (interp (r.head ())));
+      if (s.solve ()) return false;
+    }
+    for (const Expr &q : db.getQueries ())
+    {
+      ZSolver<EZ3> s (z3);
+      s.assertExpr (interp (q));
+      if (s.solve ()) return false;
+    }
+    return true;
+  }
+}
+
+/// Inv (x, y, z) counts x up from 0 while y accumulates z. Only x
+/// reaches the query, and Dead is never used by it
+static void mkSliceDB (HornClauseDB &db, bool safe)
+{
+  ExprFactory &efac = db.getExprFactory ();
+  Expr x = intConst ("x", efac), y = intConst ("y", efac);
+  Expr z = intConst ("z", efac);
+  Expr xp = intConst ("xp", efac), yp = intConst ("yp", efac);
+  Expr inv = mkRel ("Inv", 3, efac);
+  Expr dead = mkRel ("Dead", 1, efac);
+  Expr err = mkRel ("Err", 0, efac);
+  db.registerRelation (inv);
+  db.registerRelation (dead);
+  db.registerRelation (err);
+
+  ExprVector vars {x, y, z, xp, yp};
+  Expr step = safe ? mk<PLUS> (x, num (1, efac)) : mk<MINUS> (x, num (1, efac));
+  db.addRule (vars, mk<IMPL> (mk<AND> (mk<EQ> (x, num (0, efac)),
+                                       mk<EQ> (y, z)),
+                              bind::fapp (inv, x, y, z)));
+  db.addRule (vars, mk<IMPL> (mk<AND> (bind::fapp (inv, x, y, z),
+                                       mk<EQ> (xp, step),
+                                       mk<EQ> (yp, mk<PLUS> (y, z))),
+                              bind::fapp (inv, xp, yp, z)));
+  db.addRule (vars, mk<IMPL> (mk<AND> (bind::fapp (inv, x, y, z),
+                                       mk<LT> (x, num (0, efac))),
+                              bind::fapp (err)));
+  db.addRule (vars, mk<IMPL> (bind::fapp (inv, x, y, z),
+                              bind::fapp (dead, x)));
+  db.addQuery (bind::fapp (err));
+  db.buildIndexes ();
+}
+
+TEST_CASE("horn.slice_drops_relations_and_arguments") {
+  ExprFactory efac;
+  HornClauseDB db (efac);
+  mkSliceDB (db, true);
+
+  HornClauseDB out (efac);
+  SliceHornModelConverter conv;
+  sliceHornClauseDB (db, out, conv);
+
+  // -- Dead is unreachable from the query
+  CHECK(out.getRelations ().size () == 2);
+  for (Expr rel : out.getRelations ())
+  {
+    string name = lexical_cast<string> (*bind::fname (rel));
+    CHECK(name.find ("Dead") == string::npos);
+    // -- only x of Inv (x, y, z) reaches the query
+    if (name.find ("Inv") != string::npos)
+      CHECK(bind::domainSz (rel) == 1);
+  }
+  CHECK(out.getRules ().size () == 3);
+}
+
+TEST_CASE("horn.slice_preserves_answer_and_model") {
+  for (bool safe : {true, false})
+  {
+    ExprFactory efac;
+    EZ3 z3 (efac);
+    HornClauseDB db (efac);
+    mkSliceDB (db, safe);
+
+    HornClauseDB out (efac);
+    SliceHornModelConverter conv;
+    sliceHornClauseDB (db, out, conv);
+
+    HornDbModel dbModel, outModel;
+    tribool dbRes = solve (db, z3, dbModel);
+    tribool outRes = solve (out, z3, outModel);
+    CHECK(bool (dbRes == !safe));
+    CHECK(bool (outRes == !safe));
+    if (safe)
+    {
+      // -- every relation is true in an empty model
+      HornDbModel empty;
+      CHECK_FALSE(checkModel (db, empty, z3));
+
+      HornDbModel model;
+      CHECK(conv.convert (outModel, model));
+      CHECK(checkModel (db, model, z3));
+    }
+  }
+}
+
+/// A (x) counts x from 0 to 3. B (x + 1) <- A (x) has a non-variable
+/// head argument, and both B and C are defined by a rule that uses x,
+/// so inlining them renames x apart
+static void mkInlineDB (HornClauseDB &db, bool safe)
+{
+  ExprFactory &efac = db.getExprFactory ();
+  Expr x = intConst ("x", efac), y = intConst ("y", efac);
+  Expr xp = intConst ("xp", efac);
+  Expr a = mkRel ("A", 1, efac), b = mkRel ("B", 1, efac);
+  Expr c = mkRel ("C", 1, efac), err = mkRel ("Err", 0, efac);
+  for (Expr rel : {a, b, c, err}) db.registerRelation (rel);
+
+  db.addRule (ExprVector {x}, mk<IMPL> (mk<EQ> (x, num (0, efac)),
+                                        bind::fapp (a, x)));
+  db.addRule (ExprVector {x, xp},
+              mk<IMPL> (mk<AND> (bind::fapp (a, x),
+                                 mk<LT> (x, num (3, efac)),
+                                 mk<EQ> (xp, mk<PLUS> (x, num (1, efac)))),
+                        bind::fapp (a, xp)));
+  db.addRule (ExprVector {x}, mk<IMPL> (bind::fapp (a, x),
+                                        bind::fapp (b, mk<PLUS> (x, num (1, efac)))));
+  db.addRule (ExprVector {x, y},
+              mk<IMPL> (mk<AND> (bind::fapp (b, x), mk<EQ> (y, mk<PLUS> (x, x))),
+                        bind::fapp (c, y)));
+  // -- C (y) holds for y in [2, 8]
+  db.addRule (ExprVector {y},
+              mk<IMPL> (mk<AND> (bind::fapp (c, y),
+                                 mk<GT> (y, num (safe ? 8 : 7, efac))),
+                        bind::fapp (err)));
+  db.addQuery (bind::fapp (err));
+  db.buildIndexes ();
+}
+
+TEST_CASE("horn.inline_collapses_chain") {
+  ExprFactory efac;
+  EZ3 z3 (efac);
+  HornClauseDB db (efac);
+  mkInlineDB (db, true);
+
+  InlineHornModelConverter conv (z3);
+  CHECK(inlineHornClauseDB (db, conv, 1000) == 2);
+  // -- A loops and Err is queried. B and C are gone
+  CHECK(db.getRelations ().size () == 2);
+  CHECK(db.getRules ().size () == 3);
+
+  // -- the x of the rule of B is renamed apart from the x of the rule
+  // -- of C, in whichever order they are inlined
+  unsigned renamed = 0;
+  for (const HornRule &r : db.getRules ())
+    for (Expr v : r.vars ())
+    {
+      string name = lexical_cast<string> (*v);
+      if (name.find ("inline") != string::npos) ++renamed;
+    }
+  CHECK(renamed == 1);
+}
+
+TEST_CASE("horn.inline_preserves_answer_and_model") {
+  for (bool safe : {true, false})
+  {
+    ExprFactory efac;
+    EZ3 z3 (efac);
+    HornClauseDB db (efac);
+    mkInlineDB (db, safe);
+
+    HornClauseDB inl (db);
+    inl.buildIndexes ();
+    InlineHornModelConverter conv (z3);
+    inlineHornClauseDB (inl, conv, 1000);
+
+    HornDbModel dbModel, inlModel;
+    tribool dbRes = solve (db, z3, dbModel);
+    tribool inlRes = solve (inl, z3, inlModel);
+    CHECK(bool (dbRes == !safe));
+    CHECK(bool (inlRes == !safe));
+    if (safe)
+    {
+      // -- B and C are rebuilt from the rules that defined them
+      HornDbModel model;
+      CHECK(conv.convert (inlModel, model));
+      CHECK(checkModel (db, model, z3));
+    }
+  }
+}
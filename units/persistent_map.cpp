@@ -0,0 +1,117 @@
+#include "seahorn/Support/PersistentMap.hh"
+#include "ufo/Expr.hpp"
+
+#include <map>
+#include <random>
+#include <unordered_map>
+
+#include "doctest.h"
+
+using namespace seahorn;
+
+namespace
+{
+  /// -- a poor hash that forces deep tries and collision nodes
+  struct BadHash
+  {
+    size_t operator() (unsigned v) const { return v % 7; }
+  };
+
+  template <typename M>
+  std::map<unsigned,unsigned> toStd (const M &m)
+  {
+    std::map<unsigned,unsigned> res;
+    for (auto &kv : m) res [kv.first] = kv.second;
+    return res;
+  }
+}
+
+TEST_CASE("pmap.snapshots") {
+  std::mt19937 rng (42);
+  PersistentMap<unsigned,unsigned> m;
+  std::unordered_map<unsigned,unsigned> ref;
+
+  std::vector<PersistentMap<unsigned,unsigned> > snaps;
+  std::vector<std::unordered_map<unsigned,unsigned> > refSnaps;
+  for (unsigned i = 0; i < 20000; ++i)
+  {
+    unsigned k = rng () % 5000, v = rng ();
+    m.set (k, v);
+    ref [k] = v;
+    if (i % 1000 == 0)
+    {
+      snaps.push_back (m);
+      refSnaps.push_back (ref);
+    }
+  }
+
+  CHECK(m.size () == ref.size ());
+  for (auto &kv : ref)
+  {
+    REQUIRE(m.find (kv.first));
+    CHECK(*m.find (kv.first) == kv.second);
+  }
+  CHECK(!m.find (5001));
+
+  // -- updates after a snapshot are not visible in it
+  for (unsigned i = 0; i < snaps.size (); ++i)
+  {
+    CHECK(snaps [i].size () == refSnaps [i].size ());
+    std::map<unsigned,unsigned> s = toStd (snaps [i]);
+    CHECK(s == std::map<unsigned,unsigned> (refSnaps [i].begin (),
+                                            refSnaps [i].end ()));
+  }
+}
+
+TEST_CASE("pmap.collisions") {
+  PersistentMap<unsigned,unsigned,BadHash> m;
+  for (unsigned i = 0; i < 100; ++i) m.set (i, i);
+  PersistentMap<unsigned,unsigned,BadHash> s (m);
+  for (unsigned i = 0; i < 100; i += 2) m.set (i, i + 1);
+
+  CHECK(m.size () == 100);
+  for (unsigned i = 0; i < 100; ++i)
+  {
+    CHECK(*m.find (i) == (i % 2 ? i : i + 1));
+    CHECK(*s.find (i) == i);
+  }
+  CHECK(toStd (s).size () == 100);
+}
+
+TEST_CASE("pmap.diff") {
+  PersistentMap<unsigned,unsigned> a;
+  for (unsigned i = 0; i < 3000; ++i) a.set (i, i);
+  PersistentMap<unsigned,unsigned> b (a);
+  b.set (7, 8);
+  b.set (5000, 1);
+  b.set (9, 9);
+
+  std::map<unsigned,std::pair<int,int> > d;
+  a.diff (b, [&d] (unsigned k, const unsigned *x, const unsigned *y)
+          { d [k] = std::make_pair (x ? int (*x) : -1, y ? int (*y) : -1); });
+
+  REQUIRE(d.size () == 2);
+  CHECK(d [7] == std::make_pair (7, 8));
+  CHECK(d [5000] == std::make_pair (-1, 1));
+
+  unsigned n = 0;
+  a.diff (a, [&n] (unsigned, const unsigned *, const unsigned *) { ++n; });
+  CHECK(n == 0);
+}
+
+TEST_CASE("pmap.expr") {
+  using namespace expr;
+  ExprFactory efac;
+  PersistentMap<Expr,Expr> m;
+  ExprVector xs;
+  for (unsigned i = 0; i < 100; ++i)
+    xs.push_back (bind::intConst (mkTerm<std::string>
+                                  ("x" + std::to_string (i), efac)));
+  for (unsigned i = 0; i + 1 < xs.size (); ++i) m.set (xs [i], xs [i + 1]);
+
+  PersistentMap<Expr,Expr> s (m);
+  m.clear ();
+  CHECK(m.empty ());
+  CHECK(s.size () == 99);
+  CHECK(*s.find (xs [0]) == xs [1]);
+}
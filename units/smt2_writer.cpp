@@ -0,0 +1,129 @@
+#include "seahorn/Smt2Writer.hh"
+#include "ufo/ExprBv.hh"
+#include "ufo/Smt/EZ3.hh"
+
+#include "doctest.h"
+
+using namespace std;
+using namespace expr;
+using namespace ufo;
+using namespace seahorn;
+
+/// Inv (x, b, a) counts x up from 0 while b counts in 8 bits and
+/// a [x] is set to x + 1. The initial rule has a quantifier, since
+/// Spacer rejects one in a recursive rule, and the step shares x + 1
+static void mkWriterDB (HornClauseDB &db, bool safe)
+{
+  ExprFactory &efac = db.getExprFactory ();
+  Expr iTy = mk<INT_TY> (efac), bvTy = bv::bvsort (8, efac);
+  Expr aTy = sort::arrayTy (iTy, iTy);
+  Expr x = bind::intConst (mkTerm<string> ("x", efac));
+  Expr xp = bind::intConst (mkTerm<string> ("xp", efac));
+  Expr b = bv::bvConst (mkTerm<string> ("b", efac), 8);
+  Expr bp = bv::bvConst (mkTerm<string> ("bp", efac), 8);
+  Expr a = bind::mkConst (mkTerm<string> ("a", efac), aTy);
+  Expr ap = bind::mkConst (mkTerm<string> ("ap", efac), aTy);
+  Expr inv = bind::fdecl (mkTerm<string> ("Inv", efac),
+                          ExprVector {iTy, bvTy, aTy, mk<BOOL_TY> (efac)});
+  Expr err = bind::fdecl (mkTerm<string> ("Err", efac),
+                          ExprVector {mk<BOOL_TY> (efac)});
+  db.registerRelation (inv);
+  db.registerRelation (err);
+
+  Expr zero = mkTerm<mpz_class> (0, efac);
+  Expr x1 = mk<PLUS> (x, mkTerm<mpz_class> (1, efac));
+  // -- forall y. y > x -> y >= x + 1
+  Expr y = bind::intBVar (0, efac);
+  Expr all = mk<FORALL> (bind::intConstDecl (mkTerm<string> ("y", efac)),
+                         mk<IMPL> (mk<GT> (y, x), mk<GEQ> (y, x1)));
+
+  ExprVector vars {x, xp, b, bp, a, ap};
+  db.addRule (vars, mk<IMPL> (mk<AND> (mk<EQ> (x, zero), all,
+                                       mk<EQ> (b, bv::bvnum (0, 8, efac))),
+                              bind::fapp (inv, x, b, a)));
+  db.addRule (vars,
+              mk<IMPL> (mknary<AND> (ExprVector
+                                     {bind::fapp (inv, x, b, a),
+                                      mk<LT> (x, mkTerm<mpz_class> (5, efac)),
+                                      mk<EQ> (xp, x1),
+                                      mk<EQ> (bp, mk<BADD> (b, bv::bvnum (1, 8, efac))),
+                                      mk<EQ> (ap, op::array::store (a, x, x1))}),
+                        bind::fapp (inv, xp, bp, ap)));
+  db.addRule (vars,
+              mk<IMPL> (mk<AND> (bind::fapp (inv, x, b, a),
+                                 mk<GT> (x, mkTerm<mpz_class> (safe ? 5 : 4, efac))),
+                        bind::fapp (err)));
+  db.addQuery (bind::fapp (err));
+}
+
+/// -- the answer of db through ZFixedPoint
+static tribool solveZ (HornClauseDB &db)
+{
+  EZ3 z3 (db.getExprFactory ());
+  ZFixedPoint<EZ3> fp (z3);
+  ZParams<EZ3> params (z3);
+  params.set (":engine", "spacer");
+  fp.set (params);
+  db.loadZFixedPoint (fp);
+  return fp.query ();
+}
+
+static string write (HornClauseDB &db, bool pure, unsigned &lets)
+{
+  string str;
+  raw_string_ostream out (str);
+  Smt2Writer writer (db, pure);
+  writer.write (out);
+  lets = writer.numLets ();
+  return out.str ();
+}
+
+TEST_CASE("horn.smt2_writer_fixedpoint") {
+  for (bool safe : {true, false})
+  {
+    ExprFactory efac;
+    HornClauseDB db (efac);
+    mkWriterDB (db, safe);
+    unsigned lets;
+    string str = write (db, false, lets);
+    CHECK(lets > 0);
+
+    z3::context ctx;
+    Z3_fixedpoint fp = Z3_mk_fixedpoint (ctx);
+    Z3_fixedpoint_inc_ref (ctx, fp);
+    z3::params params (ctx);
+    params.set ("engine", ctx.str_symbol ("spacer"));
+    Z3_fixedpoint_set_params (ctx, fp, params);
+    z3::ast_vector queries (ctx, Z3_fixedpoint_from_string (ctx, fp, str.c_str ()));
+    REQUIRE(ctx.check_error () == Z3_OK);
+    REQUIRE(queries.size () == 1);
+    Z3_lbool res = Z3_fixedpoint_query (ctx, fp, queries [0]);
+    Z3_fixedpoint_dec_ref (ctx, fp);
+
+    tribool zres = solveZ (db);
+    CHECK(bool (zres == !safe));
+    CHECK(res == (safe ? Z3_L_FALSE : Z3_L_TRUE));
+  }
+}
+
+TEST_CASE("horn.smt2_writer_pure") {
+  for (bool safe : {true, false})
+  {
+    ExprFactory efac;
+    HornClauseDB db (efac);
+    mkWriterDB (db, safe);
+    unsigned lets;
+    string str = write (db, true, lets);
+    CHECK(lets > 0);
+
+    z3::context ctx;
+    z3::expr_vector fmls = ctx.parse_string (str.c_str ());
+    z3::solver s (ctx, "HORN");
+    for (unsigned i = 0; i < fmls.size (); ++i) s.add (fmls [i]);
+
+    // -- the clauses are satisfiable iff the query is unreachable
+    tribool zres = solveZ (db);
+    CHECK(bool (zres == !safe));
+    CHECK(s.check () == (safe ? z3::sat : z3::unsat));
+  }
+}
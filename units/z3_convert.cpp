@@ -0,0 +1,174 @@
+#include "ufo/Smt/EZ3.hh"
+
+#include "doctest.h"
+
+using namespace expr;
+using namespace expr::op;
+using namespace ufo;
+
+namespace
+{
+  struct TestZ3 : public EZ3
+  {
+    TestZ3 (ExprFactory &efac) : EZ3 (efac) {}
+    using EZ3::toAst;
+    using EZ3::toExpr;
+  };
+}
+
+TEST_CASE("z3.convert_roundtrip") {
+  ExprFactory efac;
+  TestZ3 z3 (efac);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr a = bind::mkConst (mkTerm<std::string> ("a", efac),
+                          sort::arrayTy (mk<INT_TY> (efac), mk<INT_TY> (efac)));
+  Expr bx = bv::bvConst (mkTerm<std::string> ("bx", efac), 8);
+  Expr five = mkTerm<mpz_class> (5, efac);
+
+  ExprVector es;
+  es.push_back (mk<LEQ> (mk<PLUS> (x, five), mk<SELECT> (a, x)));
+  es.push_back (mk<NEG> (mk<EQ> (mk<STORE> (a, x, five), a)));
+  es.push_back (mk<EQ> (bv::extract (3, 0, bx),
+                        bv::bvnum (mpz_class (3), 4, efac)));
+  es.push_back (mk<ITE> (es [0], es [1], es [2]));
+  es.push_back (mk<FORALL> (bind::intConstDecl (mkTerm<std::string> ("y", efac)),
+                            mk<GT> (bind::intBVar (0, efac), x)));
+
+  for (const Expr &e : es)
+    CHECK(z3.toExpr (z3.toAst (e)) == e);
+
+  // -- one pass over the whole vector
+  std::vector<z3::ast> asts;
+  z3.toAst (es, std::back_inserter (asts));
+  REQUIRE(asts.size () == es.size ());
+  ExprVector back;
+  z3.toExpr (asts, std::back_inserter (back));
+  CHECK(back == es);
+}
+
+TEST_CASE("z3.convert_deep") {
+  ExprFactory efac;
+  TestZ3 z3 (efac);
+
+  // -- a term that is too deep for a recursive converter
+  const unsigned depth = 200000;
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr e = x;
+  for (unsigned i = 0; i < depth; ++i)
+    e = mk<PLUS> (e, mkTerm<mpz_class> (i % 7, efac));
+  Expr phi = mk<GT> (e, x);
+
+  z3::ast z = z3.toAst (phi);
+  CHECK(z3.toExpr (z) == phi);
+}
+
+TEST_CASE("z3.convert_cache_budget") {
+  ExprFactory efac;
+  TestZ3 z3 (efac);
+  CHECK(z3.getCacheBudget () == 0);
+  z3.setCacheBudget (16 << 10);
+
+  Expr keep = bind::intConst (mkTerm<std::string> ("keep", efac));
+  z3::ast keepAst = z3.toAst (keep);
+
+  // -- constants that are dropped right after conversion
+  const unsigned n = 20000;
+  for (unsigned i = 0; i < n; ++i)
+  {
+    Expr c = bind::intConst (mkTerm<std::string>
+                             ("c" + std::to_string (i), efac));
+    z3.toAst (mk<GT> (c, keep));
+  }
+
+  CHECK(z3.cacheStats ().evictions > 0);
+  CHECK(z3.cacheSize () < n);
+  // -- entries in use survive eviction
+  CHECK(z3.toExpr (keepAst) == keep);
+
+  // -- declarations and variables whose names are not strings are
+  // -- evicted too, and still converted back to the same Expr
+  Expr opaque = bind::intConst (mkTerm<mpz_class> (mpz_class (42), efac));
+  z3::ast opaqueAst = z3.toAst (opaque);
+  opaque.reset ();
+  Expr var = bind::boolVar (mkTerm<mpz_class> (mpz_class (43), efac));
+  z3::ast varAst = z3.toAst (var);
+  var.reset ();
+  size_t evictions = z3.cacheStats ().evictions;
+  for (unsigned i = 0; i < n; ++i)
+    z3.toAst (bind::intConst (mkTerm<mpz_class> (mpz_class (100 + i), efac)));
+  CHECK(z3.cacheStats ().evictions - evictions > n / 2);
+  CHECK(z3.cacheSize () < n);
+  CHECK(z3.toExpr (opaqueAst) ==
+        bind::intConst (mkTerm<mpz_class> (mpz_class (42), efac)));
+  CHECK(z3.toExpr (varAst) ==
+        bind::boolVar (mkTerm<mpz_class> (mpz_class (43), efac)));
+
+  z3.setCacheBudget (0);
+  size_t sz = z3.cacheSize ();
+  Expr d = bind::intConst (mkTerm<std::string> ("d", efac));
+  z3.toAst (d);
+  CHECK(z3.cacheSize () > sz);
+}
+
+TEST_CASE("z3.solver_assert_exprs") {
+  ExprFactory efac;
+  TestZ3 z3 (efac);
+  ZSolver<EZ3> solver (z3);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr y = bind::intConst (mkTerm<std::string> ("y", efac));
+  Expr sum = mk<PLUS> (x, y);
+
+  ExprVector side;
+  side.push_back (mk<GT> (sum, mkTerm<mpz_class> (10, efac)));
+  side.push_back (mk<LT> (sum, mkTerm<mpz_class> (20, efac)));
+  side.push_back (mk<EQ> (x, y));
+  solver.assertExprs (side);
+
+  ExprVector asserts;
+  solver.assertions (std::back_inserter (asserts));
+  CHECK(asserts == side);
+  CHECK(bool(solver.solve ()));
+
+  solver.assertExprs (ExprVector (1, mk<EQ> (sum, mkTerm<mpz_class> (11, efac))));
+  CHECK(bool(!solver.solve ()));
+}
+
+TEST_CASE("z3.model_eval_batch") {
+  ExprFactory efac;
+  TestZ3 z3 (efac);
+  ZSolver<EZ3> solver (z3);
+
+  Expr x = bind::intConst (mkTerm<std::string> ("x", efac));
+  Expr y = bind::intConst (mkTerm<std::string> ("y", efac));
+  Expr z = bind::intConst (mkTerm<std::string> ("z", efac));
+  Expr a = bind::mkConst (mkTerm<std::string> ("a", efac),
+                          sort::arrayTy (mk<INT_TY> (efac), mk<INT_TY> (efac)));
+  Expr three = mkTerm<mpz_class> (3, efac);
+  solver.assertExpr (mk<EQ> (x, three));
+  solver.assertExpr (mk<EQ> (y, mk<PLUS> (x, x)));
+  solver.assertExpr (mk<EQ> (mk<SELECT> (a, x), y));
+  REQUIRE(bool(solver.solve ()));
+
+  ZSolver<EZ3>::Model m = solver.getModel ();
+  ExprVector terms;
+  terms.push_back (x);
+  terms.push_back (mk<PLUS> (x, y));
+  terms.push_back (a);
+  terms.push_back (z);
+  terms.push_back (mk<SELECT> (a, x));
+
+  ExprVector vals;
+  m.eval (terms, std::back_inserter (vals));
+  REQUIRE(vals.size () == terms.size ());
+  for (unsigned i = 0; i < terms.size (); ++i)
+    CHECK(vals [i] == m.eval (terms [i]));
+  CHECK(vals [0] == three);
+  CHECK(vals [1] == mkTerm<mpz_class> (9, efac));
+
+  // -- with model completion every term has a value
+  ExprVector completed;
+  m.eval (terms, std::back_inserter (completed), true);
+  CHECK(completed [3] == m.eval (z, true));
+}